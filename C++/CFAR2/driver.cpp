@@ -33,7 +33,6 @@
 #include "ossim/imaging/ossimImageHandler.h"
 
 /// Creates all the important factories used to read files
-#include "ossim/init/ossimInit.h"
 
 /// Add the dynamic (.so file) plugin support
 /// For .N1 file GDAL plugin is required.
@@ -49,6 +48,7 @@
 #include "ossim/imaging/ossimImageSourceFactoryRegistry.h"
 #include "ossim/imaging/ossimTiffWriter.h"
 #include "ossim/imaging/ossimSingleImageChain.h"
+#include "ossim/imaging/ossimCacheTileSource.h"
 
 /// Include filters
 #include "src/ossimSimpleFilter.h"
@@ -56,20 +56,310 @@
 #include "src/ossimCFARFilter.h"
 #include "src/ossimWaveletFilter.h"
 #include "src/ossimSDFilter.h"
+#include "src/ossimPrefetchFilter.h"
+#include "src/ossimRadiometricFilter.h"
+#include "src/ossimN1MappedHandler.h"
 
 /// Include gdal
 #include "src/gdalprocess.h"
+#include "src/processingsession.h"
+#include "src/tiepointgeocoder.h"
+#include "src/detectionwriter.h"
+#include "src/landmask.h"
+#include "src/landtilegrid.h"
+#include "src/landtilecache.h"
+#include "src/batchexecutor.h"
+#include "src/tilescheduler.h"
+#include "src/areaofinterest.h"
+#include "src/pipelinemetrics.h"
+#include "src/tracerecorder.h"
+
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+#include <OpenThreads/Thread>
 
 using namespace std;
 
-void processSD(std::string &inputName);
+/// Post-processing options from the command line
+struct PipelineOptions
+{
+  bool inMemory;	// Keep intermediates in /vsimem/
+  bool gcpInPlace;	// Attach GCPs to the detector TIFF and warp it directly (no TEMP.tiff)
+  int warpThreads;	// 1 = single threaded GDAL warp, 0 = one thread per CPU
+  int warpChunkSize;	// Destination chunk side in pixels for the threaded warp, 0 = automatic
+  double warpMemoryLimit;	// Bytes of warp buffers, 0 = GDAL default
+  double warpErrorThreshold;	// Approximate transformer error in pixels, 0 = exact (GDAL default 0.125)
+  bool geocode;		// Ship positions from the N1 tie points instead of warping and masking the raster
+  bool geocodeReport;	// Accuracy of the tie point geocoder against the GDAL GCP transformer
+  std::string vectorFormat;	// OGR driver for the detection product (GeoJSON, ESRI Shapefile, CSV)
+  bool pointMask;	// Land mask the detections by point-in-polygon instead of rasterising the coastline
+  double coastBuffer;	// Metres, detections this close to land are masked too
+  LandMask *landMask;	// Polygons loaded once and reused while the shapefile stays the same
+  int landSkip;		// Land/sea cell size in pixels, 0 = run the detector over land too
+  std::string landCacheDir;	// Pre-rasterised land mask tiles, empty = rasterise the shapefile per scene
+  LandTileCache *landCache;
+  bool batch;		// Pipeline the scenes through the stages instead of one after the other
+  std::string stageThreads;	// Threads per batch stage: detect,sd,georeference,warp,mask
+  double memoryBudget;	// Bytes of scenes in flight in a batch, 0 = unlimited
+  int tileThreads;	// Detector threads per scene, 1 = the serial tile loop, 0 = one per CPU
+  double tileMemory;	// Bytes of detector tiles in flight, 0 = unlimited
+  int prefetch;		// Tiles read ahead of the detector on a background thread, 0 = synchronous reads
+  bool sharedTiles;	// Job lines on the same N1 run their detectors over one read of the scene
+  bool mappedN1;	// Read detected ASAR N1 products through the memory mapped handler, not GDAL
+  bool stream;		// Detect strips of an N1 that is still being written, as its lines land
+  double streamTimeout;	// Seconds without the file growing before a stream is given up
+  std::string aoi;	// Bounding box (minLon,minLat,maxLon,maxLat) or WKT polygon file, empty = whole scenes
+  AreaOfInterest *areaOfInterest;
+  bool metrics;		// Per scene timings and counters, written to <ships>Metrics.json
+  std::string traceFile;	// Chrome trace event timeline of every thread, empty = not traced
+  int scalingMode;	// N1 to 8 bit: 0 = the detectors' linear scaleValue, 1 = log (dB), 2 = clipped percentile
+  double scalingLow;	// dB or percent at which the log/percentile mapping gives 0
+  double scalingHigh;	// dB or percent at which it gives 255
+};
+
+/// Stages of a scene, in order
+enum SceneStage { SCENE_DETECT, SCENE_SD, SCENE_GEOREFERENCE, SCENE_WARP, SCENE_MASK, SCENE_STAGES };
+static const char *sceneStageNames[SCENE_STAGES] = { "detect", "sd", "georeference", "warp", "mask" };
+
+/// One line of the job file, with the state handed from stage to stage
+struct SceneJob
+{
+  std::string inputFilename;
+  std::string inputFilenameSHP;
+  std::string filePart;
+  int processingType;		// 0 = none, 1 = global, 2 = cfar, 3 = wavelet
+  int globalThreshold;
+  int scaleValue;
+  int burnValue;
+  int guardSize;
+  int neighbourSize;
+  double cfarThreshold;
+  double waveletThreshold;	// c in mu + c*sigma
+  int waveletType;		// 0 = single level Haar, 1 = Haar lifting, 2 = CDF 5/3 lifting
+  int waveletLevels;
+  int statisticsMode;		// 0 = per tile, 1 = scene (two pass)
+  int statisticsDecimation;	// Scene statistics sample every 2^n th tile in each direction
+  std::string warpFormat;
+  
+  std::string inputName;	// Detector tiff
+  std::string inputNameFinal;
+  std::string tempFileName;
+  std::string shipsName;
+  std::string memoryName;	// /vsimem/ prefix of the in-memory intermediates, unique per job line
+  
+  bool hasWindow;		// Only the AOI window is detected
+  ossimIrect window;		// AOI with the detector halo, N1 pixel/line
+  ossimIpt origin;		// N1 pixel/line of the detector image's upper left
+  
+  cv::Mat detectionImage;	// In-memory pipeline
+  std::vector<ShipDetection> detections;
+  std::string georeferencedName;
+  
+  PipelineMetrics *metrics;	// NULL unless -metrics
+};
+
+/// Land polygons, grid and cache are shared by the scenes of a batch
+static OpenThreads::Mutex landMutex;
+
+void processSD(std::string &inputName, std::vector<ShipDetection> &detections);
+void processSD(cv::Mat &inputImage, cv::Mat &outputImage, std::vector<ShipDetection> &detections);
+void geocodeDetections(const std::string &inputFilename, const std::string &inputFilenameSHP,
+		       std::vector<ShipDetection> &detections,
+		       const std::string &outputName, const PipelineOptions &options);
+void writeDetection(ossimImageSource *filter, const std::string &inputName, const ossimIrect &area);
+void readDetection(ossimImageSource *filter, cv::Mat &outputImage, const ossimIrect &area);
+int sceneWindow(SceneJob &scene, const PipelineOptions &options);
+ossimIrect detectionArea(SceneJob &scene, ossimImageSource *filter);
+void offsetDetections(std::vector<ShipDetection> &detections, const ossimIpt &origin);
+void countBytesWritten(const std::string &filename);
+ossimImageSource *createDetector(const SceneJob &scene, ossimObject *owner, LandTileGrid *landGrid);
+ossimRadiometricFilter *createScaling(const SceneJob &scene, const PipelineOptions &options);
+ossimImageHandler *openSceneHandler(const std::string &inputFilename, const PipelineOptions &options);
+int detectTiles(SceneJob &scene, const PipelineOptions &options, LandTileGrid *landGrid, cv::Mat &outputImage);
+void benchmarkWarp(const std::string &inputTiff, const std::string &warpFormat);
+void maskScene(GDALProcess *gdalProcessor, const std::string &inputFilenameSHP, int burnValue,
+	       const std::string &rasterName, const PipelineOptions &options);
+int buildLandGrid(const std::string &inputFilename, const std::string &inputFilenameSHP,
+		  int cellSize, LandMask &landMask, LandTileGrid &landGrid);
+void processInMemory(cv::Mat &detectionImage, const std::string &inputFilename,
+		     const std::string &inputFilenameSHP, const std::string &memoryName,
+		     const std::string &warpFormat, int burnValue, const PipelineOptions &options,
+		     const std::string &inputNameFinal, const std::string &shipsName, const ossimIpt &origin);
+int detectScene(SceneJob &scene, const PipelineOptions &options, LandMask &landMask);
+int streamScene(SceneJob &scene, const PipelineOptions &options);
+int appendN1(const std::string &sourceName, const std::string &outputName, double rate);
+int detectShared(std::vector<SceneJob*> &group, const PipelineOptions &options, LandMask &landMask);
+int runSceneStage(SceneJob &scene, int stage, const PipelineOptions &options, LandMask &landMask);
+int runBatch(std::vector<SceneJob*> &scenes, const PipelineOptions &options, LandMask &landMask);
 
 int main(int argc, char** argv)
 {
   
-	/// Check that total of 2 arguments are passed to the program
-	if(argc != 2){
-		cout << "./driver.out <text_file>" << endl;
+	/// Check that the job file (and optionally the pipeline flags) are passed to the program
+	PipelineOptions options;
+	options.inMemory = false;
+	options.gcpInPlace = false;
+	options.warpThreads = 1;
+	options.warpChunkSize = 0;
+	options.warpMemoryLimit = 0;
+	options.warpErrorThreshold = 0.125;
+	options.geocode = false;
+	options.geocodeReport = false;
+	options.vectorFormat = "CSV";
+	options.pointMask = false;
+	options.coastBuffer = 0;
+	options.landMask = NULL;
+	options.landSkip = 0;
+	options.landCache = NULL;
+	options.batch = false;
+	options.memoryBudget = 0;
+	options.tileThreads = 1;
+	options.tileMemory = 0;
+	options.prefetch = 0;
+	options.sharedTiles = false;
+	options.mappedN1 = false;
+	options.stream = false;
+	options.streamTimeout = 60;
+	options.areaOfInterest = NULL;
+	options.metrics = false;
+	options.scalingMode = 0;
+	options.scalingLow = 0;
+	options.scalingHigh = 0;
+	
+	/// Test writer for -stream: copies an N1 into a growing file at a fixed rate
+	if(argc == 5 && std::string(argv[1]) == "-n1append")
+	  return appendN1(argv[2], argv[3], atof(argv[4]));
+	
+	/// Warp scaling benchmark on an already georeferenced (TEMP) tiff, before the flags
+	/// as the tiff is not one
+	if(argc == 3 && std::string(argv[1]) == "-benchwarp")
+	{
+		ProcessingSession::instance()->initialize();
+		benchmarkWarp(argv[2], "WGS84");
+		ProcessingSession::instance()->finalize();
+		return 0;
+	}
+	
+	bool validArgs = (argc >= 2);
+	for(int a = 2; a < argc; a++)
+	{
+		if(std::string(argv[a]) == "-inmemory")
+			options.inMemory = true;
+		else
+		if(std::string(argv[a]) == "-gcpinplace")
+			options.gcpInPlace = true;
+		else
+		if(std::string(argv[a]) == "-warpthreads" && a + 1 < argc)
+			options.warpThreads = atoi(argv[++a]);
+		else
+		if(std::string(argv[a]) == "-warpchunk" && a + 1 < argc)
+			options.warpChunkSize = atoi(argv[++a]);
+		else
+		if(std::string(argv[a]) == "-warpmem" && a + 1 < argc)
+			options.warpMemoryLimit = atof(argv[++a]) * 1024.0 * 1024.0;
+		else
+		if(std::string(argv[a]) == "-warperror" && a + 1 < argc)
+			options.warpErrorThreshold = atof(argv[++a]);
+		else
+		if(std::string(argv[a]) == "-geocode")
+			options.geocode = true;
+		else
+		if(std::string(argv[a]) == "-geocodereport")
+			options.geocode = options.geocodeReport = true;
+		else
+		if(std::string(argv[a]) == "-vector" && a + 1 < argc)
+		{
+			std::string format = argv[++a];
+			if(format == "shp" || format == "Shapefile")
+				format = "ESRI Shapefile";
+			else
+			if(format == "geojson" || format == "json")
+				format = "GeoJSON";
+			else
+			if(format == "csv")
+				format = "CSV";
+			options.vectorFormat = format;
+			options.geocode = true;
+		}
+		else
+		if(std::string(argv[a]) == "-pointmask" && a + 1 < argc)
+		{
+			options.coastBuffer = atof(argv[++a]);
+			options.pointMask = options.geocode = true;
+		}
+		else
+		if(std::string(argv[a]) == "-landskip" && a + 1 < argc)
+			options.landSkip = atoi(argv[++a]);
+		else
+		if(std::string(argv[a]) == "-landcache" && a + 1 < argc)
+			options.landCacheDir = argv[++a];
+		else
+		if(std::string(argv[a]) == "-batch")
+			options.batch = true;
+		else
+		if(std::string(argv[a]) == "-stagethreads" && a + 1 < argc)
+		{
+			options.stageThreads = argv[++a];
+			options.batch = true;
+		}
+		else
+		if(std::string(argv[a]) == "-membudget" && a + 1 < argc)
+		{
+			options.memoryBudget = atof(argv[++a]) * 1024.0 * 1024.0;
+			options.batch = true;
+		}
+		else
+		if(std::string(argv[a]) == "-tilethreads" && a + 1 < argc)
+			options.tileThreads = atoi(argv[++a]);
+		else
+		if(std::string(argv[a]) == "-tilemem" && a + 1 < argc)
+			options.tileMemory = atof(argv[++a]) * 1024.0 * 1024.0;
+		else
+		if(std::string(argv[a]) == "-prefetch" && a + 1 < argc)
+			options.prefetch = atoi(argv[++a]);
+		else
+		if(std::string(argv[a]) == "-sharedtiles")
+			options.sharedTiles = true;
+		else
+		if(std::string(argv[a]) == "-n1mmap")
+			options.mappedN1 = true;
+		else
+		if(std::string(argv[a]) == "-stream" && a + 1 < argc)
+		{
+			options.streamTimeout = atof(argv[++a]);
+			options.stream = options.mappedN1 = true;
+		}
+		else
+		if(std::string(argv[a]) == "-aoi" && a + 1 < argc)
+			options.aoi = argv[++a];
+		else
+		if(std::string(argv[a]) == "-metrics")
+			options.metrics = true;
+		else
+		if(std::string(argv[a]) == "-trace" && a + 1 < argc)
+			options.traceFile = argv[++a];
+		else
+		if(std::string(argv[a]) == "-logscale" && a + 2 < argc)
+		{
+			options.scalingMode = 1;
+			options.scalingLow = atof(argv[++a]);
+			options.scalingHigh = atof(argv[++a]);
+		}
+		else
+		if(std::string(argv[a]) == "-percentilescale" && a + 2 < argc)
+		{
+			options.scalingMode = 2;
+			options.scalingLow = atof(argv[++a]);
+			options.scalingHigh = atof(argv[++a]);
+		}
+		else
+			validArgs = false;
+	}
+	
+	if(!validArgs){
+		cout << "./driver.out <text_file> [-inmemory] [-gcpinplace] [-warpthreads <n>] [-warpchunk <px>] [-warpmem <MB>] [-warperror <px>] [-geocode] [-geocodereport] [-vector <GeoJSON|Shapefile|CSV>] [-pointmask <coast_buffer_m>] [-landskip <cell_px>] [-landcache <dir>] [-batch] [-stagethreads <d,s,g,w,m>] [-membudget <MB>] [-tilethreads <n>] [-tilemem <MB>] [-prefetch <tiles>] [-sharedtiles] [-n1mmap] [-stream <timeout_s>] [-aoi <minLon,minLat,maxLon,maxLat|wkt_file>] [-metrics] [-trace <trace.json>] [-logscale <min_dB> <max_dB>] [-percentilescale <low_%> <high_%>]" << endl;
+		cout << "./driver.out -benchwarp <georeferenced_tiff>" << endl;
+		cout << "./driver.out -n1append <source_N1> <growing_N1> <MB_per_s>" << endl;
 		return 0;
 	}
 	
@@ -79,7 +369,7 @@ int main(int argc, char** argv)
 	std::string convertType;
 	std::string warpFormat = "WGS84";
 
-	int processingType = 0; // 0 = none, 1 = global, 2 = cfar.....
+	int processingType = 0; // 0 = none, 1 = global, 2 = cfar, 3 = wavelet
 	int globalThreshold = 0;
 	int scaleValue = 35;
 	int burnValue = 0;
@@ -88,11 +378,35 @@ int main(int argc, char** argv)
 
 	double cfarThreshold = 2.5;
 	
-	std::vector< std::string > inputFilenamesSHP;
-	std::vector< std::string > inputFileNames;
-	std::vector< std::string > inputNames;
-	std::vector< std::string > inputNameFinals;
-	std::vector< std::string > tempNames;
+	double waveletThreshold = 3.0;
+	int waveletType = 1;
+	int waveletLevels = 1;
+	int statisticsMode = 0;
+	int statisticsDecimation = 0;
+	
+	std::vector<SceneJob*> scenes;
+	
+	LandMask landMask;
+	if(options.pointMask)
+		options.landMask = &landMask;
+	
+	LandTileCache landCache;
+	if(!options.landCacheDir.empty())
+		options.landCache = &landCache;
+	
+	AreaOfInterest areaOfInterest;
+	if(!options.aoi.empty())
+	{
+		if(areaOfInterest.load(options.aoi) != 0)
+			return 1;
+		options.areaOfInterest = &areaOfInterest;
+	}
+	
+	/// Load ossim plugin system and GDAL plugin (for .N1 file support) once for the whole job file
+	ProcessingSession::instance()->initialize();
+	
+	if(!options.traceFile.empty())
+		TraceRecorder::instance()->start(options.traceFile);
 	
 	std::ifstream infile(argv[1]);
 	std::string line;
@@ -141,194 +455,892 @@ int main(int argc, char** argv)
 		processingType = 2;
 		convertType = "cfar/";
 	      break;
+	      case 9:
+		std::cout << "Running wavelet ship detection" << std::endl;
+		inputFilename = tokens.at(0);
+		inputFilenameSHP = tokens.at(1);
+		outputFolder = tokens.at(2);
+		ss.clear(); ss.str(tokens.at(4));
+		ss >> waveletThreshold;
+		ss.clear(); ss.str(tokens.at(5));
+		ss >> waveletType;
+		ss.clear(); ss.str(tokens.at(6));
+		ss >> waveletLevels;
+		ss.clear(); ss.str(tokens.at(7));
+		ss >> statisticsMode;
+		ss.clear(); ss.str(tokens.at(8));
+		ss >> statisticsDecimation;
+		processingType = 3;
+		convertType = "wavelet/";
+	      break;
 	      default:
 		break;
 	    }
 	    
-	std::cout << "Processing image: " << inputFilename << std::endl;
-	
 	/// Register all the required file names
 	ossimString drivePart,pathPart, filePart, extPart;
 	ossimFilename(inputFilename.c_str()).split(drivePart,pathPart,filePart,extPart);
 	
-	std::string inputName = outputFolder + convertType + filePart + ".tiff";
-	std::string inputNameFinal = outputFolder + convertType  + filePart + "Final.tiff";
-	std::string tempFileName = outputFolder + convertType  + filePart + "TEMP.tiff";
-
-	inputFileNames.push_back(inputFilename);
-	inputFilenamesSHP.push_back(inputFilenameSHP);
-	inputNames.push_back(inputName);
-	inputNameFinals.push_back(inputNameFinal);
-	tempNames.push_back(tempFileName);
+	SceneJob *scene = new SceneJob();
+	scene->inputFilename = inputFilename;
+	scene->inputFilenameSHP = inputFilenameSHP;
+	scene->filePart = filePart.c_str();
+	scene->processingType = processingType;
+	scene->globalThreshold = globalThreshold;
+	scene->scaleValue = scaleValue;
+	scene->burnValue = burnValue;
+	scene->guardSize = guardSize;
+	scene->neighbourSize = neighbourSize;
+	scene->cfarThreshold = cfarThreshold;
+	scene->waveletThreshold = waveletThreshold;
+	scene->waveletType = waveletType;
+	scene->waveletLevels = waveletLevels;
+	scene->statisticsMode = statisticsMode;
+	scene->statisticsDecimation = statisticsDecimation;
+	scene->warpFormat = warpFormat;
+	scene->inputName = outputFolder + convertType + scene->filePart + ".tiff";
+	scene->inputNameFinal = outputFolder + convertType + scene->filePart + "Final.tiff";
+	scene->tempFileName = outputFolder + convertType + scene->filePart + "TEMP.tiff";
+	scene->shipsName = outputFolder + convertType + scene->filePart + "Ships";
+	
+	/// Job lines on the same N1 share filePart (and convertType), the line number keeps them apart
+	std::ostringstream memoryName;
+	memoryName << "/vsimem/" << scenes.size() << "/" << convertType << scene->filePart;
+	scene->memoryName = memoryName.str();
+	scene->hasWindow = false;
+	scene->origin = ossimIpt(0, 0);
+	scene->metrics = options.metrics ? new PipelineMetrics(scene->inputFilename) : NULL;
+	scenes.push_back(scene);
+	
+	tokens.clear();
+	}
+	
+	if(options.batch)
+	  runBatch(scenes, options, landMask);
+	else
+	{
+	  /// Detect every scene (in-memory scenes are post-processed straight after detection)
+	  std::vector<int> results(scenes.size(), BatchScene::STAGE_NEXT);
+	  std::vector<bool> detected(scenes.size(), false);
+	  for (unsigned int i = 0; i < scenes.size(); i++)
+	  {
+	    if(detected[i])
+	      continue;
+	    
+	    /// Later job lines on the same N1 and land mask share this read of the scene
+	    std::vector<unsigned int> members(1, i);
+	    for (unsigned int j = i + 1; options.sharedTiles && j < scenes.size(); j++)
+	      if(scenes[j]->inputFilename == scenes[i]->inputFilename && scenes[j]->inputFilenameSHP == scenes[i]->inputFilenameSHP)
+		members.push_back(j);
+	    
+	    if(members.size() > 1)
+	    {
+	      std::vector<SceneJob*> group;
+	      for (unsigned int m = 0; m < members.size(); m++)
+		group.push_back(scenes[members[m]]);
+	      int result;
+	      {
+		MetricsScope scope(group[0]->metrics, "");
+		MetricsTimer timer(sceneStageNames[SCENE_DETECT]);
+		TraceSpan span(sceneStageNames[SCENE_DETECT], "stage");
+		result = detectShared(group, options, landMask);
+	      }
+	      if(result == 1)
+		exit(1);
+	      for (unsigned int m = 0; m < members.size() && !options.inMemory; m++)
+	      {
+		MetricsScope scope(group[m]->metrics, "");
+		countBytesWritten(group[m]->inputName);
+	      }
+	      for (unsigned int m = 0; m < members.size(); m++)
+		results[members[m]] = (result == 0) ? BatchScene::STAGE_NEXT : BatchScene::STAGE_DONE;
+	    }
+	    else
+	    if((results[i] = runSceneStage(*scenes[i], SCENE_DETECT, options, landMask)) == BatchScene::STAGE_FAILED)
+	      exit(1);
+	    
+	    for (unsigned int m = 0; m < members.size(); m++)
+	    {
+	      detected[members[m]] = true;
+	      if(options.inMemory && results[members[m]] == BatchScene::STAGE_NEXT)
+		results[members[m]] = runSceneStage(*scenes[members[m]], SCENE_SD, options, landMask);
+	    }
+	    
+	    std::cout << std::endl;
+	    std::cout << std::endl;
+	  }
+	  
+	  /// Then SD, georeferencing, warp and mask one scene at a time
+	  for (unsigned int i = 0; i < scenes.size(); i++)
+	  {
+	    for (int stage = SCENE_SD; stage < SCENE_STAGES && results[i] == BatchScene::STAGE_NEXT; stage++)
+	      results[i] = runSceneStage(*scenes[i], stage, options, landMask);
+	  }
+	}
+	
+	for (unsigned int i = 0; i < scenes.size(); i++)
+	{
+	  if(scenes[i]->metrics)
+	  {
+	    scenes[i]->metrics->writeReport(scenes[i]->shipsName + "Metrics.json");
+	    delete scenes[i]->metrics;
+	  }
+	  delete scenes[i];
+	}
+	
+	TraceRecorder::instance()->finish();
+	
+	GDALProcess::cleanup();
+	ProcessingSession::instance()->finalize();
+	
+	return 0;
+	
+}
 
-	/// Also load ossim plugin system and GDAL plugin (for .N1 file support).
-	ossimInit::instance()->initialize();
+/// Runs the detector chosen on the job line over the scene, into the detector tiff or (in memory) a Mat.
+/// Returns 2 when the AOI misses the scene, there is nothing to detect
+int detectScene(SceneJob &scene, const PipelineOptions &options, LandMask &landMask)
+{
+	/// The N1 is still arriving, detect it strip by strip
+	if(options.stream)
+	{
+	  if(options.areaOfInterest)
+	    std::cout << "The AOI is not applied to streamed scenes, the whole swath is detected" << std::endl;
+	  return streamScene(scene, options);
+	}
+	
+	std::cout << "Processing image: " << scene.inputFilename << std::endl;
+	
+	if(sceneWindow(scene, options) != 0)
+	  return 2;
 
 	/// Initialise single image chain
 	ossimRefPtr<ossimSingleImageChain> sic = new ossimSingleImageChain();
 	
 	/// Check if image is null
-	ossimImageHandler *testHandler = ossimImageHandlerRegistry::instance()->open(ossimFilename(inputFilename.c_str()));
+	ossimImageHandler *testHandler = openSceneHandler(scene.inputFilename, options);
 	if(testHandler == NULL) 
 	{
 	 cout << "Image file cannot be opened" << endl;
-	 exit(1);
+	 return 1;
 	}
-	else
+	
+	testHandler->close();
+	if (sic->open(ossimFilename(scene.inputFilename.c_str())))
 	{
-	    testHandler->close();
-	    if (sic->open(ossimFilename(inputFilename.c_str())))
+	  
+	  /// Classify the scene into land/sea cells so the filters skip land tiles
+	  LandTileGrid landGrid;
+	  LandTileGrid *sceneGrid = NULL;
+	  if(options.landSkip > 0 && buildLandGrid(scene.inputFilename, scene.inputFilenameSHP, options.landSkip, landMask, landGrid) == 0)
+	    sceneGrid = &landGrid;
+	  
+	  /// Tiles through a pool of detector chains, within the tile memory budget
+	  if(options.tileThreads != 1)
+	  {
+	    cv::Mat detectionImage;
+	    if(detectTiles(scene, options, sceneGrid, detectionImage) != 0)
 	    {
-	      
-	      /// Create a handle to the image.
-	      ossimImageHandler *handler = ossimImageHandlerRegistry::instance()->open(ossimFilename(inputFilename.c_str()));
-	      
-	      //sic->createRenderedChain();
-	      
-	      /// Get ossim-type pointer to image data
-	      ossimRefPtr<ossimImageData> imageSourceData;
-      
-	      /// Get image tile and use entire sattelite image.
-	      ossimIrect tileRect = handler->getBoundingRect(0);
-	      
-	      // Get the image data from the handler for the tile, in this case the entire image
-	      /// Use the handler to grab the image data and place it in the source file
-	      imageSourceData = handler->getTile(tileRect);
-	       
-	      /// Create filter
-	      if(processingType == 0)
-	      {
-		ossimSimpleFilter *filter = new ossimSimpleFilter(imageSourceData.get());
-		filter->setScaleValue(scaleValue);
-		filter->connectMyInputTo(0,handler);
-		
-		/// Write to tiff
-		ossimTiffWriter *writer = new ossimTiffWriter();
-		writer->setFilename(inputName);
-		writer->setGeotiffFlag(true);
-		writer->setOutputImageType("tiff_tiled_band_separate");
-		
-		/// Connect and execute
-		writer->connectMyInputTo(filter);
-		writer->execute();
-		writer->close();	    
-		
-	      }
-	      else
-	      if(processingType == 1)
-	      {
-		ossimGlobalFilter *filter = new ossimGlobalFilter(imageSourceData.get());
-		filter->setScaleValue(scaleValue);
-		filter->setThreshold(globalThreshold);
-		filter->connectMyInputTo(0,handler);
-		
-		/// Write to tiff
-		ossimTiffWriter *writer = new ossimTiffWriter();
-		writer->setFilename(inputName);
-		writer->setGeotiffFlag(true);
-		writer->setOutputImageType("tiff_tiled_band_separate");
-		
-		/// Connect and execute
-		writer->connectMyInputTo(filter);
-		writer->execute();
-		writer->close();
-		
-	      }
-	      else
-	      if(processingType == 2)
-	      {
-		ossimCFARFilter *filter = new ossimCFARFilter(imageSourceData.get());
-		filter->setScaleValue(scaleValue);
-		filter->setGuardSize(guardSize);
-		filter->setNeighbourSize(neighbourSize);
-		filter->setThreshold(cfarThreshold);
-		filter->setCFARMethod(0);		// O = OpenCV, 1 = indexing
-		filter->connectMyInputTo(0,handler);
-		
-		/// Write to tiff
-		ossimTiffWriter *writer = new ossimTiffWriter();
-		writer->setFilename(inputName);
-		writer->setGeotiffFlag(true);
-		writer->setOutputImageType("tiff_tiled_band_separate");
-		
-		/// Connect and execute
-		writer->connectMyInputTo(filter);
-		writer->execute();
-		writer->close();
-	      }
-	      else
-	      {
-		ossimSimpleFilter *filter = new ossimSimpleFilter(imageSourceData.get());
-		filter->setScaleValue(scaleValue);
-		filter->connectMyInputTo(0,handler);
-		
-		/// Write to tiff
-		ossimTiffWriter *writer = new ossimTiffWriter();
-		writer->setFilename(inputName);
-		writer->setGeotiffFlag(true);
-		writer->setOutputImageType("tiff_tiled_band_separate");
-		
-		/// Connect and execute
-		writer->connectMyInputTo(filter);
-		writer->execute();
-		writer->close();	  
-	      }
-
-	      handler->close();
-	      
+	      sic->close();
+	      return 1;
+	    }
+	    if(options.inMemory)
+	      scene.detectionImage = detectionImage;
+	    else
+	    {
+	      TraceSpan span("detection imwrite", "writer");
+	      cv::imwrite(scene.inputName.c_str(), detectionImage);
 	    }
 	    
 	    sic->close();
-	    tokens.clear();
-	    
-	  std::cout << std::endl;
-	  std::cout << std::endl;
+	    return 0;
 	  }
-}
-	  std::string inputName;
-	  std::string inputNameFinal;
-	  std::string tempFileName;
 	  
-	  for (unsigned int i = 0; i < tempNames.size(); i++)
+	  /// Create a handle to the image.
+	  ossimImageHandler *handler = openSceneHandler(scene.inputFilename, options);
+	  
+	  /// Tiles are pulled through the detector, the scene is never read whole
+	  ossimImageSource *filter = createDetector(scene, NULL, sceneGrid);
+	  filter->connectMyInputTo(0,handler);
+	  ossimIrect area = detectionArea(scene, filter);
+	  
+	  /// Read the next tiles of the scan while the detector works on this one
+	  ossimRefPtr<ossimPrefetchFilter> prefetch = 0;
+	  if(options.prefetch > 0)
 	  {
-	    inputFilename = inputFileNames.at(i);
-	    inputFilenameSHP = inputFilenamesSHP.at(i);
-	    inputName = inputNames.at(i);
-	    inputNameFinal = inputNameFinals.at(i);
-	    tempFileName = tempNames.at(i);
-	    
-	    //Process sd afterwards (temporary)
-	    processSD(inputName);
-	    
-	    // Use GDAL Processor to process image into masked geotiff images
-	    GDALProcess *gdalProcessor = new GDALProcess();
-	    std::cout << "Processing Image (Georeferencing)" << std::endl;
-	    double t = (double) cv::getTickCount();
-	    gdalProcessor->writeGEOTIFF(inputFilename,inputName, tempFileName);
-	    t = ((double)cv::getTickCount() - t)/cv::getTickFrequency();
-	    std::cout << "Processing Image (Georeferencing) completed in: " << t << " seconds" << std::endl;
-	    
-	    std::cout << "Processing Image (Warping to WGS84)" << std::endl;
-	    t = (double) cv::getTickCount();
-	    gdalProcessor->warpGEOTIFF(tempFileName, warpFormat, inputNameFinal);
-	    t = ((double)cv::getTickCount() - t)/cv::getTickFrequency();
-	    std::cout << "Processing Image (Warping to WGS84) completed in: " << t << " seconds" << std::endl;
+	    prefetch = new ossimPrefetchFilter();
+	    prefetch->setReadAhead(options.prefetch);
+	    prefetch->setScanArea(area);
+	    prefetch->connectMyInputTo(0,handler);
+	    filter->connectMyInputTo(0,prefetch.get());
+	  }
+	  
+	  /// Log or percentile scaling runs as its own stage, the detector then skips its lookup
+	  ossimRefPtr<ossimRadiometricFilter> scaling = createScaling(scene, options);
+	  if(scaling.valid())
+	  {
+	    scaling->connectMyInputTo(0,filter->getInput(0));
+	    filter->connectMyInputTo(0,scaling.get());
+	  }
+	  
+	  /// Write to tiff, or keep the detections in memory for the in-process pipeline
+	  if(options.inMemory)
+	    readDetection(filter, scene.detectionImage, area);
+	  else
+	    writeDetection(filter, scene.inputName, area);
+	  
+	  if(scaling.valid())
+	    scaling->disconnect();
+	  
+	  if(prefetch.valid())
+	  {
+	    prefetch->printStatistics();
 	    
-	    std::cout << "Processing Image (Land Masking)" << std::endl;
-	    t = (double) cv::getTickCount();
-	    gdalProcessor->maskGEOTIFF(inputFilenameSHP,burnValue,inputNameFinal);
-	    t = ((double)cv::getTickCount() - t)/cv::getTickFrequency();
-	    std::cout << "Processing Image (Land Masking) completed in: " << t << " seconds" << std::endl;
-	   
+	    /// Drop the last reference so the destructor joins the read-ahead thread before the handler closes
+	    prefetch->disconnect();
+	    prefetch = 0;
 	  }
+
+	  handler->close();
+	}
 	
+	sic->close();
 	return 0;
-	
 }
 
-void processSD(std::string &inputName)
+/// Handler for the detector input: the memory mapped N1 reader when asked for and the
+/// product is a detected ASAR one, else whatever the registry (GDAL plugin) opens
+ossimImageHandler *openSceneHandler(const std::string &inputFilename, const PipelineOptions &options)
+{
+  if(options.mappedN1)
+  {
+    ossimN1MappedHandler *handler = new ossimN1MappedHandler();
+    if(handler->open(ossimFilename(inputFilename.c_str())))
+      return handler;
+    delete handler;
+  }
+  return ossimImageHandlerRegistry::instance()->open(ossimFilename(inputFilename.c_str()));
+}
+
+/// Detection on an N1 that is still being downloaded: the headers are parsed as soon as they land,
+/// then full-width strips are detected once their lines and the window halo below them are on disk.
+/// Each strip's blobs are written to <ships>Stream.csv straight away (provisional, in pixel/line);
+/// the full detector image then goes through the normal post-processing.
+int streamScene(SceneJob &scene, const PipelineOptions &options)
+{
+  std::cout << "Streaming image: " << scene.inputFilename << std::endl;
+  double start = (double) cv::getTickCount();
+  
+  ossimRefPtr<ossimN1MappedHandler> handler = new ossimN1MappedHandler();
+  handler->setStreaming(true);
+  for(double waited = 0; !handler->open(ossimFilename(scene.inputFilename.c_str())); waited += 0.5)
+  {
+    if(waited >= options.streamTimeout)
+    {
+      cout << "Timed out waiting for the N1 headers" << endl;
+      return 1;
+    }
+    OpenThreads::Thread::microSleep(500000);
+  }
+  
+  ossimRefPtr<ossimImageSource> filter = createDetector(scene, NULL, NULL);
+  filter->connectMyInputTo(0, handler.get());
+  
+  // Percentiles need the whole scene, a stream only takes the log scaling
+  ossimRefPtr<ossimRadiometricFilter> scaling = (options.scalingMode == 1) ? createScaling(scene, options) : NULL;
+  if(scaling.valid())
+  {
+    scaling->connectMyInputTo(0, handler.get());
+    filter->connectMyInputTo(0, scaling.get());
+  }
+  
+  ossim_int32 width = handler->getNumberOfSamples(0);
+  ossim_int32 height = handler->getNumberOfLines(0);
+  ossim_int32 tileWidth = filter->getTileWidth();
+  ossim_int32 tileHeight = filter->getTileHeight();
+  
+  // Tiles overlap by the window halo, only their centre rows are kept
+  // The halo is capped so a strip keeps at least half a tile of new rows
+  int halo = (scene.processingType == 2) ? scene.neighbourSize / 2 : 0;
+  if(halo > (int) tileHeight / 4)
+  {
+    cout << "Warning: CFAR window halo " << halo << " cut to " << tileHeight / 4 << " lines for " << tileHeight
+	 << " line tiles, detections near strip edges may differ from a whole scene run" << endl;
+    halo = tileHeight / 4;
+  }
+  ossim_int32 step = tileHeight - 2 * halo;
+  
+  cv::Mat detectionImage(height, width, CV_8UC1, cv::Scalar::all(0));
+  std::ofstream stream((scene.shipsName + "Stream.csv").c_str());
+  stream << "line,pixel,area,width,height" << std::endl;
+  
+  for(ossim_int32 y = 0; y < height; y += step)
+  {
+    ossim_int32 rows = std::min(step, height - y);
+    
+    /// Wait for the strip and the halo below it to land
+    ossim_uint32 needed = std::min(y + step + halo, height);
+    ossim_uint32 available = handler->getAvailableLines();
+    for(double idle = 0; available < needed; )
+    {
+      if(idle >= options.streamTimeout)
+      {
+	cout << "Timed out waiting for line " << needed << " of " << height << endl;
+	filter->disconnect();
+	if(scaling.valid())
+	  scaling->disconnect();
+	return 1;
+      }
+      OpenThreads::Thread::microSleep(500000);
+      ossim_uint32 now = handler->getAvailableLines();
+      idle = (now == available) ? idle + 0.5 : 0;
+      available = now;
+    }
+    
+    for(ossim_int32 x = 0; x < width; x += tileWidth)
+    {
+      ossimIrect tileRect(x, y - halo, x + tileWidth - 1, y - halo + tileHeight - 1);
+      ossimRefPtr<ossimImageData> data = filter->getTile(tileRect, 0);
+      if(!data.valid() || data->getDataObjectStatus() == OSSIM_NULL || data->getDataObjectStatus() == OSSIM_EMPTY)
+	continue;
+      
+      int columns = std::min(tileWidth, width - x);
+      cv::Mat tile(data->getHeight(), data->getWidth(), CV_8UC1, data->getBuf(0));
+      cv::Mat outputRoi = detectionImage(cv::Rect(x, y, columns, rows));
+      tile(cv::Rect(0, halo, columns, rows)).copyTo(outputRoi);
+    }
+    
+    /// Blobs of this strip, blobs across the strip edges are only whole in the final product
+    cv::Mat strip = detectionImage(cv::Rect(0, y, width, rows)).clone(), sdImage;
+    std::vector<ShipDetection> detections;
+    processSD(strip, sdImage, detections);
+    for(unsigned int i = 0; i < detections.size(); i++)
+      stream << detections[i].dfLine + y << "," << detections[i].dfPixel << "," << detections[i].nArea << ","
+	     << detections[i].nWidth << "," << detections[i].nHeight << std::endl;
+    stream.flush();
+    
+    double t = ((double)cv::getTickCount() - start)/cv::getTickFrequency();
+    std::cout << "Strip lines " << y << "-" << y + rows - 1 << ": " << detections.size() << " detections at " << t << " seconds" << std::endl;
+  }
+  
+  filter->disconnect();
+  if(scaling.valid())
+    scaling->disconnect();
+  handler->close();
+  
+  if(options.inMemory)
+    scene.detectionImage = detectionImage;
+  else
+  {
+    TraceSpan span("detection imwrite", "writer");
+    cv::imwrite(scene.inputName.c_str(), detectionImage);
+  }
+  return 0;
+}
+
+/// Copies sourceName into outputName at rate MB/s, flushing every chunk, to exercise -stream
+int appendN1(const std::string &sourceName, const std::string &outputName, double rate)
+{
+  std::ifstream input(sourceName.c_str(), std::ios::in | std::ios::binary);
+  std::ofstream output(outputName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if(!input.good() || !output.good())
+  {
+    cout << "Cannot open " << sourceName << " or " << outputName << endl;
+    return 1;
+  }
+  
+  const int chunkSize = 1024 * 1024;
+  std::vector<char> chunk(chunkSize);
+  unsigned int sleep = (rate > 0) ? (unsigned int)(1000000.0 / rate) : 0;
+  while(input.read(&chunk[0], chunkSize) || input.gcount() > 0)
+  {
+    output.write(&chunk[0], input.gcount());
+    output.flush();
+    OpenThreads::Thread::microSleep(sleep);
+  }
+  return 0;
+}
+
+/// The detector chosen on the job line, not yet connected to a handler
+ossimImageSource *createDetector(const SceneJob &scene, ossimObject *owner, LandTileGrid *landGrid)
+{
+  if(scene.processingType == 1)
+  {
+    ossimGlobalFilter *filter = new ossimGlobalFilter(owner);
+    filter->setScaleValue(scene.scaleValue);
+    filter->setLandGrid(landGrid);
+    filter->setThreshold(scene.globalThreshold);
+    return filter;
+  }
+  
+  if(scene.processingType == 2)
+  {
+    ossimCFARFilter *filter = new ossimCFARFilter(owner);
+    filter->setScaleValue(scene.scaleValue);
+    filter->setLandGrid(landGrid);
+    filter->setGuardSize(scene.guardSize);
+    filter->setNeighbourSize(scene.neighbourSize);
+    filter->setThreshold(scene.cfarThreshold);
+    filter->setCFARMethod(0);		// O = OpenCV, 1 = indexing
+    return filter;
+  }
+  
+  if(scene.processingType == 3)
+  {
+    ossimWaveletFilter *filter = new ossimWaveletFilter(owner);
+    filter->setScaleValue(scene.scaleValue);
+    filter->setLandGrid(landGrid);
+    filter->setThreshold(scene.waveletThreshold);
+    filter->setWaveletType(scene.waveletType);
+    filter->setWaveletLevels(scene.waveletLevels);
+    filter->setStatisticsMode(scene.statisticsMode);
+    filter->setStatisticsDecimation(scene.statisticsDecimation);
+    return filter;
+  }
+  
+  ossimSimpleFilter *filter = new ossimSimpleFilter(owner);
+  filter->setScaleValue(scene.scaleValue);
+  filter->setLandGrid(landGrid);
+  return filter;
+}
+
+/// The N1 to 8 bit stage for -logscale/-percentilescale, not yet connected. NULL when the
+/// detectors keep their own linear scaling
+ossimRadiometricFilter *createScaling(const SceneJob &scene, const PipelineOptions &options)
+{
+  if(options.scalingMode == 0)
+    return NULL;
+  
+  ossimRadiometricFilter *filter = new ossimRadiometricFilter();
+  filter->setScalingMode(options.scalingMode);
+  filter->setScaleValue(scene.scaleValue);
+  if(options.scalingMode == 1)
+    filter->setDbRange(options.scalingLow, options.scalingHigh);
+  else
+    filter->setPercentiles(options.scalingLow, options.scalingHigh);
+  return filter;
+}
+
+/// The AOI as a pixel/line window of the scene, grown by the detector halo; 1 when the AOI misses the
+/// scene. Without an AOI, or tie points to place it, the whole scene is detected
+int sceneWindow(SceneJob &scene, const PipelineOptions &options)
+{
+  scene.hasWindow = false;
+  scene.origin = ossimIpt(0, 0);
+  if(options.areaOfInterest == NULL)
+    return 0;
+  
+  TiePointGeocoder geocoder;
+  if(geocoder.load(scene.inputFilename) != 0)
+  {
+    std::cout << "No usable tie points in " << scene.inputFilename << ", the AOI is not applied" << std::endl;
+    return 0;
+  }
+  
+  int halo = (scene.processingType == 2) ? scene.neighbourSize / 2 : 0;
+  int xOff, yOff, xSize, ySize;
+  if(options.areaOfInterest->getPixelWindow(geocoder, halo, xOff, yOff, xSize, ySize) != 0)
+  {
+    std::cout << "The AOI does not cover " << scene.inputFilename << ", skipped" << std::endl;
+    return 1;
+  }
+  
+  scene.window = ossimIrect(xOff, yOff, xOff + xSize - 1, yOff + ySize - 1);
+  scene.hasWindow = true;
+  std::cout << "AOI window " << xSize << "x" << ySize << " at (" << xOff << ", " << yOff << ") of "
+	    << geocoder.getRasterXSize() << "x" << geocoder.getRasterYSize() << std::endl;
+  return 0;
+}
+
+/// Tiles the detector runs over: the whole scene, or the AOI window stretched to the tile grid
+/// (so the tiles are the ones a whole scene run would see). Sets the scene's origin
+ossimIrect detectionArea(SceneJob &scene, ossimImageSource *filter)
+{
+  ossimIrect bounds = filter->getBoundingRect(0);
+  ossimIrect area = bounds;
+  if(scene.hasWindow)
+  {
+    area = scene.window;
+    area.stretchToTileBoundary(ossimIpt(filter->getTileWidth(), filter->getTileHeight()));
+    area = area.clipToRect(bounds);
+  }
+  scene.origin = area.ul();
+  return area;
+}
+
+/// Detections found in a detector image starting at origin, back into N1 pixel/line
+void offsetDetections(std::vector<ShipDetection> &detections, const ossimIpt &origin)
+{
+  for(unsigned int i = 0; i < detections.size(); i++)
+  {
+    detections[i].dfPixel += origin.x;
+    detections[i].dfLine += origin.y;
+  }
+}
+
+/// Size of an output (on disk or in /vsimem/) into the scene's bytes_written counter
+void countBytesWritten(const std::string &filename)
+{
+  VSIStatBufL sStat;
+  if(PipelineMetrics::current() && VSIStatL(filename.c_str(), &sStat) == 0)
+    PipelineMetrics::addCount("bytes_written", sStat.st_size);
+}
+
+/// Copies detector tiles into the first band of a single 8-bit image
+class DetectionTileConsumer : public TileConsumer
+{
+public:
+  DetectionTileConsumer(cv::Mat &image, const ossimIrect &imageBounds)
+    : outputImage(image), bounds(imageBounds) {}
+  
+  void consume(const ossimIrect &tileRect, ossimImageData *data)
+  {
+    // Tiles on the right and bottom edges hang over the image
+    int width = std::min((ossim_int32) tileRect.width(), bounds.lr().x - tileRect.ul().x + 1);
+    int height = std::min((ossim_int32) tileRect.height(), bounds.lr().y - tileRect.ul().y + 1);
+    cv::Mat tile(data->getHeight(), data->getWidth(), CV_8UC1, data->getBuf(0));
+    cv::Mat outputRoi = outputImage(cv::Rect(tileRect.ul().x - bounds.ul().x, tileRect.ul().y - bounds.ul().y, width, height));
+    tile(cv::Rect(0, 0, width, height)).copyTo(outputRoi);
+  }
+  
+private:
+  cv::Mat &outputImage;
+  ossimIrect bounds;
+};
+
+/// Runs the scene's detector on options.tileThreads chains (own handler and filter each),
+/// with the tiles in flight limited by their working set against options.tileMemory
+int detectTiles(SceneJob &scene, const PipelineOptions &options, LandTileGrid *landGrid, cv::Mat &outputImage)
+{
+  int nThreads = (options.tileThreads > 0) ? options.tileThreads : CPLGetNumCPUs();
+  
+  std::vector<ossimImageHandler*> handlers;
+  std::vector<ossimImageSource*> chains;
+  std::vector< ossimRefPtr<ossimRadiometricFilter> > scalings;
+  for(int i = 0; i < std::max(nThreads, 1); i++)
+  {
+    ossimImageHandler *handler = openSceneHandler(scene.inputFilename, options);
+    if(handler == NULL)
+      break;
+    ossimImageSource *filter = createDetector(scene, NULL, landGrid);
+    ossimRadiometricFilter *scaling = createScaling(scene, options);
+    if(scaling != NULL)
+    {
+      scaling->connectMyInputTo(0, handler);
+      filter->connectMyInputTo(0, scaling);
+      scalings.push_back(scaling);
+    }
+    else
+      filter->connectMyInputTo(0, handler);
+    handlers.push_back(handler);
+    chains.push_back(filter);
+  }
+  if(chains.empty())
+    return 1;
+  
+  // The scaling table (and the percentile histogram behind it) is built once, by the first chain
+  for(unsigned int i = 1; i < scalings.size(); i++)
+  {
+    scalings[i]->initialize();
+    scalings[i]->setLut(scalings[0]->getLut());
+  }
+  
+  // Scene statistics are gathered once, by the first chain, and handed to the others
+  ossimWaveletFilter *wavelet = dynamic_cast<ossimWaveletFilter*>(chains[0]);
+  if(wavelet != NULL && wavelet->getStatisticsMode() == 1)
+  {
+    wavelet->initialize();
+    wavelet->computeSceneStatistics();
+    for(unsigned int i = 1; i < chains.size(); i++)
+      dynamic_cast<ossimWaveletFilter*>(chains[i])->copySceneStatistics(*wavelet);
+  }
+  
+  // Order statistic windows hold far more per tile than a global threshold
+  int windowRadius = (scene.processingType == 2) ? scene.neighbourSize / 2 : 0;
+  TileScheduler scheduler;
+  scheduler.setMemoryBudget(options.tileMemory);
+  scheduler.setWorkingSet(TileScheduler::estimateWorkingSet(chains[0]->getTileWidth(), chains[0]->getTileHeight(),
+							   handlers[0]->getNumberOfOutputBands(),
+							   handlers[0]->getOutputScalarType(), windowRadius));
+  
+  ossimIrect area = detectionArea(scene, chains[0]);
+  outputImage = cv::Mat(area.height(), area.width(), CV_8UC1, cv::Scalar::all(0));
+  DetectionTileConsumer consumer(outputImage, area);
+  int result = scheduler.run(chains, &consumer, area);
+  
+  for(unsigned int i = 0; i < scalings.size(); i++)
+    scalings[i]->disconnect();
+  for(unsigned int i = 0; i < chains.size(); i++)
+  {
+    delete chains[i];
+    handlers[i]->close();
+    delete handlers[i];
+  }
+  return result;
+}
+
+/// Runs the detectors of several job lines on the same N1 in one pass: one handler, scaled once
+/// when the lines agree on the scale, behind an ossimCacheTileSource that every detector reads
+int detectShared(std::vector<SceneJob*> &group, const PipelineOptions &options, LandMask &landMask)
+{
+  SceneJob &first = *group[0];
+  std::cout << "Processing image: " << first.inputFilename << " (" << group.size() << " detectors, shared tiles)" << std::endl;
+  
+  /// One window over the scene, wide enough for the largest detector halo
+  if(sceneWindow(first, options) != 0)
+    return 2;
+  for (unsigned int i = 1; i < group.size(); i++)
+  {
+    sceneWindow(*group[i], options);
+    if(first.hasWindow && group[i]->hasWindow)
+      first.window = first.window.combine(group[i]->window);
+  }
+  
+  ossimImageHandler *handler = openSceneHandler(first.inputFilename, options);
+  if(handler == NULL)
+  {
+    cout << "Image file cannot be opened" << endl;
+    return 1;
+  }
+  
+  LandTileGrid landGrid;
+  LandTileGrid *sceneGrid = NULL;
+  if(options.landSkip > 0 && buildLandGrid(first.inputFilename, first.inputFilenameSHP, options.landSkip, landMask, landGrid) == 0)
+    sceneGrid = &landGrid;
+  
+  /// Scale to 8 bit before the cache, the detectors then skip their own lookup
+  bool sameScale = true;
+  for (unsigned int i = 1; i < group.size(); i++)
+    sameScale = sameScale && group[i]->scaleValue == first.scaleValue;
+  
+  ossimImageSource *source = handler;
+  ossimRefPtr<ossimRadiometricFilter> radiometric = createScaling(first, options);
+  if(!radiometric.valid() && sameScale)
+  {
+    radiometric = new ossimRadiometricFilter();
+    radiometric->setScaleValue(first.scaleValue);
+  }
+  if(radiometric.valid())
+  {
+    radiometric->connectMyInputTo(0, handler);
+    source = radiometric.get();
+  }
+  
+  ossimRefPtr<ossimCacheTileSource> cache = new ossimCacheTileSource();
+  cache->connectMyInputTo(0, source);
+  cache->initialize();
+  
+  std::vector< ossimRefPtr<ossimImageSource> > filters;
+  for (unsigned int i = 0; i < group.size(); i++)
+  {
+    filters.push_back(createDetector(*group[i], NULL, sceneGrid));
+    filters.back()->connectMyInputTo(0, cache.get());
+  }
+  
+  ossimIrect bounds = detectionArea(first, filters[0].get());
+  for (unsigned int i = 1; i < group.size(); i++)
+    group[i]->origin = first.origin;
+  ossim_int32 tileWidth = filters[0]->getTileWidth();
+  ossim_int32 tileHeight = filters[0]->getTileHeight();
+  
+  std::vector<cv::Mat> images(group.size());
+  std::vector<DetectionTileConsumer*> consumers;
+  for (unsigned int i = 0; i < group.size(); i++)
+  {
+    images[i] = cv::Mat(bounds.height(), bounds.width(), CV_8UC1, cv::Scalar::all(0));
+    consumers.push_back(new DetectionTileConsumer(images[i], bounds));
+  }
+  
+  /// Every detector takes the tile while it is in the cache
+  double t = (double) cv::getTickCount();
+  for(ossim_int32 y = bounds.ul().y; y <= bounds.lr().y; y += tileHeight)
+  {
+    for(ossim_int32 x = bounds.ul().x; x <= bounds.lr().x; x += tileWidth)
+    {
+      ossimIrect tileRect(x, y, x + tileWidth - 1, y + tileHeight - 1);
+      for (unsigned int i = 0; i < filters.size(); i++)
+      {
+	ossimRefPtr<ossimImageData> data = filters[i]->getTile(tileRect, 0);
+	if(data.valid() && data->getDataObjectStatus() != OSSIM_NULL && data->getDataObjectStatus() != OSSIM_EMPTY)
+	  consumers[i]->consume(tileRect, data.get());
+      }
+    }
+  }
+  t = ((double)cv::getTickCount() - t)/cv::getTickFrequency();
+  std::cout << "Shared detection of " << group.size() << " detectors completed in: " << t << " seconds" << std::endl;
+  
+  for (unsigned int i = 0; i < group.size(); i++)
+  {
+    delete consumers[i];
+    if(options.inMemory)
+      group[i]->detectionImage = images[i];
+    else
+    {
+      TraceSpan span("detection imwrite", "writer");
+      cv::imwrite(group[i]->inputName.c_str(), images[i]);
+    }
+    filters[i]->disconnect();
+  }
+  
+  cache->flush();
+  cache->disconnect();
+  if(radiometric.valid())
+    radiometric->disconnect();
+  handler->close();
+  delete handler;
+  return 0;
+}
+
+/// One stage of a scene, returns BatchScene::STAGE_NEXT while there is more to do
+int runSceneStage(SceneJob &scene, int stage, const PipelineOptions &options, LandMask &landMask)
+{
+  // Stage timers nest the tile, read and detector timers of the threads they start
+  MetricsScope scope(scene.metrics, "");
+  MetricsTimer timer(sceneStageNames[stage]);
+  TraceSpan span(sceneStageNames[stage], "stage");
+  
+  if(stage == SCENE_DETECT)
+  {
+    int result = detectScene(scene, options, landMask);
+    if(result == 0 && !options.inMemory)
+      countBytesWritten(scene.inputName);
+    if(result == 2)
+      return BatchScene::STAGE_DONE;
+    return result == 0 ? BatchScene::STAGE_NEXT : BatchScene::STAGE_FAILED;
+  }
+  
+  if(stage == SCENE_SD)
+  {
+    // The in-memory chain runs the remaining stages in one go on /vsimem/
+    if(options.inMemory)
+    {
+      processInMemory(scene.detectionImage, scene.inputFilename, scene.inputFilenameSHP, scene.memoryName,
+		      scene.warpFormat, scene.burnValue, options, scene.inputNameFinal, scene.shipsName, scene.origin);
+      scene.detectionImage.release();
+      return BatchScene::STAGE_DONE;
+    }
+    
+    //Process sd afterwards (temporary)
+    processSD(scene.inputName, scene.detections);
+    offsetDetections(scene.detections, scene.origin);
+    countBytesWritten(scene.inputName);
+    
+    // Ship positions straight from the tie points, no raster warp or mask
+    if(options.geocode)
+    {
+      geocodeDetections(scene.inputFilename, scene.inputFilenameSHP, scene.detections, scene.shipsName, options);
+      return BatchScene::STAGE_DONE;
+    }
+    return BatchScene::STAGE_NEXT;
+  }
+  
+  // Use GDAL Processor to process image into masked geotiff images
+  GDALProcess gdalProcessor;
+  gdalProcessor.setWarpThreads(options.warpThreads);
+  gdalProcessor.setWarpChunkSize(options.warpChunkSize);
+  gdalProcessor.setWarpMemoryLimit(options.warpMemoryLimit);
+  gdalProcessor.setWarpErrorThreshold(options.warpErrorThreshold);
+  gdalProcessor.setSourceOffset(scene.origin.x, scene.origin.y);
+  
+  if(stage == SCENE_GEOREFERENCE)
+  {
+    std::cout << "Processing Image (Georeferencing)" << std::endl;
+    double t = (double) cv::getTickCount();
+    if(options.gcpInPlace)
+    {
+      gdalProcessor.attachGCPs(scene.inputFilename, scene.inputName);
+      scene.georeferencedName = scene.inputName;
+    }
+    else
+    {
+      gdalProcessor.writeGEOTIFF(scene.inputFilename, scene.inputName, scene.tempFileName);
+      scene.georeferencedName = scene.tempFileName;
+      countBytesWritten(scene.tempFileName);
+    }
+    t = ((double)cv::getTickCount() - t)/cv::getTickFrequency();
+    std::cout << "Processing Image (Georeferencing) completed in: " << t << " seconds" << std::endl;
+  }
+  else
+  if(stage == SCENE_WARP)
+  {
+    std::cout << "Processing Image (Warping to WGS84)" << std::endl;
+    double t = (double) cv::getTickCount();
+    gdalProcessor.warpGEOTIFF(scene.georeferencedName, scene.warpFormat, scene.inputNameFinal);
+    countBytesWritten(scene.inputNameFinal);
+    t = ((double)cv::getTickCount() - t)/cv::getTickFrequency();
+    std::cout << "Processing Image (Warping to WGS84) completed in: " << t << " seconds" << std::endl;
+  }
+  else
+  if(stage == SCENE_MASK)
+    maskScene(&gdalProcessor, scene.inputFilenameSHP, scene.burnValue, scene.inputNameFinal, options);
+  
+  return stage + 1 < SCENE_STAGES ? BatchScene::STAGE_NEXT : BatchScene::STAGE_DONE;
+}
+
+/// A SceneJob run by the BatchExecutor
+class BatchSceneJob : public BatchScene
+{
+public:
+  BatchSceneJob(SceneJob *job, const PipelineOptions &pipelineOptions, LandMask &sharedLandMask)
+    : scene(job), options(pipelineOptions), landMask(sharedLandMask), memoryEstimate(0)
+  {
+    // Input samples, detections, SD image and warp working buffers, about 8 bytes a pixel
+    GDALDatasetH hDS = GDALOpen(scene->inputFilename.c_str(), GA_ReadOnly);
+    if(hDS != NULL)
+    {
+      memoryEstimate = 8.0 * GDALGetRasterXSize(hDS) * GDALGetRasterYSize(hDS);
+      GDALClose(hDS);
+    }
+  }
+  
+  std::string getName(){return scene->filePart;};
+  double getMemoryEstimate(){return memoryEstimate;};
+  int runStage(int nStage){return runSceneStage(*scene, nStage, options, landMask);};
+  
+private:
+  SceneJob *scene;
+  const PipelineOptions &options;
+  LandMask &landMask;
+  double memoryEstimate;
+};
+
+/// Pipelines the scenes through the stages, one thread pool per stage
+int runBatch(std::vector<SceneJob*> &scenes, const PipelineOptions &options, LandMask &landMask)
+{
+  int stageThreads[SCENE_STAGES] = { 1, 1, 1, 1, 1 };
+  
+  std::istringstream iss(options.stageThreads);
+  std::string value;
+  for(int stage = 0; stage < SCENE_STAGES && std::getline(iss, value, ','); stage++)
+    stageThreads[stage] = std::max(atoi(value.c_str()), 1);
+  
+  BatchExecutor executor;
+  for(int stage = 0; stage < SCENE_STAGES; stage++)
+    executor.addStage(sceneStageNames[stage], stageThreads[stage]);
+  executor.setMemoryBudget(options.memoryBudget);
+  
+  for(unsigned int i = 0; i < scenes.size(); i++)
+    executor.add(new BatchSceneJob(scenes[i], options, landMask));
+  
+  return executor.run();
+}
+
+void processSD(std::string &inputName, std::vector<ShipDetection> &detections)
 {
   cv::Mat inputImage, outputImage;
+  
+  //Open Image and then make it a binary image
+  inputImage = cv::imread(inputName.c_str(), CV_LOAD_IMAGE_GRAYSCALE);   // Read the file
+  
+  processSD(inputImage, outputImage, detections);
+  
+  TraceSpan span("sd imwrite", "writer");
+  cv::imwrite(inputName.c_str(), outputImage);
+ 
+}
+
+void processSD(cv::Mat &inputImage, cv::Mat &outputImage, std::vector<ShipDetection> &detections)
+{
   double bandwidth = 10;
   int spacing = 2;
   int sdType = 0;
@@ -336,9 +1348,6 @@ void processSD(std::string &inputName)
   double rate = 0.5;
   int iterMax = 1000;
   
-  
-  //Open Image and then make it a binary image
-  inputImage = cv::imread(inputName.c_str(), CV_LOAD_IMAGE_GRAYSCALE);   // Read the file
   inputImage = inputImage > 0;
   
   //As it stands there isn't a way to access the whole satellite image at once through OSSIM so
@@ -351,8 +1360,269 @@ void processSD(std::string &inputName)
   filter2->setDescendRate(rate);
   filter2->setMaxIterations(iterMax);
   filter2->simpleSD(inputImage, outputImage);
+  
+  // Blob stage output, positions are geocoded later
+  const std::vector<cv::Point2i> &centres = filter2->getDetectedCentres();
+  const std::vector<int> &areas = filter2->getDetectedAreas();
+  const std::vector<cv::Rect> &bounds = filter2->getDetectedBounds();
+  PipelineMetrics::addCount("detections", centres.size());
+  detections.clear();
+  for(unsigned int i = 0; i < centres.size(); i++)
+  {
+    ShipDetection detection;
+    detection.dfPixel = centres[i].x;
+    detection.dfLine = centres[i].y;
+    detection.dfLat = detection.dfLong = 0;
+    detection.nArea = areas[i];
+    detection.nWidth = bounds[i].width;
+    detection.nHeight = bounds[i].height;
+    detections.push_back(detection);
+  }
   delete(filter2);
+}
+
+void writeDetection(ossimImageSource *filter, const std::string &inputName, const ossimIrect &area)
+{
+  /// Write to tiff
+  ossimTiffWriter *writer = new ossimTiffWriter();
+  writer->setFilename(inputName);
+  writer->setGeotiffFlag(true);
+  writer->setOutputImageType("tiff_tiled_band_separate");
   
-  cv::imwrite(inputName.c_str(), outputImage);
- 
+  /// Connect and execute
+  writer->connectMyInputTo(filter);
+  writer->setAreaOfInterest(area);
+  {
+    TraceSpan span("tiff writer", "writer");
+    writer->execute();
+  }
+  writer->close();
+}
+
+/// Pulls the detector output tile by tile into a single 8-bit image (first band) of the area
+void readDetection(ossimImageSource *filter, cv::Mat &outputImage, const ossimIrect &area)
+{
+  ossimIrect bounds = area;
+  ossim_int32 tileWidth = filter->getTileWidth();
+  ossim_int32 tileHeight = filter->getTileHeight();
+  
+  outputImage = cv::Mat(bounds.height(), bounds.width(), CV_8UC1, cv::Scalar::all(0));
+  DetectionTileConsumer consumer(outputImage, bounds);
+  
+  for(ossim_int32 y = bounds.ul().y; y <= bounds.lr().y; y += tileHeight)
+  {
+    for(ossim_int32 x = bounds.ul().x; x <= bounds.lr().x; x += tileWidth)
+    {
+      ossimIrect tileRect(x, y, x + tileWidth - 1, y + tileHeight - 1);
+      ossimRefPtr<ossimImageData> data = filter->getTile(tileRect, 0);
+      if(!data.valid() || data->getDataObjectStatus() == OSSIM_NULL || data->getDataObjectStatus() == OSSIM_EMPTY)
+	continue;
+      
+      consumer.consume(tileRect, data.get());
+    }
+  }
+}
+
+/// Ship detection post-processing with the intermediates kept in /vsimem/, only Final.tiff is written to disk
+void processInMemory(cv::Mat &detectionImage, const std::string &inputFilename,
+		     const std::string &inputFilenameSHP, const std::string &memoryName,
+		     const std::string &warpFormat, int burnValue, const PipelineOptions &options,
+		     const std::string &inputNameFinal, const std::string &shipsName, const ossimIpt &origin)
+{
+  std::string tempFileName = memoryName + "TEMP.tiff";
+  std::string warpFileName = memoryName + "Final.tiff";
+  
+  cv::Mat sdImage;
+  std::vector<ShipDetection> detections;
+  processSD(detectionImage, sdImage, detections);
+  offsetDetections(detections, origin);
+  detectionImage.release();
+  
+  if(options.geocode)
+  {
+    geocodeDetections(inputFilename, inputFilenameSHP, detections, shipsName, options);
+    return;
+  }
+  
+  GDALProcess *gdalProcessor = new GDALProcess();
+  gdalProcessor->setWarpThreads(options.warpThreads);
+  gdalProcessor->setWarpChunkSize(options.warpChunkSize);
+  gdalProcessor->setWarpMemoryLimit(options.warpMemoryLimit);
+  gdalProcessor->setWarpErrorThreshold(options.warpErrorThreshold);
+  gdalProcessor->setSourceOffset(origin.x, origin.y);
+  
+  std::cout << "Processing Image (Georeferencing)" << std::endl;
+  double t = (double) cv::getTickCount();
+  gdalProcessor->writeGEOTIFF(inputFilename, sdImage.data, sdImage.cols, sdImage.rows, (int)sdImage.step, tempFileName);
+  sdImage.release();
+  t = ((double)cv::getTickCount() - t)/cv::getTickFrequency();
+  PipelineMetrics::addTime(sceneStageNames[SCENE_GEOREFERENCE], t);
+  std::cout << "Processing Image (Georeferencing) completed in: " << t << " seconds" << std::endl;
+  
+  std::cout << "Processing Image (Warping to WGS84)" << std::endl;
+  t = (double) cv::getTickCount();
+  gdalProcessor->warpGEOTIFF(tempFileName, warpFormat, warpFileName);
+  gdalProcessor->removeGEOTIFF(tempFileName);
+  t = ((double)cv::getTickCount() - t)/cv::getTickFrequency();
+  PipelineMetrics::addTime(sceneStageNames[SCENE_WARP], t);
+  std::cout << "Processing Image (Warping to WGS84) completed in: " << t << " seconds" << std::endl;
+  
+  {
+    MetricsTimer timer(sceneStageNames[SCENE_MASK]);
+    maskScene(gdalProcessor, inputFilenameSHP, burnValue, warpFileName, options);
+  }
+  
+  {
+    TraceSpan span("final copy", "writer");
+    gdalProcessor->copyGEOTIFF(warpFileName, inputNameFinal);
+  }
+  gdalProcessor->removeGEOTIFF(warpFileName);
+  countBytesWritten(inputNameFinal);
+  
+  delete gdalProcessor;
+}
+
+/// Land masks the warped raster, from the tile cache when one is configured
+void maskScene(GDALProcess *gdalProcessor, const std::string &inputFilenameSHP, int burnValue,
+	       const std::string &rasterName, const PipelineOptions &options)
+{
+  std::cout << "Processing Image (Land Masking)" << std::endl;
+  double t = (double) cv::getTickCount();
+  
+  bool masked = false;
+  if(options.landCache)
+  {
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(landMutex);
+
+    // Built or brought up to date once per coastline, then only mapped
+    if(options.landCache->getSourceFilename() != inputFilenameSHP)
+    {
+      LandMask buildMask;
+      if(options.landCache->open(options.landCacheDir, inputFilenameSHP, options.landMask ? *options.landMask : buildMask) == 0)
+	std::cout << "Land mask cache " << options.landCache->getFilename() << ": " << options.landCache->getNodeCount()
+		  << " nodes, " << options.landCache->getRebuiltCount() << " tiles rasterised" << std::endl;
+    }
+    masked = (options.landCache->maskGEOTIFF(rasterName, burnValue) == 0);
+  }
+  
+  if(!masked)
+    gdalProcessor->maskGEOTIFF(inputFilenameSHP, burnValue, rasterName);
+  
+  t = ((double)cv::getTickCount() - t)/cv::getTickFrequency();
+  std::cout << "Processing Image (Land Masking) completed in: " << t << " seconds" << std::endl;
+}
+
+/// Ship positions (pixel centres) to WGS84 through the N1 tie point grid, written as an OGR vector product
+void geocodeDetections(const std::string &inputFilename, const std::string &inputFilenameSHP,
+		       std::vector<ShipDetection> &detections,
+		       const std::string &outputName, const PipelineOptions &options)
+{
+  std::cout << "Processing Image (Geocoding detections)" << std::endl;
+  double t = (double) cv::getTickCount();
+  
+  TiePointGeocoder geocoder;
+  if(geocoder.load(inputFilename) != 0)
+  {
+    std::cout << "No usable tie points in " << inputFilename << std::endl;
+    return;
+  }
+  
+  // Pixel centre convention of the GCPs
+  for(unsigned int i = 0; i < detections.size(); i++)
+    geocoder.pixelToLatLong(detections[i].dfPixel + 0.5, detections[i].dfLine + 0.5, detections[i].dfLat, detections[i].dfLong);
+  
+  t = ((double)cv::getTickCount() - t)/cv::getTickFrequency();
+  PipelineMetrics::addTime("geocode", t);
+  std::cout << "Processing Image (Geocoding " << detections.size() << " detections, " << (geocoder.isGrid() ? "bilinear grid" : "thin plate spline") 
+	    << ") completed in: " << t << " seconds" << std::endl;
+  
+  if(options.landMask)
+  {
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(landMutex);
+    std::cout << "Processing Detections (Land Masking)" << std::endl;
+    t = (double) cv::getTickCount();
+    if(options.landMask->getFilename() != inputFilenameSHP)
+      options.landMask->load(inputFilenameSHP);
+    int masked = options.landMask->maskDetections(detections, options.coastBuffer);
+    t = ((double)cv::getTickCount() - t)/cv::getTickFrequency();
+    PipelineMetrics::addTime("landmask", t);
+    std::cout << "Processing Detections (Land Masking, " << masked << " on land) completed in: " << t << " seconds" << std::endl;
+  }
+  
+  DetectionWriter writer;
+  std::string vectorName = outputName + DetectionWriter::getExtension(options.vectorFormat);
+  if(writer.open(vectorName, options.vectorFormat) == 0)
+  {
+    writer.setSceneMetadata(inputFilename);
+    writer.write(detections);
+    writer.close();
+    countBytesWritten(vectorName);
+  }
+  
+  if(options.geocodeReport)
+  {
+    TiePointAccuracy accuracy;
+    if(geocoder.compareWithGCPTransformer(64, accuracy) == 0)
+    {
+      std::cout << "Geocoder vs GDAL GCP transformer over " << accuracy.nSamples << " points: mean " << accuracy.dfMeanError
+		<< " m, RMS " << accuracy.dfRMSError << " m, max " << accuracy.dfMaxError << " m" << std::endl;
+      std::cout << "GDAL GCP transformer residual at the " << geocoder.getGCPCount() << " tie points: mean " 
+		<< accuracy.dfTiePointMean << " m, max " << accuracy.dfTiePointMax << " m" << std::endl;
+      std::cout << "Time per point: geocoder " << accuracy.dfGeocoderTime << " us, GDAL " << accuracy.dfGDALTime << " us" << std::endl;
+    }
+  }
+}
+
+/// Land/sea cells of the scene from the N1 tie points and the coastline, 0 when the grid is usable
+int buildLandGrid(const std::string &inputFilename, const std::string &inputFilenameSHP,
+		  int cellSize, LandMask &landMask, LandTileGrid &landGrid)
+{
+  std::cout << "Processing Image (Land Tile Grid)" << std::endl;
+  double t = (double) cv::getTickCount();
+  
+  TiePointGeocoder geocoder;
+  if(geocoder.load(inputFilename) != 0)
+  {
+    std::cout << "No usable tie points in " << inputFilename << ", land tiles will be processed" << std::endl;
+    return 1;
+  }
+  
+  OpenThreads::ScopedLock<OpenThreads::Mutex> lock(landMutex);
+  if(landMask.getFilename() != inputFilenameSHP && landMask.load(inputFilenameSHP) != 0)
+    return 1;
+  
+  if(landGrid.build(geocoder, landMask, cellSize) != 0)
+    return 1;
+  
+  t = ((double)cv::getTickCount() - t)/cv::getTickFrequency();
+  std::cout << "Processing Image (Land Tile Grid, " << landGrid.getCellCount(LandTileGrid::LAND) << " land, "
+	    << landGrid.getCellCount(LandTileGrid::MIXED) << " coastal, " << landGrid.getCellCount(LandTileGrid::SEA)
+	    << " sea cells) completed in: " << t << " seconds" << std::endl;
+  return 0;
+}
+
+/// Times the warp of one scene for 1, 2, 4... threads up to the CPU count, output goes to /vsimem/
+void benchmarkWarp(const std::string &inputTiff, const std::string &warpFormat)
+{
+  std::string outputName = "/vsimem/benchwarp.tiff";
+  int nCPUs = CPLGetNumCPUs();
+  double baseTime = 0;
+  
+  for(int threads = 1; threads <= std::max(nCPUs, 1); threads *= 2)
+  {
+    GDALProcess *gdalProcessor = new GDALProcess();
+    gdalProcessor->setWarpThreads(threads);
+    
+    double t = (double) cv::getTickCount();
+    gdalProcessor->warpGEOTIFF(inputTiff, warpFormat, outputName);
+    t = ((double)cv::getTickCount() - t)/cv::getTickFrequency();
+    gdalProcessor->removeGEOTIFF(outputName);
+    delete gdalProcessor;
+    
+    if(threads == 1)
+      baseTime = t;
+    std::cout << "Warp threads: " << threads << " time: " << t << " seconds speedup: " << baseTime/t << std::endl;
+  }
+  
+  GDALProcess::cleanup();
 }
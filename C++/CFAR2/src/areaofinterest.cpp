@@ -0,0 +1,180 @@
+/** 
+ *
+ * CFAR2 ship detection pipeline
+ * Lat/long area of interest mapped onto a scene
+ *
+**/
+
+#include "areaofinterest.h"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+AreaOfInterest::AreaOfInterest()
+  : hPolygon(NULL), dfMaxSegment(0.01)
+{
+}
+
+AreaOfInterest::~AreaOfInterest()
+{
+    clear();
+}
+
+void AreaOfInterest::clear()
+{
+    if( hPolygon != NULL )
+        OGR_G_DestroyGeometry( hPolygon );
+    hPolygon = NULL;
+}
+
+/************************************************************************/
+/*                                load()                                */
+/*                                                                      */
+/*      Either four comma separated numbers (a longitude/latitude       */
+/*      bounding box) or the name of a file holding a WKT polygon or    */
+/*      multipolygon in WGS84.                                          */
+/************************************************************************/
+
+int AreaOfInterest::load(std::string aoi)
+{
+    double dfMinLon, dfMinLat, dfMaxLon, dfMaxLat;
+    char chExtra;
+    std::string osWKT;
+
+    clear();
+
+    if( sscanf( aoi.c_str(), "%lf,%lf,%lf,%lf%c",
+                &dfMinLon, &dfMinLat, &dfMaxLon, &dfMaxLat, &chExtra ) == 4 )
+    {
+        if( dfMinLon >= dfMaxLon || dfMinLat >= dfMaxLat )
+        {
+            fprintf( stderr, "Empty AOI bounding box %s.\n", aoi.c_str() );
+            return 1;
+        }
+
+        std::ostringstream oWKT;
+        oWKT.precision( 12 );
+        oWKT << "POLYGON((" << dfMinLon << " " << dfMinLat << "," << dfMaxLon << " " << dfMinLat << ","
+             << dfMaxLon << " " << dfMaxLat << "," << dfMinLon << " " << dfMaxLat << ","
+             << dfMinLon << " " << dfMinLat << "))";
+        osWKT = oWKT.str();
+    }
+    else
+    {
+        std::ifstream oFile( aoi.c_str() );
+        if( !oFile )
+        {
+            fprintf( stderr, "Unable to open AOI %s.\n", aoi.c_str() );
+            return 1;
+        }
+        std::ostringstream oContents;
+        oContents << oFile.rdbuf();
+        osWKT = oContents.str();
+    }
+
+    char *pszWKT = (char *) osWKT.c_str();
+    if( OGR_G_CreateFromWkt( &pszWKT, NULL, &hPolygon ) != OGRERR_NONE || hPolygon == NULL )
+    {
+        fprintf( stderr, "Unable to parse the AOI WKT in %s.\n", aoi.c_str() );
+        clear();
+        return 1;
+    }
+
+    OGRwkbGeometryType eType = wkbFlatten( OGR_G_GetGeometryType( hPolygon ) );
+    if( eType != wkbPolygon && eType != wkbMultiPolygon )
+    {
+        fprintf( stderr, "AOI %s is not a polygon.\n", aoi.c_str() );
+        clear();
+        return 1;
+    }
+
+    /* Straight lat/long edges are curves in pixel/line */
+    OGR_G_Segmentize( hPolygon, dfMaxSegment );
+    return 0;
+}
+
+/* Pixel/line envelope of every vertex of hGeom the geocoder can map */
+void AreaOfInterest::addVertices(OGRGeometryH hGeom, TiePointGeocoder &geocoder,
+                                 double &dfMinX, double &dfMinY, double &dfMaxX, double &dfMaxY)
+{
+    int nParts = OGR_G_GetGeometryCount( hGeom );
+    for( int i = 0; i < nParts; i++ )
+        addVertices( OGR_G_GetGeometryRef( hGeom, i ), geocoder, dfMinX, dfMinY, dfMaxX, dfMaxY );
+
+    int nPoints = OGR_G_GetPointCount( hGeom );
+    for( int i = 0; i < nPoints; i++ )
+    {
+        double dfPixel, dfLine;
+        if( !geocoder.latLongToPixel( OGR_G_GetY( hGeom, i ), OGR_G_GetX( hGeom, i ), dfPixel, dfLine ) )
+            continue;
+
+        dfMinX = std::min( dfMinX, dfPixel );
+        dfMinY = std::min( dfMinY, dfLine );
+        dfMaxX = std::max( dfMaxX, dfPixel );
+        dfMaxY = std::max( dfMaxY, dfLine );
+    }
+}
+
+/************************************************************************/
+/*                           getPixelWindow()                           */
+/*                                                                      */
+/*      The densified AOI vertices through the tie point geocoder,      */
+/*      plus any scene corner inside the AOI (an AOI larger than the    */
+/*      scene has no vertex in it), grown by nHalo pixels so the        */
+/*      detector windows at the edge see their full neighbourhood,      */
+/*      and clipped to the raster. Returns 1 when the AOI misses the    */
+/*      scene.                                                          */
+/************************************************************************/
+
+int AreaOfInterest::getPixelWindow(TiePointGeocoder &geocoder, int nHalo,
+                                   int &nXOff, int &nYOff, int &nXSize, int &nYSize)
+{
+    int nRasterXSize = geocoder.getRasterXSize();
+    int nRasterYSize = geocoder.getRasterYSize();
+    double dfMinX = HUGE_VAL, dfMinY = HUGE_VAL, dfMaxX = -HUGE_VAL, dfMaxY = -HUGE_VAL;
+
+    if( hPolygon == NULL || nRasterXSize <= 0 || nRasterYSize <= 0 )
+        return 1;
+
+    addVertices( hPolygon, geocoder, dfMinX, dfMinY, dfMaxX, dfMaxY );
+
+    double adfCornerPixel[4] = { 0, (double) nRasterXSize, (double) nRasterXSize, 0 };
+    double adfCornerLine[4] = { 0, 0, (double) nRasterYSize, (double) nRasterYSize };
+    OGRGeometryH hPoint = OGR_G_CreateGeometry( wkbPoint );
+    for( int i = 0; i < 4; i++ )
+    {
+        double dfLat, dfLong;
+        if( !geocoder.pixelToLatLong( adfCornerPixel[i], adfCornerLine[i], dfLat, dfLong ) )
+            continue;
+
+        OGR_G_SetPoint_2D( hPoint, 0, dfLong, dfLat );
+        if( OGR_G_Contains( hPolygon, hPoint ) )
+        {
+            dfMinX = std::min( dfMinX, adfCornerPixel[i] );
+            dfMinY = std::min( dfMinY, adfCornerLine[i] );
+            dfMaxX = std::max( dfMaxX, adfCornerPixel[i] );
+            dfMaxY = std::max( dfMaxY, adfCornerLine[i] );
+        }
+    }
+    OGR_G_DestroyGeometry( hPoint );
+
+    if( dfMinX > dfMaxX || dfMinY > dfMaxY )
+        return 1;
+
+    /* Clamp before the int conversion, extrapolated vertices can be far off */
+    int nX0 = (int) std::max( floor( dfMinX ) - nHalo, 0.0 );
+    int nY0 = (int) std::max( floor( dfMinY ) - nHalo, 0.0 );
+    int nX1 = (int) std::min( ceil( dfMaxX ) + nHalo, (double) nRasterXSize );
+    int nY1 = (int) std::min( ceil( dfMaxY ) + nHalo, (double) nRasterYSize );
+    if( nX0 >= nX1 || nY0 >= nY1 )
+        return 1;
+
+    nXOff = nX0;
+    nYOff = nY0;
+    nXSize = nX1 - nX0;
+    nYSize = nY1 - nY0;
+    return 0;
+}
@@ -0,0 +1,42 @@
+/** 
+ *
+ * CFAR2 ship detection pipeline
+ * Lat/long area of interest mapped onto a scene
+ *
+**/
+
+#ifndef AREAOFINTEREST_H
+#define AREAOFINTEREST_H
+
+#include "ogr_api.h"
+#include "cpl_conv.h"
+
+#include "tiepointgeocoder.h"
+
+#include <string>
+
+/// Lat/long region the pipeline is restricted to, a bounding box or a WKT
+/// (multi)polygon, mapped into a scene as a pixel/line window so only the
+/// tiles covering it are read and detected.
+class AreaOfInterest
+{
+
+public:
+AreaOfInterest();
+
+int load(std::string aoi);		// "minLon,minLat,maxLon,maxLat" or a WKT file
+int getPixelWindow(TiePointGeocoder &geocoder, int nHalo,
+		   int &nXOff, int &nYOff, int &nXSize, int &nYSize);
+
+virtual ~AreaOfInterest();
+
+private:
+  void clear();
+  void addVertices(OGRGeometryH hGeom, TiePointGeocoder &geocoder,
+		   double &dfMinX, double &dfMinY, double &dfMaxX, double &dfMaxY);
+
+  OGRGeometryH hPolygon;		// WGS84 longitude/latitude
+  double dfMaxSegment;			// Degrees, edges are densified before mapping
+};
+
+#endif // AREAOFINTEREST_H
@@ -0,0 +1,146 @@
+/** 
+ *
+ * CFAR2 ship detection pipeline
+ * Per-stage thread pools for the scenes of a job file
+ *
+**/
+
+#include "batchexecutor.h"
+
+#include "opencv/cv.h"
+
+#include <OpenThreads/ScopedLock>
+
+#include <algorithm>
+#include <iostream>
+
+/// One stage of one scene on a stage queue
+class BatchStageJob : public ossimJob
+{
+public:
+  BatchStageJob(BatchExecutor *poExecutor, int nScene, int nStage)
+    : executor(poExecutor), scene(nScene), stage(nStage) {}
+
+  virtual void start()
+  {
+    double t = (double) cv::getTickCount();
+    int nResult = executor->getScene(scene)->runStage(stage);
+    t = ((double)cv::getTickCount() - t)/cv::getTickFrequency();
+    executor->stageFinished(scene, stage, nResult, t);
+  }
+
+private:
+  BatchExecutor *executor;
+  int scene;
+  int stage;
+};
+
+BatchExecutor::BatchExecutor()
+  : memoryBudget(0.0), memoryInUse(0.0), finishedCount(0), failedCount(0)
+{
+}
+
+BatchExecutor::~BatchExecutor()
+{
+  for(unsigned int i = 0; i < stages.size(); i++)
+    if(stages[i].pool.valid())
+      stages[i].pool->setNumberOfThreads(0);
+
+  for(unsigned int i = 0; i < scenes.size(); i++)
+    delete scenes[i];
+}
+
+int BatchExecutor::addStage(std::string name, int nThreads)
+{
+  Stage stage;
+  stage.name = name;
+  stage.threads = std::max(nThreads, 1);
+  stage.busySeconds = 0;
+  stage.completed = 0;
+  stages.push_back(stage);
+  return stages.size() - 1;
+}
+
+void BatchExecutor::add(BatchScene *scene)
+{
+  scenes.push_back(scene);
+  memory.push_back(scene->getMemoryEstimate());
+}
+
+void BatchExecutor::submit(int nScene, int nStage)
+{
+  ossimRefPtr<ossimJob> job = new BatchStageJob(this, nScene, nStage);
+  job->setName(scenes[nScene]->getName() + ":" + stages[nStage].name);
+  stages[nStage].queue->add(job.get(), false);
+}
+
+/*! @brief Admits the scenes in order and waits for the pipeline to drain
+ *
+ * A scene larger than the whole budget still runs, on its own.
+ */
+int BatchExecutor::run()
+{
+  if(stages.empty())
+    return 0;
+
+  for(unsigned int s = 0; s < stages.size(); s++)
+  {
+    stages[s].queue = new ossimJobQueue();
+    stages[s].pool = new ossimJobMultiThreadQueue(stages[s].queue.get(), stages[s].threads);
+  }
+
+  double t = (double) cv::getTickCount();
+  for(unsigned int i = 0; i < scenes.size(); i++)
+  {
+    {
+      OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex);
+      while(memoryBudget > 0 && memoryInUse > 0 && memoryInUse + memory[i] > memoryBudget)
+	condition.wait(&mutex);
+      memoryInUse += memory[i];
+    }
+    submit(i, 0);
+  }
+
+  {
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex);
+    while(finishedCount < (int) scenes.size())
+      condition.wait(&mutex);
+  }
+  t = ((double)cv::getTickCount() - t)/cv::getTickFrequency();
+
+  for(unsigned int s = 0; s < stages.size(); s++)
+    stages[s].pool->setNumberOfThreads(0);
+
+  std::cout << "Batch of " << scenes.size() << " scenes (" << failedCount << " failed) completed in: " << t << " seconds" << std::endl;
+  for(unsigned int s = 0; s < stages.size(); s++)
+    std::cout << "  Stage " << stages[s].name << " (" << stages[s].threads << " threads): " << stages[s].completed
+	      << " runs, " << stages[s].busySeconds << " seconds busy" << std::endl;
+
+  return failedCount;
+}
+
+/*! @brief Called on the stage thread: queue the next stage or retire the scene
+ */
+void BatchExecutor::stageFinished(int nScene, int nStage, int nResult, double dfSeconds)
+{
+  bool bNext = (nResult == BatchScene::STAGE_NEXT && nStage + 1 < (int) stages.size());
+
+  OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex);
+  stages[nStage].busySeconds += dfSeconds;
+  stages[nStage].completed++;
+
+  if(bNext)
+  {
+    submit(nScene, nStage + 1);
+    return;
+  }
+
+  if(nResult == BatchScene::STAGE_FAILED)
+  {
+    std::cout << "Scene " << scenes[nScene]->getName() << " failed in stage " << stages[nStage].name << std::endl;
+    failedCount++;
+  }
+  memoryInUse -= memory[nScene];
+  finishedCount++;
+  condition.broadcast();
+}
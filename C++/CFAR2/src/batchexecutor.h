@@ -0,0 +1,86 @@
+/** 
+ *
+ * CFAR2 ship detection pipeline
+ * Per-stage thread pools for the scenes of a job file
+ *
+**/
+
+#ifndef BATCHEXECUTOR_H
+#define BATCHEXECUTOR_H
+
+#include <ossim/base/ossimRefPtr.h>
+#include <ossim/parallel/ossimJob.h>
+#include <ossim/parallel/ossimJobQueue.h>
+#include <ossim/parallel/ossimJobMultiThreadQueue.h>
+
+#include <OpenThreads/Condition>
+#include <OpenThreads/Mutex>
+
+#include <string>
+#include <vector>
+
+/// A scene of the job file as seen by the BatchExecutor: a fixed sequence
+/// of stages, each run on the thread pool of that stage.
+class BatchScene
+{
+
+public:
+enum { STAGE_NEXT = 0, STAGE_DONE = 1, STAGE_FAILED = -1 };
+
+virtual ~BatchScene() {};
+
+virtual std::string getName() = 0;
+virtual double getMemoryEstimate() = 0;		// Bytes held from the first stage to the last
+virtual int runStage(int nStage) = 0;		// STAGE_NEXT, or STAGE_DONE/STAGE_FAILED to end the scene
+};
+
+/// Runs scenes through the stages as a pipeline: every stage has its own
+/// ossimJobQueue and ossimJobMultiThreadQueue, and a scene moves to the
+/// next queue when its stage finishes, so scene N+1 detects while scene N
+/// warps.  Scenes are admitted in job file order while their memory
+/// estimate fits the budget.
+class BatchExecutor
+{
+
+public:
+BatchExecutor();
+
+int addStage(std::string name, int nThreads);
+void add(BatchScene *scene);			// Takes ownership
+int run();					// Blocks until every scene is done, returns the failures
+
+double getMemoryBudget(void){return memoryBudget;};
+void setMemoryBudget(double val){memoryBudget = val;};	// Bytes, 0 = unlimited
+
+void stageFinished(int nScene, int nStage, int nResult, double dfSeconds);
+BatchScene *getScene(int nScene){return scenes[nScene];};
+
+virtual ~BatchExecutor();
+
+private:
+  struct Stage
+  {
+    std::string name;
+    int threads;
+    ossimRefPtr<ossimJobQueue> queue;
+    ossimRefPtr<ossimJobMultiThreadQueue> pool;
+    double busySeconds;
+    int completed;
+  };
+
+  void submit(int nScene, int nStage);
+
+  std::vector<Stage> stages;
+  std::vector<BatchScene*> scenes;
+  std::vector<double> memory;			// Estimate of each scene, fixed at admission
+
+  double memoryBudget;
+  double memoryInUse;
+  int finishedCount;
+  int failedCount;
+
+  OpenThreads::Mutex mutex;
+  OpenThreads::Condition condition;		// A scene finished
+};
+
+#endif // BATCHEXECUTOR_H
@@ -0,0 +1,205 @@
+/** 
+ *
+ * CFAR2 ship detection pipeline
+ * Ship detections as an OGR vector product
+ *
+**/
+
+#include "detectionwriter.h"
+#include "processingsession.h"
+
+DetectionWriter::DetectionWriter()
+  : hDS(NULL), hLayer(NULL), nNextId(0)
+{
+}
+
+DetectionWriter::~DetectionWriter()
+{
+  close();
+}
+
+/************************************************************************/
+/*                            getExtension()                            */
+/************************************************************************/
+
+std::string DetectionWriter::getExtension(std::string format)
+{
+    if( EQUAL(format.c_str(), "GeoJSON") )
+        return ".geojson";
+    if( EQUAL(format.c_str(), "ESRI Shapefile") )
+        return ".shp";
+    return ".csv";
+}
+
+/************************************************************************/
+/*                                open()                                */
+/*                                                                      */
+/*      Field names are kept to 10 characters for the Shapefile DBF.    */
+/************************************************************************/
+
+int DetectionWriter::open(std::string outputFilename, std::string format)
+{
+    OGRSFDriverH hDriver;
+    OGRSpatialReferenceH hSRS;
+    char **papszLayerOptions = NULL;
+    VSIStatBufL sStat;
+
+    close();
+    ProcessingSession::instance()->initializeGDAL();
+
+    hDriver = OGRGetDriverByName( format.c_str() );
+    if( hDriver == NULL )
+    {
+        fprintf( stderr, "OGR driver `%s' not recognised.\n", format.c_str() );
+        return 1;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Replace any previous product for this scene.                    */
+/* -------------------------------------------------------------------- */
+    if( VSIStatL( outputFilename.c_str(), &sStat ) == 0 )
+        OGR_Dr_DeleteDataSource( hDriver, outputFilename.c_str() );
+
+    hDS = OGR_Dr_CreateDataSource( hDriver, outputFilename.c_str(), NULL );
+    if( hDS == NULL )
+    {
+        fprintf( stderr, "Unable to create %s.\n", outputFilename.c_str() );
+        return 1;
+    }
+
+    if( EQUAL(format.c_str(), "CSV") )
+        papszLayerOptions = CSLSetNameValue( papszLayerOptions, "GEOMETRY", "AS_XY" );
+
+    hSRS = OSRNewSpatialReference( NULL );
+    OSRSetWellKnownGeogCS( hSRS, "WGS84" );
+
+    hLayer = OGR_DS_CreateLayer( hDS, "ships", hSRS, wkbPoint, papszLayerOptions );
+
+    OSRDestroySpatialReference( hSRS );
+    CSLDestroy( papszLayerOptions );
+
+    if( hLayer == NULL )
+    {
+        close();
+        return 1;
+    }
+
+    const char *apszIntFields[] = { "id", "area_px", "width_px", "height_px" };
+    const char *apszRealFields[] = { "pixel", "line", "lat", "lon" };
+    const char *apszStringFields[] = { "scene", "product", "sensing" };
+    int i;
+
+    for( i = 0; i < 4; i++ )
+    {
+        OGRFieldDefnH hFld = OGR_Fld_Create( apszIntFields[i], OFTInteger );
+        OGR_L_CreateField( hLayer, hFld, TRUE );
+        OGR_Fld_Destroy( hFld );
+    }
+    for( i = 0; i < 4; i++ )
+    {
+        OGRFieldDefnH hFld = OGR_Fld_Create( apszRealFields[i], OFTReal );
+        OGR_Fld_SetPrecision( hFld, (i < 2) ? 1 : 7 );
+        OGR_L_CreateField( hLayer, hFld, TRUE );
+        OGR_Fld_Destroy( hFld );
+    }
+    for( i = 0; i < 3; i++ )
+    {
+        OGRFieldDefnH hFld = OGR_Fld_Create( apszStringFields[i], OFTString );
+        OGR_Fld_SetWidth( hFld, 64 );
+        OGR_L_CreateField( hLayer, hFld, TRUE );
+        OGR_Fld_Destroy( hFld );
+    }
+
+    nNextId = 0;
+    return 0;
+}
+
+/************************************************************************/
+/*                          setSceneMetadata()                          */
+/*                                                                      */
+/*      Scene name plus the MPH product and sensing start the ENVISAT   */
+/*      driver reports as metadata.                                     */
+/************************************************************************/
+
+void DetectionWriter::setSceneMetadata(std::string inputFilenameN1)
+{
+    GDALDatasetH hDataset;
+    const char *pszValue;
+
+    scene = CPLGetFilename( inputFilenameN1.c_str() );
+    product = "";
+    sensingStart = "";
+
+    ProcessingSession::instance()->initializeGDAL();
+
+    CPLPushErrorHandler( CPLQuietErrorHandler );
+    hDataset = GDALOpen( inputFilenameN1.c_str(), GA_ReadOnly );
+    CPLPopErrorHandler();
+    if( hDataset == NULL )
+        return;
+
+    pszValue = GDALGetMetadataItem( hDataset, "MPH_PRODUCT", NULL );
+    if( pszValue != NULL )
+        product = pszValue;
+    pszValue = GDALGetMetadataItem( hDataset, "MPH_SENSING_START", NULL );
+    if( pszValue != NULL )
+        sensingStart = pszValue;
+
+    GDALClose( hDataset );
+}
+
+/************************************************************************/
+/*                               write()                                */
+/************************************************************************/
+
+int DetectionWriter::write(const std::vector<ShipDetection> &detections)
+{
+    OGRFeatureDefnH hDefn;
+    int nErrors = 0;
+
+    if( hLayer == NULL )
+        return 1;
+
+    hDefn = OGR_L_GetLayerDefn( hLayer );
+
+    for( size_t i = 0; i < detections.size(); i++ )
+    {
+        const ShipDetection &sDetection = detections[i];
+        OGRFeatureH hFeature = OGR_F_Create( hDefn );
+        OGRGeometryH hPoint = OGR_G_CreateGeometry( wkbPoint );
+
+        OGR_F_SetFieldInteger( hFeature, OGR_F_GetFieldIndex( hFeature, "id" ), nNextId++ );
+        OGR_F_SetFieldInteger( hFeature, OGR_F_GetFieldIndex( hFeature, "area_px" ), sDetection.nArea );
+        OGR_F_SetFieldInteger( hFeature, OGR_F_GetFieldIndex( hFeature, "width_px" ), sDetection.nWidth );
+        OGR_F_SetFieldInteger( hFeature, OGR_F_GetFieldIndex( hFeature, "height_px" ), sDetection.nHeight );
+        OGR_F_SetFieldDouble( hFeature, OGR_F_GetFieldIndex( hFeature, "pixel" ), sDetection.dfPixel );
+        OGR_F_SetFieldDouble( hFeature, OGR_F_GetFieldIndex( hFeature, "line" ), sDetection.dfLine );
+        OGR_F_SetFieldDouble( hFeature, OGR_F_GetFieldIndex( hFeature, "lat" ), sDetection.dfLat );
+        OGR_F_SetFieldDouble( hFeature, OGR_F_GetFieldIndex( hFeature, "lon" ), sDetection.dfLong );
+        OGR_F_SetFieldString( hFeature, OGR_F_GetFieldIndex( hFeature, "scene" ), scene.c_str() );
+        OGR_F_SetFieldString( hFeature, OGR_F_GetFieldIndex( hFeature, "product" ), product.c_str() );
+        OGR_F_SetFieldString( hFeature, OGR_F_GetFieldIndex( hFeature, "sensing" ), sensingStart.c_str() );
+
+        OGR_G_SetPoint_2D( hPoint, 0, sDetection.dfLong, sDetection.dfLat );
+        OGR_F_SetGeometryDirectly( hFeature, hPoint );
+
+        if( OGR_L_CreateFeature( hLayer, hFeature ) != OGRERR_NONE )
+            nErrors++;
+
+        OGR_F_Destroy( hFeature );
+    }
+
+    return nErrors;
+}
+
+/************************************************************************/
+/*                               close()                                */
+/************************************************************************/
+
+void DetectionWriter::close()
+{
+    if( hDS != NULL )
+        OGR_DS_Destroy( hDS );
+    hDS = NULL;
+    hLayer = NULL;
+}
@@ -0,0 +1,58 @@
+/** 
+ *
+ * CFAR2 ship detection pipeline
+ * Ship detections as an OGR vector product
+ *
+**/
+
+#ifndef DETECTIONWRITER_H
+#define DETECTIONWRITER_H
+
+#include "gdal.h"
+#include "ogr_api.h"
+#include "ogr_srs_api.h"
+#include "cpl_conv.h"
+#include "cpl_string.h"
+
+#include <string>
+#include <vector>
+
+/// One ship detection from the blob stage
+struct ShipDetection
+{
+  double dfPixel;	// Blob centre (pixel/line of the N1)
+  double dfLine;
+  double dfLat;		// WGS84, filled in by the geocoder
+  double dfLong;
+  int nArea;		// Blob size in pixels (0 if unknown)
+  int nWidth;		// Blob bounding box
+  int nHeight;
+};
+
+/// Writes detections as WGS84 point features through OGR (GeoJSON, ESRI Shapefile or CSV)
+class DetectionWriter
+{
+
+public:
+DetectionWriter();
+
+int open(std::string outputFilename, std::string format);
+void setSceneMetadata(std::string inputFilenameN1);
+int write(const std::vector<ShipDetection> &detections);
+void close();
+
+static std::string getExtension(std::string format);
+
+virtual ~DetectionWriter();
+
+private:
+  OGRDataSourceH hDS;
+  OGRLayerH hLayer;
+  int nNextId;
+
+  std::string scene;		// N1 file name
+  std::string product;		// MPH product name
+  std::string sensingStart;	// MPH sensing start time
+};
+
+#endif // DETECTIONWRITER_H
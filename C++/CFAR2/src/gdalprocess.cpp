@@ -10,6 +10,13 @@
 **/
 
 #include "gdalprocess.h"
+#include "tracerecorder.h"
+
+#include <geos/geom/Envelope.h>
+#include <geos/index/strtree/STRtree.h>
+
+#include <algorithm>
+#include <iomanip>
 
 GDALProcess::~GDALProcess()
 {
@@ -99,6 +106,142 @@ void GDALProcess::InvertGeometries( GDALDatasetH hDstDS,
     ahGeometries[0] = hCollection;
 }
 
+/************************************************************************/
+/*                          LayerEnvelopeIndex                          */
+/*                                                                      */
+/*      Feature envelopes of the last layer rasterised, kept between    */
+/*      scenes so a continental coastline is only scanned once.         */
+/************************************************************************/
+
+struct LayerEnvelopeIndex
+{
+    std::string osKey;
+    std::vector<long> anFIDs;
+    std::vector<geos::geom::Envelope> aoEnvelopes;
+    geos::index::strtree::STRtree *poTree;
+};
+
+static LayerEnvelopeIndex *psLayerIndex = NULL;
+
+static void DestroyLayerIndex()
+{
+    if( psLayerIndex != NULL )
+    {
+        delete psLayerIndex->poTree;
+        delete psLayerIndex;
+        psLayerIndex = NULL;
+    }
+}
+
+/* Name, feature count and extent from the layer header, no feature is read */
+static std::string LayerIndexKey( OGRLayerH hLayer )
+{
+    OGREnvelope sExtent;
+    std::ostringstream oKey;
+
+    OGR_L_GetExtent( hLayer, &sExtent, FALSE );
+    oKey << OGR_L_GetName( hLayer ) << ":" << OGR_L_GetFeatureCount( hLayer, FALSE )
+         << std::setprecision( 17 ) << ":" << sExtent.MinX << ":" << sExtent.MinY
+         << ":" << sExtent.MaxX << ":" << sExtent.MaxY;
+    return oKey.str();
+}
+
+/************************************************************************/
+/*                           GetDstEnvelope()                           */
+/*                                                                      */
+/*      Extent and pixel size of the destination raster in its own      */
+/*      georeferenced coordinates.                                      */
+/************************************************************************/
+
+static int GetDstEnvelope( GDALDatasetH hDstDS, OGREnvelope &sEnvelope, double &dfPixelSize )
+{
+    double adfGeoTransform[6];
+
+    if( GDALGetGeoTransform( hDstDS, adfGeoTransform ) != CE_None )
+        return FALSE;
+
+    int nXSize = GDALGetRasterXSize( hDstDS );
+    int nYSize = GDALGetRasterYSize( hDstDS );
+
+    for( int iCorner = 0; iCorner < 4; iCorner++ )
+    {
+        double dfPixel = (iCorner & 1) ? nXSize : 0;
+        double dfLine = (iCorner & 2) ? nYSize : 0;
+        double dfX = adfGeoTransform[0] + dfPixel*adfGeoTransform[1] + dfLine*adfGeoTransform[2];
+        double dfY = adfGeoTransform[3] + dfPixel*adfGeoTransform[4] + dfLine*adfGeoTransform[5];
+
+        if( iCorner == 0 )
+        {
+            sEnvelope.MinX = sEnvelope.MaxX = dfX;
+            sEnvelope.MinY = sEnvelope.MaxY = dfY;
+        }
+        sEnvelope.MinX = MIN( sEnvelope.MinX, dfX );
+        sEnvelope.MaxX = MAX( sEnvelope.MaxX, dfX );
+        sEnvelope.MinY = MIN( sEnvelope.MinY, dfY );
+        sEnvelope.MaxY = MAX( sEnvelope.MaxY, dfY );
+    }
+
+    dfPixelSize = MIN( sqrt( adfGeoTransform[1]*adfGeoTransform[1] + adfGeoTransform[4]*adfGeoTransform[4] ),
+                       sqrt( adfGeoTransform[2]*adfGeoTransform[2] + adfGeoTransform[5]*adfGeoTransform[5] ) );
+    return TRUE;
+}
+
+/************************************************************************/
+/*                            NextFeature()                             */
+/************************************************************************/
+
+static OGRFeatureH NextFeature( OGRLayerH hLayer, int bByFID,
+                                const std::vector<long> &anFIDs, size_t &iNextFID )
+{
+    if( !bByFID )
+        return OGR_L_GetNextFeature( hLayer );
+
+    while( iNextFID < anFIDs.size() )
+    {
+        OGRFeatureH hFeat = OGR_L_GetFeature( hLayer, anFIDs[iNextFID++] );
+        if( hFeat != NULL )
+            return hFeat;
+    }
+    return NULL;
+}
+
+/************************************************************************/
+/*                          PrepareGeometry()                           */
+/*                                                                      */
+/*      Clips a geometry to the (slightly grown) destination extent     */
+/*      and simplifies it to half a pixel, so only the coastline of     */
+/*      the scene reaches GDALRasterizeGeometries().                    */
+/************************************************************************/
+
+static OGRGeometryH PrepareGeometry( OGRGeometryH hGeom, OGRGeometryH hClip,
+                                     const OGREnvelope &sClip, double dfTolerance )
+{
+    OGREnvelope sEnvelope;
+    OGRGeometryH hResult = NULL;
+
+    OGR_G_GetEnvelope( hGeom, &sEnvelope );
+
+    CPLPushErrorHandler( CPLQuietErrorHandler );
+    if( sEnvelope.MinX < sClip.MinX || sEnvelope.MaxX > sClip.MaxX
+        || sEnvelope.MinY < sClip.MinY || sEnvelope.MaxY > sClip.MaxY )
+        hResult = OGR_G_Intersection( hGeom, hClip );
+    if( hResult == NULL )
+        hResult = OGR_G_Clone( hGeom );
+
+    if( dfTolerance > 0.0 )
+    {
+        OGRGeometryH hSimple = OGR_G_SimplifyPreserveTopology( hResult, dfTolerance );
+        if( hSimple != NULL )
+        {
+            OGR_G_DestroyGeometry( hResult );
+            hResult = hSimple;
+        }
+    }
+    CPLPopErrorHandler();
+
+    return hResult;
+}
+
 /************************************************************************/
 /*                            ProcessLayer()                            */
 /*                                                                      */
@@ -114,6 +257,13 @@ void GDALProcess::ProcessLayer(
     GDALProgressFunc pfnProgress, void* pProgressData )
 
 {
+/* -------------------------------------------------------------------- */
+/*      Scenes may be masked from several threads, the shared layer     */
+/*      index and the shapefile reader are not thread safe.             */
+/* -------------------------------------------------------------------- */
+    static void *hLayerMutex = NULL;
+    CPLMutexHolderD( &hLayerMutex );
+
 /* -------------------------------------------------------------------- */
 /*      Checkout that SRS are the same.                                 */
 /*      If -a_srs is specified, skip the test                           */
@@ -182,6 +332,68 @@ void GDALProcess::ProcessLayer(
         }
     }
 
+/* -------------------------------------------------------------------- */
+/*      Restrict the features to the destination extent: by FID from    */
+/*      the envelope index when the layer was seen before (the index    */
+/*      is built during the first scan), otherwise with a spatial       */
+/*      filter.  Inverse mode needs every feature.                      */
+/* -------------------------------------------------------------------- */
+    OGREnvelope sDstEnvelope, sClipEnvelope;
+    double dfPixelSize = 0.0;
+    int bFilter = !bInverse && GetDstEnvelope( hDstDS, sDstEnvelope, dfPixelSize );
+    int bByFID = FALSE, bBuildIndex = FALSE;
+    std::vector<long> anFIDs;
+    size_t iNextFID = 0;
+    OGRGeometryH hClip = NULL;
+
+    if( bFilter )
+    {
+        OGR_L_SetSpatialFilter( hSrcLayer, NULL );
+
+        if( OGR_L_TestCapability( hSrcLayer, OLCRandomRead ) )
+        {
+            std::string osKey = LayerIndexKey( hSrcLayer );
+            if( psLayerIndex != NULL && psLayerIndex->osKey == osKey )
+            {
+                geos::geom::Envelope oSearch( sDstEnvelope.MinX, sDstEnvelope.MaxX,
+                                              sDstEnvelope.MinY, sDstEnvelope.MaxY );
+                std::vector<void*> apHits;
+                psLayerIndex->poTree->query( &oSearch, apHits );
+                for( size_t i = 0; i < apHits.size(); i++ )
+                    anFIDs.push_back( psLayerIndex->anFIDs[(size_t) apHits[i]] );
+                std::sort( anFIDs.begin(), anFIDs.end() );
+                bByFID = TRUE;
+            }
+            else
+            {
+                DestroyLayerIndex();
+                psLayerIndex = new LayerEnvelopeIndex();
+                psLayerIndex->osKey = osKey;
+                psLayerIndex->poTree = NULL;
+                bBuildIndex = TRUE;
+            }
+        }
+
+        if( !bByFID && !bBuildIndex )
+            OGR_L_SetSpatialFilterRect( hSrcLayer, sDstEnvelope.MinX, sDstEnvelope.MinY,
+                                        sDstEnvelope.MaxX, sDstEnvelope.MaxY );
+
+        /* Two pixels of margin so the clip edge never burns */
+        sClipEnvelope.MinX = sDstEnvelope.MinX - 2*dfPixelSize;
+        sClipEnvelope.MaxX = sDstEnvelope.MaxX + 2*dfPixelSize;
+        sClipEnvelope.MinY = sDstEnvelope.MinY - 2*dfPixelSize;
+        sClipEnvelope.MaxY = sDstEnvelope.MaxY + 2*dfPixelSize;
+
+        OGRGeometryH hClipRing = OGR_G_CreateGeometry( wkbLinearRing );
+        OGR_G_AddPoint_2D( hClipRing, sClipEnvelope.MinX, sClipEnvelope.MinY );
+        OGR_G_AddPoint_2D( hClipRing, sClipEnvelope.MaxX, sClipEnvelope.MinY );
+        OGR_G_AddPoint_2D( hClipRing, sClipEnvelope.MaxX, sClipEnvelope.MaxY );
+        OGR_G_AddPoint_2D( hClipRing, sClipEnvelope.MinX, sClipEnvelope.MaxY );
+        OGR_G_AddPoint_2D( hClipRing, sClipEnvelope.MinX, sClipEnvelope.MinY );
+        hClip = OGR_G_CreateGeometry( wkbPolygon );
+        OGR_G_AddGeometryDirectly( hClip, hClipRing );
+    }
+
 /* -------------------------------------------------------------------- */
 /*      Collect the geometries from this layer, and build list of       */
 /*      burn values.                                                    */
@@ -192,7 +404,7 @@ void GDALProcess::ProcessLayer(
 
     OGR_L_ResetReading( hSrcLayer );
     
-    while( (hFeat = OGR_L_GetNextFeature( hSrcLayer )) != NULL )
+    while( (hFeat = NextFeature( hSrcLayer, bByFID, anFIDs, iNextFID )) != NULL )
     {
         OGRGeometryH hGeom;
 
@@ -202,7 +414,37 @@ void GDALProcess::ProcessLayer(
             continue;
         }
 
-        hGeom = OGR_G_Clone( OGR_F_GetGeometryRef( hFeat ) );
+        if( bFilter )
+        {
+            OGREnvelope sEnvelope;
+            OGR_G_GetEnvelope( OGR_F_GetGeometryRef( hFeat ), &sEnvelope );
+
+            if( bBuildIndex )
+            {
+                psLayerIndex->anFIDs.push_back( OGR_F_GetFID( hFeat ) );
+                psLayerIndex->aoEnvelopes.push_back( 
+                    geos::geom::Envelope( sEnvelope.MinX, sEnvelope.MaxX,
+                                          sEnvelope.MinY, sEnvelope.MaxY ) );
+            }
+
+            if( !sEnvelope.Intersects( sDstEnvelope ) )
+            {
+                OGR_F_Destroy( hFeat );
+                continue;
+            }
+
+            /* Z values are burnt in 3D mode, keep every vertex */
+            hGeom = PrepareGeometry( OGR_F_GetGeometryRef( hFeat ), hClip, sClipEnvelope,
+                                     b3D ? 0.0 : 0.5*dfPixelSize );
+            if( OGR_G_IsEmpty( hGeom ) )
+            {
+                OGR_G_DestroyGeometry( hGeom );
+                OGR_F_Destroy( hFeat );
+                continue;
+            }
+        }
+        else
+            hGeom = OGR_G_Clone( OGR_F_GetGeometryRef( hFeat ) );
         ahGeometries.push_back( hGeom );
 
         for( unsigned int iBand = 0; iBand < anBandList.size(); iBand++ )
@@ -231,6 +473,18 @@ void GDALProcess::ProcessLayer(
         OGR_F_Destroy( hFeat );
     }
 
+    if( bBuildIndex )
+    {
+        psLayerIndex->poTree = new geos::index::strtree::STRtree();
+        for( size_t i = 0; i < psLayerIndex->aoEnvelopes.size(); i++ )
+            psLayerIndex->poTree->insert( &psLayerIndex->aoEnvelopes[i], (void *) i );
+    }
+    if( bFilter )
+    {
+        OGR_L_SetSpatialFilter( hSrcLayer, NULL );
+        OGR_G_DestroyGeometry( hClip );
+    }
+
 /* -------------------------------------------------------------------- */
 /*      If we are in inverse mode, we add one extra ring around the     */
 /*      whole dataset to invert the concept of insideness and then      */
@@ -254,13 +508,14 @@ void GDALProcess::ProcessLayer(
     }
 
 /* -------------------------------------------------------------------- */
-/*      Perform the burn.                                               */
+/*      Perform the burn (nothing to do for an open sea scene).         */
 /* -------------------------------------------------------------------- */
-    GDALRasterizeGeometries( hDstDS, anBandList.size(), &(anBandList[0]), 
-                             ahGeometries.size(), &(ahGeometries[0]), 
-                             NULL, NULL, &(adfFullBurnValues[0]), 
-                             papszRasterizeOptions,
-                             pfnProgress, pProgressData );
+    if( !ahGeometries.empty() )
+        GDALRasterizeGeometries( hDstDS, anBandList.size(), &(anBandList[0]), 
+                                 ahGeometries.size(), &(ahGeometries[0]), 
+                                 NULL, NULL, &(adfFullBurnValues[0]), 
+                                 papszRasterizeOptions,
+                                 pfnProgress, pProgressData );
 
 /* -------------------------------------------------------------------- */
 /*      Cleanup geometries.                                             */
@@ -438,8 +693,7 @@ int GDALProcess::maskGEOTIFF( std::string inputFilename, int burnValue, std::str
     OGREnvelope sEnvelop;
     OGRSpatialReferenceH hSRS = NULL;
     
-    GDALAllRegister();
-    OGRRegisterAll();
+    ProcessingSession::instance()->initializeGDAL();
     
     adfBurnValues.push_back(burnValue);
     pszSrcFilename = inputFilename.c_str();
@@ -494,9 +748,6 @@ int GDALProcess::maskGEOTIFF( std::string inputFilename, int burnValue, std::str
     CSLDestroy( papszRasterizeOptions );
     CSLDestroy( papszLayers );
     CSLDestroy( papszCreateOptions );
-    
-    GDALDestroyDriverManager();
-    OGRCleanupAll();
 
     return 0;
 }
@@ -509,7 +760,7 @@ void GDALProcess::getLATLONG(std::string inputFilename,
 {
     GDALDataset  *poDataset;
 
-    GDALAllRegister();
+    ProcessingSession::instance()->initializeGDAL();
 
     poDataset = (GDALDataset *) GDALOpen(inputFilename.c_str(), GA_ReadOnly );
 
@@ -590,7 +841,7 @@ int GDALProcess::writeGEOTIFF(std::string inputFilenameN1,
 
     dfULX = dfULY = dfLRX = dfLRY = 0.0;
     
-GDALAllRegister();
+    ProcessingSession::instance()->initializeGDAL();
 
     pszFormat = "GTiff";
     pszSource = inputTiff.c_str();
@@ -883,8 +1134,8 @@ GDALAllRegister();
 
         for( i = 0; i < nGCPs; i++ )
         {
-            pasGCPs[i].dfGCPPixel -= anSrcWin[0];
-            pasGCPs[i].dfGCPLine  -= anSrcWin[1];
+            pasGCPs[i].dfGCPPixel -= anSrcWin[0] + nSrcXOff;
+            pasGCPs[i].dfGCPLine  -= anSrcWin[1] + nSrcYOff;
             pasGCPs[i].dfGCPPixel *= (nOXSize / (double) anSrcWin[2] );
             pasGCPs[i].dfGCPLine  *= (nOYSize / (double) anSrcWin[3] );
         }
@@ -1284,6 +1535,234 @@ GDALAllRegister();
 }
 
 
+/************************************************************************/
+/*                        DuplicateOffsetGCPs()                         */
+/*                                                                      */
+/*      Copy of the N1 GCPs moved into the detector image, which        */
+/*      starts at (nSrcXOff, nSrcYOff) of the N1 when only an AOI was   */
+/*      detected. The caller frees it with GDALDeinitGCPs/CPLFree.      */
+/************************************************************************/
+
+GDAL_GCP *GDALProcess::DuplicateOffsetGCPs( GDALDatasetH hN1DS )
+{
+    int       nGCPs = GDALGetGCPCount( hN1DS );
+    GDAL_GCP *pasGCPs = GDALDuplicateGCPs( nGCPs, GDALGetGCPs( hN1DS ) );
+
+    for( int i = 0; i < nGCPs; i++ )
+    {
+        pasGCPs[i].dfGCPPixel -= nSrcXOff;
+        pasGCPs[i].dfGCPLine  -= nSrcYOff;
+    }
+
+    return pasGCPs;
+}
+
+/************************************************************************/
+/*                             attachGCPs()                             */
+/*                                                                      */
+/*      Fast path for writeGEOTIFF(): the N1 GCPs and GCP projection    */
+/*      are written into the detector GeoTIFF tags in place, so the     */
+/*      warp can read it directly without a TEMP.tiff copy.             */
+/************************************************************************/
+
+int GDALProcess::attachGCPs(std::string inputFilenameN1, std::string inputTiff)
+{
+    GDALDatasetH	hN1DS, hDataset;
+    CPLErr		eErr = CE_None;
+    double		adfDefaultGeoTransform[6] = { 0.0, 1.0, 0.0, 0.0, 0.0, 1.0 };
+
+    ProcessingSession::instance()->initializeGDAL();
+
+    hN1DS = GDALOpen( inputFilenameN1.c_str(), GA_ReadOnly );
+    if( hN1DS == NULL )
+    {
+        fprintf( stderr,
+                 "GDALOpen failed - %d\n%s\n",
+                 CPLGetLastErrorNo(), CPLGetLastErrorMsg() );
+        return 1;
+    }
+    nGCPCount = GDALGetGCPCount( hN1DS );
+
+    hDataset = GDALOpen( inputTiff.c_str(), GA_Update );
+    if( hDataset == NULL )
+    {
+        fprintf( stderr,
+                 "GDALOpen failed - %d\n%s\n",
+                 CPLGetLastErrorNo(), CPLGetLastErrorMsg() );
+        GDALClose( hN1DS );
+        return 1;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      GTiff writes a geotransform in preference to tiepoints, so      */
+/*      reset any geotransform the detector writer left, as             */
+/*      gdal_translate does when GCPs are assigned.                     */
+/* -------------------------------------------------------------------- */
+    if( nGCPCount > 0 )
+    {
+        GDAL_GCP *pasGCPs = DuplicateOffsetGCPs( hN1DS );
+
+        GDALSetGeoTransform( hDataset, adfDefaultGeoTransform );
+        eErr = GDALSetGCPs( hDataset, nGCPCount, pasGCPs,
+                            GDALGetGCPProjection( hN1DS ) );
+
+        GDALDeinitGCPs( nGCPCount, pasGCPs );
+        CPLFree( pasGCPs );
+    }
+
+    GDALClose( hN1DS );
+
+    CPLErrorReset();
+    GDALFlushCache( hDataset );
+    if( CPLGetLastErrorType() != CE_None )
+        eErr = CE_Failure;
+    GDALClose( hDataset );
+
+    return (eErr != CE_None) ? 1 : 0;
+}
+
+/************************************************************************/
+/*                            writeGEOTIFF()                            */
+/*                                                                      */
+/*      Writes a detector image held in memory straight into a GCP      */
+/*      georeferenced GeoTIFF (usually under /vsimem/), instead of      */
+/*      reading the detector TIFF back from disk and translating it.    */
+/************************************************************************/
+
+int GDALProcess::writeGEOTIFF(std::string inputFilenameN1, 
+				 const unsigned char *pabyImage,
+				 int nXSize, int nYSize, int nLineSpace,
+				 std::string outputGeotiff)
+{
+    GDALDatasetH	hN1DS, hOutDS;
+    GDALDriverH		hDriver;
+    CPLErr		eErr;
+
+    ProcessingSession::instance()->initializeGDAL();
+
+    hDriver = GDALGetDriverByName( "GTiff" );
+    if( hDriver == NULL )
+    {
+        fprintf( stderr, "Output driver `GTiff' not recognised.\n" );
+        return 1;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      The N1 is only opened for its GCPs.                             */
+/* -------------------------------------------------------------------- */
+    hN1DS = GDALOpen( inputFilenameN1.c_str(), GA_ReadOnly );
+    if( hN1DS == NULL )
+    {
+        fprintf( stderr,
+                 "GDALOpen failed - %d\n%s\n",
+                 CPLGetLastErrorNo(), CPLGetLastErrorMsg() );
+        return 1;
+    }
+    nGCPCount = GDALGetGCPCount( hN1DS );
+
+    hOutDS = GDALCreate( hDriver, outputGeotiff.c_str(), nXSize, nYSize, 1,
+                         GDT_Byte, NULL );
+    if( hOutDS == NULL )
+    {
+        GDALClose( hN1DS );
+        return 1;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Pixels and GCPs go in with the dataset creation, the detector   */
+/*      image is the N1 (or the AOI window of it, see setSourceOffset)  */
+/*      so the GCPs apply as is or shifted.                             */
+/* -------------------------------------------------------------------- */
+    eErr = GDALRasterIO( GDALGetRasterBand( hOutDS, 1 ), GF_Write,
+                         0, 0, nXSize, nYSize,
+                         (void *) pabyImage, nXSize, nYSize, GDT_Byte,
+                         1, nLineSpace );
+
+    if( eErr == CE_None && nGCPCount > 0 )
+    {
+        GDAL_GCP *pasGCPs = DuplicateOffsetGCPs( hN1DS );
+
+        eErr = GDALSetGCPs( hOutDS, nGCPCount, pasGCPs,
+                            GDALGetGCPProjection( hN1DS ) );
+
+        GDALDeinitGCPs( nGCPCount, pasGCPs );
+        CPLFree( pasGCPs );
+    }
+
+    GDALClose( hN1DS );
+
+    CPLErrorReset();
+    GDALFlushCache( hOutDS );
+    if( CPLGetLastErrorType() != CE_None )
+        eErr = CE_Failure;
+    GDALClose( hOutDS );
+
+    return (eErr != CE_None) ? 1 : 0;
+}
+
+/************************************************************************/
+/*                            copyGEOTIFF()                             */
+/*                                                                      */
+/*      Copies a (/vsimem/) dataset to its final GeoTIFF location.      */
+/************************************************************************/
+
+int GDALProcess::copyGEOTIFF(std::string inputFilename, std::string outputFilename)
+{
+    GDALDatasetH	hSrcDS, hOutDS;
+    GDALDriverH		hDriver;
+    int			bHasGotErr = FALSE;
+
+    ProcessingSession::instance()->initializeGDAL();
+
+    hDriver = GDALGetDriverByName( "GTiff" );
+    hSrcDS = GDALOpen( inputFilename.c_str(), GA_ReadOnly );
+    if( hDriver == NULL || hSrcDS == NULL )
+    {
+        fprintf( stderr,
+                 "GDALOpen failed - %d\n%s\n",
+                 CPLGetLastErrorNo(), CPLGetLastErrorMsg() );
+        return 1;
+    }
+
+    hOutDS = GDALCreateCopy( hDriver, outputFilename.c_str(), hSrcDS,
+                             FALSE, NULL, NULL, NULL );
+    if( hOutDS != NULL )
+    {
+        CPLErrorReset();
+        GDALFlushCache( hOutDS );
+        if( CPLGetLastErrorType() != CE_None )
+            bHasGotErr = TRUE;
+        GDALClose( hOutDS );
+    }
+    else
+        bHasGotErr = TRUE;
+
+    GDALClose( hSrcDS );
+
+    return bHasGotErr;
+}
+
+/************************************************************************/
+/*                           removeGEOTIFF()                            */
+/************************************************************************/
+
+int GDALProcess::removeGEOTIFF(std::string inputFilename)
+{
+    return VSIUnlink( inputFilename.c_str() );
+}
+
+/************************************************************************/
+/*                              cleanup()                               */
+/*                                                                      */
+/*      Releases what is kept between scenes.  The driver managers      */
+/*      belong to the ProcessingSession.                                */
+/************************************************************************/
+
+void GDALProcess::cleanup()
+{
+    DestroyLayerIndex();
+}
+
 /************************************************************************/
 /*                              SrcToDst()                              */
 /************************************************************************/
@@ -1563,8 +2042,8 @@ int GDALProcess::warpGEOTIFF(std::string inputFilename, std::string warpFormat,
     int                 i;
     void               *hTransformArg, *hGenImgProjArg=NULL, *hApproxArg=NULL;
     char               **papszWarpOptions = NULL;
-    double             dfErrorThreshold = 0.125;
-    double             dfWarpMemoryLimit = 0.0;
+    double             dfErrorThreshold = warpErrorThreshold;
+    double             dfWarpMemoryLimit = warpMemoryLimit;
     GDALTransformerFunc pfnTransformer = NULL;
     char                **papszCreateOptions = NULL;
     GDALDataType        eOutputType = GDT_Unknown, eWorkingType = GDT_Unknown; 
@@ -1573,7 +2052,7 @@ int GDALProcess::warpGEOTIFF(std::string inputFilename, std::string warpFormat,
     char                **papszTO = NULL;
     int                  bHasGotErr = FALSE;
 
-    GDALAllRegister();
+    ProcessingSession::instance()->initializeGDAL();
     papszTO = CSLSetNameValue( papszTO, "DST_SRS", pszSRS );
     CPLFree( pszSRS );
     strcpy(pszSrcFilename, inputFilename.c_str());
@@ -1681,6 +2160,23 @@ int GDALProcess::warpGEOTIFF(std::string inputFilename, std::string warpFormat,
             }
 
 /* -------------------------------------------------------------------- */
+/*      The parallel warp builds its own per-thread transformers.       */
+/* -------------------------------------------------------------------- */
+        if( warpThreads != 1 )
+        {
+            if( hUniqueTransformArg )
+                GDALDestroyGenImgProjTransformer( hUniqueTransformArg );
+
+            if( warpChunksMulti( pszSrcFilename, hDstDS, papszTO,
+                                 papszWarpOptions, eResampleAlg,
+                                 eWorkingType ) != CE_None )
+                bHasGotErr = TRUE;
+
+            GDALClose( hSrcDS );
+        }
+        else
+        {
+/* -------------------------------------------------------------------- */
 /*      Create a transformation object from the source to               */
 /*      destination coordinate system.                                  */
 /* -------------------------------------------------------------------- */
@@ -1756,6 +2252,7 @@ int GDALProcess::warpGEOTIFF(std::string inputFilename, std::string warpFormat,
         if( oWO.Initialize( psWO ) == CE_None )
         {
             CPLErr eErr;
+            TraceSpan oSpan( "warp", "warp" );
             if( bMulti )
                 eErr = oWO.ChunkAndWarpMulti( 0, 0, 
                                        GDALGetRasterXSize( hDstDS ),
@@ -1780,6 +2277,7 @@ int GDALProcess::warpGEOTIFF(std::string inputFilename, std::string warpFormat,
         GDALDestroyWarpOptions( psWO );
 
         GDALClose( hSrcDS );
+        }
 
 /* -------------------------------------------------------------------- */
 /*      Final Cleanup.                                                  */
@@ -1794,12 +2292,348 @@ int GDALProcess::warpGEOTIFF(std::string inputFilename, std::string warpFormat,
     CPLFree( pszSrcFilename );
     CSLDestroy( papszWarpOptions );
     CSLDestroy( papszTO );
-
-    GDALDestroyDriverManager();
              
     return (bHasGotErr) ? 1 : 0;
 }
 
+/************************************************************************/
+/*                          warpChunksMulti()                           */
+/*                                                                      */
+/*      The destination is cut into square chunks which a pool of       */
+/*      threads pulls from a shared counter.  Each thread owns a        */
+/*      source dataset, a GCP/GenImgProj transformer (they are not      */
+/*      safe to share) and a warp operation, warps a chunk into its     */
+/*      own buffer and takes the mutex only to write it to the          */
+/*      destination.                                                    */
+/************************************************************************/
+
+typedef struct
+{
+    GDALDatasetH        hSrcDS;
+    GDALDatasetH        hDstDS;
+    void               *hGenImgProjArg;
+    void               *hApproxArg;
+    GDALWarpOptions    *psWO;
+    GDALWarpOperation  *poOperation;
+
+    int                *panChunks;      /* xoff, yoff, xsize, ysize per chunk */
+    int                 nChunkCount;
+    int                *pnNextChunk;    /* shared, guarded by hMutex */
+    void               *hMutex;
+    GDALDataType        eBufType;
+    int                 bInitDest;
+
+    CPLErr              eErr;
+} WarpThreadJob;
+
+static void WarpChunkThread( void *pArg )
+{
+    WarpThreadJob *psJob = (WarpThreadJob *) pArg;
+    GDALWarpOptions *psWO = psJob->psWO;
+    int nBufSize = 0;
+    GByte *pabyBuf = NULL;
+    int nTypeSize = GDALGetDataTypeSize( psJob->eBufType ) / 8;
+
+    TraceRecorder::instance()->setThreadName( "warp" );
+
+/* -------------------------------------------------------------------- */
+/*      WarpRegionToBuffer() leaves the buffer as it is, so INIT_DEST   */
+/*      is applied here per band, as GDALWarpOperation::WarpRegion()    */
+/*      does: a value per band (the last one repeats) or NO_DATA.       */
+/* -------------------------------------------------------------------- */
+    const char *pszInitDest = CSLFetchNameValue( psWO->papszWarpOptions, "INIT_DEST" );
+    char **papszInitValues = NULL;
+    int nInitCount = 0;
+    if( pszInitDest != NULL && !EQUAL(pszInitDest, "") )
+    {
+        papszInitValues = CSLTokenizeStringComplex( pszInitDest, ",", FALSE, FALSE );
+        nInitCount = CSLCount( papszInitValues );
+    }
+
+    while( psJob->eErr == CE_None )
+    {
+        int iChunk;
+
+        CPLAcquireMutex( psJob->hMutex, 1000.0 );
+        iChunk = (*psJob->pnNextChunk)++;
+        CPLReleaseMutex( psJob->hMutex );
+
+        if( iChunk >= psJob->nChunkCount )
+            break;
+
+        int nXOff  = psJob->panChunks[iChunk*4+0];
+        int nYOff  = psJob->panChunks[iChunk*4+1];
+        int nXSize = psJob->panChunks[iChunk*4+2];
+        int nYSize = psJob->panChunks[iChunk*4+3];
+        int nNeeded = nXSize * nYSize * nTypeSize * psWO->nBandCount;
+
+        if( nNeeded > nBufSize )
+        {
+            CPLFree( pabyBuf );
+            pabyBuf = (GByte *) VSIMalloc( nNeeded );
+            nBufSize = nNeeded;
+            if( pabyBuf == NULL )
+            {
+                psJob->eErr = CE_Failure;
+                break;
+            }
+        }
+
+/* -------------------------------------------------------------------- */
+/*      Without INIT_DEST the warp composites over what is already in   */
+/*      the destination, as GDALWarpOperation::WarpRegion() does.       */
+/* -------------------------------------------------------------------- */
+        if( nInitCount > 0 )
+        {
+            int nBandSize = nXSize * nYSize * nTypeSize;
+            for( int iBand = 0; iBand < psWO->nBandCount; iBand++ )
+            {
+                double adfInitRealImag[2] = { 0.0, 0.0 };
+                const char *pszBandInit = papszInitValues[MIN(iBand, nInitCount-1)];
+                GByte *pBandData = pabyBuf + iBand * nBandSize;
+
+                if( EQUAL(pszBandInit, "NO_DATA") )
+                {
+                    if( psWO->padfDstNoDataReal != NULL )
+                        adfInitRealImag[0] = psWO->padfDstNoDataReal[iBand];
+                    if( psWO->padfDstNoDataImag != NULL )
+                        adfInitRealImag[1] = psWO->padfDstNoDataImag[iBand];
+                }
+                else
+                    CPLStringToComplex( pszBandInit, adfInitRealImag + 0, adfInitRealImag + 1 );
+
+                if( psJob->eBufType == GDT_Byte )
+                    memset( pBandData, MAX(0, MIN(255, (int) adfInitRealImag[0])), nBandSize );
+                else if( adfInitRealImag[0] == 0.0 && adfInitRealImag[1] == 0.0 )
+                    memset( pBandData, 0, nBandSize );
+                else
+                    GDALCopyWords( adfInitRealImag, GDT_CFloat64, 0,
+                                   pBandData, psJob->eBufType, nTypeSize,
+                                   nXSize * nYSize );
+            }
+        }
+        else if( !psJob->bInitDest )
+        {
+            CPLAcquireMutex( psJob->hMutex, 1000.0 );
+            psJob->eErr = GDALDatasetRasterIO( psJob->hDstDS, GF_Read,
+                                               nXOff, nYOff, nXSize, nYSize,
+                                               pabyBuf, nXSize, nYSize,
+                                               psJob->eBufType,
+                                               psWO->nBandCount,
+                                               psWO->panDstBands, 0, 0, 0 );
+            CPLReleaseMutex( psJob->hMutex );
+            if( psJob->eErr != CE_None )
+                break;
+        }
+
+        {
+            TraceSpan oSpan( "warp chunk", "warp", nXOff, nYOff );
+            psJob->eErr = psJob->poOperation->WarpRegionToBuffer(
+                nXOff, nYOff, nXSize, nYSize, pabyBuf, psJob->eBufType );
+        }
+        if( psJob->eErr != CE_None )
+            break;
+
+        /* The span includes waiting for the other threads' writes */
+        TraceSpan oWriteSpan( "warp write", "writer", nXOff, nYOff );
+        CPLAcquireMutex( psJob->hMutex, 1000.0 );
+        psJob->eErr = GDALDatasetRasterIO( psJob->hDstDS, GF_Write,
+                                           nXOff, nYOff, nXSize, nYSize,
+                                           pabyBuf, nXSize, nYSize,
+                                           psJob->eBufType,
+                                           psWO->nBandCount,
+                                           psWO->panDstBands, 0, 0, 0 );
+        CPLReleaseMutex( psJob->hMutex );
+    }
+
+    CSLDestroy( papszInitValues );
+    CPLFree( pabyBuf );
+}
+
+CPLErr GDALProcess::warpChunksMulti(const char *pszSrcFilename, GDALDatasetH hDstDS,
+                                    char **papszTO, char **papszWarpOptions,
+                                    GDALResampleAlg eResampleAlg, GDALDataType eWorkingType)
+{
+    int i, iThread;
+    int nThreads = (warpThreads > 0) ? warpThreads : CPLGetNumCPUs();
+    int nDstXSize = GDALGetRasterXSize( hDstDS );
+    int nDstYSize = GDALGetRasterYSize( hDstDS );
+    int nBandCount = GDALGetRasterCount( hDstDS );
+    GDALDataType eBufType = GDALGetRasterDataType( GDALGetRasterBand( hDstDS, 1 ) );
+    CPLErr eErr = CE_None;
+
+    if( nThreads < 1 )
+        nThreads = 1;
+
+/* -------------------------------------------------------------------- */
+/*      Chunk size: explicit, else enough chunks to keep every thread   */
+/*      busy.  A memory limit caps the source plus destination          */
+/*      buffers of all threads together (source taken as the same       */
+/*      size as the destination chunk).                                 */
+/* -------------------------------------------------------------------- */
+    int nChunkSize = warpChunkSize;
+    if( nChunkSize <= 0 )
+    {
+        nChunkSize = 1024;
+        while( nChunkSize > 128
+               && ((nDstXSize + nChunkSize - 1) / nChunkSize)
+                  * ((nDstYSize + nChunkSize - 1) / nChunkSize) < 4 * nThreads )
+            nChunkSize /= 2;
+    }
+    if( warpMemoryLimit > 0.0 )
+    {
+        double dfPixelBytes = 2.0 * nBandCount * (GDALGetDataTypeSize( eBufType ) / 8) * nThreads;
+        while( nChunkSize > 64
+               && (double) nChunkSize * nChunkSize * dfPixelBytes > warpMemoryLimit )
+            nChunkSize /= 2;
+    }
+
+    int nChunkCount = 0;
+    int *panChunks = (int *) CPLMalloc( sizeof(int) * 4
+        * ((nDstXSize + nChunkSize - 1) / nChunkSize)
+        * ((nDstYSize + nChunkSize - 1) / nChunkSize) );
+    for( int nYOff = 0; nYOff < nDstYSize; nYOff += nChunkSize )
+    {
+        for( int nXOff = 0; nXOff < nDstXSize; nXOff += nChunkSize )
+        {
+            panChunks[nChunkCount*4+0] = nXOff;
+            panChunks[nChunkCount*4+1] = nYOff;
+            panChunks[nChunkCount*4+2] = MIN(nChunkSize, nDstXSize - nXOff);
+            panChunks[nChunkCount*4+3] = MIN(nChunkSize, nDstYSize - nYOff);
+            nChunkCount++;
+        }
+    }
+
+    /* CPLCreateMutex() returns the mutex already acquired */
+    void *hMutex = CPLCreateMutex();
+    CPLReleaseMutex( hMutex );
+    int nNextChunk = 0;
+
+/* -------------------------------------------------------------------- */
+/*      Per-thread source, transformer and warp operation.  These are   */
+/*      built here, serially, as GDALOpen() and transformer creation    */
+/*      also read the destination dataset.                              */
+/* -------------------------------------------------------------------- */
+    WarpThreadJob *pasJobs = (WarpThreadJob *) CPLCalloc( nThreads, sizeof(WarpThreadJob) );
+    void **pahThreads = (void **) CPLCalloc( nThreads, sizeof(void*) );
+
+    for( iThread = 0; iThread < nThreads && eErr == CE_None; iThread++ )
+    {
+        WarpThreadJob *psJob = pasJobs + iThread;
+        GDALTransformerFunc pfnTransformer = GDALGenImgProjTransform;
+        void *hTransformArg;
+
+        psJob->hDstDS = hDstDS;
+        psJob->panChunks = panChunks;
+        psJob->nChunkCount = nChunkCount;
+        psJob->pnNextChunk = &nNextChunk;
+        psJob->hMutex = hMutex;
+        psJob->eBufType = eBufType;
+        /* An empty INIT_DEST means no initialisation, as in WarpRegion() */
+        const char *pszInitDest = CSLFetchNameValue( papszWarpOptions, "INIT_DEST" );
+        psJob->bInitDest = pszInitDest != NULL && !EQUAL(pszInitDest, "");
+        psJob->eErr = CE_None;
+
+        psJob->hSrcDS = GDALOpen( pszSrcFilename, GA_ReadOnly );
+        if( psJob->hSrcDS == NULL )
+        {
+            eErr = CE_Failure;
+            break;
+        }
+
+        hTransformArg = psJob->hGenImgProjArg =
+            GDALCreateGenImgProjTransformer2( psJob->hSrcDS, hDstDS, papszTO );
+        if( hTransformArg == NULL )
+        {
+            eErr = CE_Failure;
+            break;
+        }
+
+        if( warpErrorThreshold != 0.0 )
+        {
+            hTransformArg = psJob->hApproxArg =
+                GDALCreateApproxTransformer( GDALGenImgProjTransform,
+                                             psJob->hGenImgProjArg,
+                                             warpErrorThreshold );
+            pfnTransformer = GDALApproxTransform;
+        }
+
+        GDALWarpOptions *psWO = psJob->psWO = GDALCreateWarpOptions();
+
+        psWO->papszWarpOptions = CSLDuplicate(papszWarpOptions);
+        psWO->eWorkingDataType = eWorkingType;
+        psWO->eResampleAlg = eResampleAlg;
+
+        psWO->hSrcDS = psJob->hSrcDS;
+        psWO->hDstDS = hDstDS;
+
+        psWO->pfnTransformer = pfnTransformer;
+        psWO->pTransformerArg = hTransformArg;
+
+        if( warpMemoryLimit != 0.0 )
+            psWO->dfWarpMemoryLimit = warpMemoryLimit / nThreads;
+
+        psWO->nBandCount = MIN(GDALGetRasterCount(psJob->hSrcDS), nBandCount);
+        psWO->panSrcBands = (int *) CPLMalloc(psWO->nBandCount*sizeof(int));
+        psWO->panDstBands = (int *) CPLMalloc(psWO->nBandCount*sizeof(int));
+
+        for( i = 0; i < psWO->nBandCount; i++ )
+        {
+            psWO->panSrcBands[i] = i+1;
+            psWO->panDstBands[i] = i+1;
+        }
+
+        psJob->poOperation = new GDALWarpOperation();
+        eErr = psJob->poOperation->Initialize( psWO );
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Run the pool.                                                   */
+/* -------------------------------------------------------------------- */
+    if( eErr == CE_None )
+    {
+        for( iThread = 0; iThread < nThreads; iThread++ )
+            pahThreads[iThread] = CPLCreateJoinableThread( WarpChunkThread,
+                                                           pasJobs + iThread );
+
+        for( iThread = 0; iThread < nThreads; iThread++ )
+        {
+            if( pahThreads[iThread] != NULL )
+                CPLJoinThread( pahThreads[iThread] );
+            else
+                WarpChunkThread( pasJobs + iThread );
+
+            if( pasJobs[iThread].eErr != CE_None )
+                eErr = pasJobs[iThread].eErr;
+        }
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Cleanup                                                         */
+/* -------------------------------------------------------------------- */
+    for( iThread = 0; iThread < nThreads; iThread++ )
+    {
+        WarpThreadJob *psJob = pasJobs + iThread;
+
+        delete psJob->poOperation;
+        if( psJob->psWO != NULL )
+            GDALDestroyWarpOptions( psJob->psWO );
+        if( psJob->hApproxArg != NULL )
+            GDALDestroyApproxTransformer( psJob->hApproxArg );
+        if( psJob->hGenImgProjArg != NULL )
+            GDALDestroyGenImgProjTransformer( psJob->hGenImgProjArg );
+        if( psJob->hSrcDS != NULL )
+            GDALClose( psJob->hSrcDS );
+    }
+
+    CPLFree( pahThreads );
+    CPLFree( pasJobs );
+    CPLFree( panChunks );
+    CPLDestroyMutex( hMutex );
+
+    return eErr;
+}
+
 GDALDatasetH 
 GDALProcess::GDALWarpCreateOutput( char *papszSrcFile, const char *pszFilename, 
                       const char *pszFormat, char **papszTO, 
@@ -24,6 +24,7 @@
 #include "ogr_srs_api.h"
 #include "vrt/vrtdataset.h"
 #include "commonutils.h"
+#include "processingsession.h"
 
 // Include some basic libraries for handling
 #include <string>
@@ -34,7 +35,8 @@ class GDALProcess
 {
 
 public:
-GDALProcess(){};  
+GDALProcess() : nGCPCount(0), nSrcXOff(0), nSrcYOff(0), warpThreads(1),
+		warpChunkSize(0), warpMemoryLimit(0.0), warpErrorThreshold(0.125) {};  
 
 /// Taken from gdal_rasterize
 int ArgIsNumeric( const char *pszArg );
@@ -52,6 +54,20 @@ int maskGEOTIFF( std::string inputFilename, int burnValue, std::string outputFil
 /// Taken from gdal_translate
 int writeGEOTIFF(std::string inputFilenameN1, std::string inputTiff, std::string outputGeotiff);
 
+/// Writes the N1 GCPs into an existing GeoTIFF header, no pixels are copied
+int attachGCPs(std::string inputFilenameN1, std::string inputTiff);
+
+/// In-process pipeline: intermediates live in /vsimem/ and only the final product is written to disk
+int writeGEOTIFF(std::string inputFilenameN1, const unsigned char *pabyImage,
+		 int nXSize, int nYSize, int nLineSpace, std::string outputGeotiff);
+int copyGEOTIFF(std::string inputFilename, std::string outputFilename);
+int removeGEOTIFF(std::string inputFilename);
+static void cleanup();
+
+/// Pixel/line of the N1 at the detector image's upper left, non-zero when only an AOI was detected
+void setSourceOffset(int nXOff, int nYOff){nSrcXOff = nXOff; nSrcYOff = nYOff;};
+GDAL_GCP *DuplicateOffsetGCPs( GDALDatasetH hN1DS );
+
 void SrcToDst( double dfX, double dfY,
                       int nSrcXOff, int nSrcYOff,
                       int nSrcXSize, int nSrcYSize,
@@ -71,6 +87,24 @@ int warpGEOTIFF(std::string inputFilename,
 		std::string warpFormat,
 		std::string outputFile);
 
+/// Parallel warp: destination chunks shared out to a pool of threads,
+/// each with its own source dataset and transformer
+CPLErr warpChunksMulti(const char *pszSrcFilename, GDALDatasetH hDstDS,
+		       char **papszTO, char **papszWarpOptions,
+		       GDALResampleAlg eResampleAlg, GDALDataType eWorkingType);
+
+int getWarpThreads(void){return warpThreads;};
+void setWarpThreads(int val){warpThreads = val;};		// 1 = original ChunkAndWarpImage, 0 = one per CPU
+
+int getWarpChunkSize(void){return warpChunkSize;};
+void setWarpChunkSize(int val){warpChunkSize = val;};		// Destination chunk side in pixels, 0 = automatic
+
+double getWarpMemoryLimit(void){return warpMemoryLimit;};
+void setWarpMemoryLimit(double val){warpMemoryLimit = val;};	// Bytes, 0 = GDAL default
+
+double getWarpErrorThreshold(void){return warpErrorThreshold;};
+void setWarpErrorThreshold(double val){warpErrorThreshold = val;};	// Approximate transformer error in pixels, 0 = exact
+
 // MYOWN
 void getLATLONG(std::string inputFilename,
 		std::vector<double> &x,
@@ -113,6 +147,13 @@ virtual ~GDALProcess();
 private:
 
   int nGCPCount;
+  int nSrcXOff;
+  int nSrcYOff;
+  
+  int warpThreads;
+  int warpChunkSize;
+  double warpMemoryLimit;
+  double warpErrorThreshold;
 };
 
 #endif // GDALPROCESS_H
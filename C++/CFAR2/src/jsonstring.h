@@ -0,0 +1,27 @@
+/** 
+ *
+ * CFAR2 ship detection pipeline
+ * JSON string quoting for the metrics and trace writers
+ *
+**/
+
+#ifndef JSONSTRING_H
+#define JSONSTRING_H
+
+#include <string>
+
+/// Quoted JSON string. The names written (timers, counters, spans, threads)
+/// are ours, so only quotes and backslashes need escaping
+inline std::string jsonString(const std::string &value)
+{
+  std::string escaped = "\"";
+  for(size_t i = 0; i < value.size(); i++)
+  {
+    if(value[i] == '"' || value[i] == '\\')
+      escaped += '\\';
+    escaped += value[i];
+  }
+  return escaped + "\"";
+}
+
+#endif // JSONSTRING_H
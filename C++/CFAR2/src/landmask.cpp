@@ -0,0 +1,233 @@
+/** 
+ *
+ * CFAR2 ship detection pipeline
+ * Point-in-polygon land mask for detections
+ *
+**/
+
+#include "landmask.h"
+#include "processingsession.h"
+
+#include <geos/geom/Coordinate.h>
+#include <geos/geom/Envelope.h>
+#include <geos/geom/Point.h>
+#include <geos/geom/prep/PreparedGeometryFactory.h>
+#include <geos/io/WKBReader.h>
+
+#include <cmath>
+#include <sstream>
+
+LandMask::LandMask()
+  : factory(geos::geom::GeometryFactory::getDefaultInstance()), tree(NULL)
+{
+}
+
+LandMask::~LandMask()
+{
+  clear();
+}
+
+void LandMask::clear()
+{
+    delete tree;
+    tree = NULL;
+
+    for( size_t i = 0; i < prepared.size(); i++ )
+        geos::geom::prep::PreparedGeometryFactory::destroy( prepared[i] );
+    prepared.clear();
+    parts.clear();
+
+    for( size_t i = 0; i < geometries.size(); i++ )
+        factory->destroyGeometry( geometries[i] );
+    geometries.clear();
+
+    filename = "";
+}
+
+/************************************************************************/
+/*                                load()                                */
+/*                                                                      */
+/*      Reads the first layer like maskGEOTIFF(), reprojecting to       */
+/*      WGS84 lat/long if the layer has another SRS.  Geometries go     */
+/*      from OGR to GEOS through WKB.                                   */
+/************************************************************************/
+
+int LandMask::load(std::string inputFilenameSHP)
+{
+    OGRDataSourceH hSrcDS;
+    OGRLayerH hLayer;
+    OGRFeatureH hFeature;
+    OGRSpatialReferenceH hSrcSRS, hWGS84 = NULL;
+    OGRCoordinateTransformationH hCT = NULL;
+    geos::io::WKBReader oReader( *factory );
+
+    clear();
+    ProcessingSession::instance()->initializeGDAL();
+
+    hSrcDS = OGROpen( inputFilenameSHP.c_str(), FALSE, NULL );
+    if( hSrcDS == NULL )
+    {
+        fprintf( stderr, "Unable to open land polygons %s.\n", inputFilenameSHP.c_str() );
+        return 1;
+    }
+    hLayer = OGR_DS_GetLayer( hSrcDS, 0 );
+    if( hLayer == NULL )
+    {
+        OGR_DS_Destroy( hSrcDS );
+        return 1;
+    }
+
+    hSrcSRS = OGR_L_GetSpatialRef( hLayer );
+    if( hSrcSRS != NULL )
+    {
+        hWGS84 = OSRNewSpatialReference( NULL );
+        OSRSetWellKnownGeogCS( hWGS84, "WGS84" );
+        if( !OSRIsSame( hSrcSRS, hWGS84 ) )
+            hCT = OCTNewCoordinateTransformation( hSrcSRS, hWGS84 );
+    }
+
+    OGR_L_ResetReading( hLayer );
+    while( (hFeature = OGR_L_GetNextFeature( hLayer )) != NULL )
+    {
+        OGRGeometryH hGeom = OGR_F_GetGeometryRef( hFeature );
+        OGRwkbGeometryType eType = hGeom ? wkbFlatten( OGR_G_GetGeometryType( hGeom ) ) : wkbUnknown;
+
+        if( eType == wkbPolygon || eType == wkbMultiPolygon )
+        {
+            if( hCT != NULL )
+                OGR_G_Transform( hGeom, hCT );
+
+            int nSize = OGR_G_WkbSize( hGeom );
+            std::vector<unsigned char> abyWKB( nSize );
+            OGR_G_ExportToWkb( hGeom, wkbNDR, &abyWKB[0] );
+
+            std::istringstream oStream( std::string( (const char *) &abyWKB[0], nSize ),
+                                        std::ios::in | std::ios::binary );
+            try
+            {
+                geometries.push_back( oReader.read( oStream ) );
+            }
+            catch( const std::exception &e )
+            {
+                fprintf( stderr, "Skipping land polygon %ld: %s\n",
+                         (long) OGR_F_GetFID( hFeature ), e.what() );
+            }
+        }
+
+        OGR_F_Destroy( hFeature );
+    }
+
+    if( hCT != NULL )
+        OCTDestroyCoordinateTransformation( hCT );
+    if( hWGS84 != NULL )
+        OSRDestroySpatialReference( hWGS84 );
+    OGR_DS_Destroy( hSrcDS );
+
+/* -------------------------------------------------------------------- */
+/*      Continental multipolygons are split so the tree can discard     */
+/*      islands and far away coastline.                                 */
+/* -------------------------------------------------------------------- */
+    tree = new geos::index::strtree::STRtree();
+    for( size_t i = 0; i < geometries.size(); i++ )
+    {
+        for( size_t j = 0; j < geometries[i]->getNumGeometries(); j++ )
+        {
+            const geos::geom::Geometry *poPart = geometries[i]->getGeometryN( j );
+            if( poPart->isEmpty() )
+                continue;
+
+            parts.push_back( poPart );
+            prepared.push_back( geos::geom::prep::PreparedGeometryFactory::prepare( poPart ) );
+            tree->insert( poPart->getEnvelopeInternal(), (void *) (parts.size() - 1) );
+        }
+    }
+
+    filename = inputFilenameSHP;
+    return 0;
+}
+
+/************************************************************************/
+/*                               isLand()                               */
+/*                                                                      */
+/*      Polygons whose envelope holds the point (grown by the buffer)   */
+/*      are tested with the prepared covers().  The coastal buffer is   */
+/*      converted to degrees at the detection's latitude (longitude     */
+/*      scale, so it errs on the side of masking).                      */
+/************************************************************************/
+
+bool LandMask::isLand(double dfLat, double dfLong, double dfBufferMetres)
+{
+    if( tree == NULL )
+        return false;
+
+    double dfBuffer = 0.0;
+    if( dfBufferMetres > 0.0 )
+        dfBuffer = dfBufferMetres / (111320.0 * std::max( cos( dfLat * M_PI / 180.0 ), 0.01 ));
+
+    geos::geom::Envelope oSearch( dfLong - dfBuffer, dfLong + dfBuffer,
+                                  dfLat - dfBuffer, dfLat + dfBuffer );
+    std::vector<void*> apCandidates;
+    tree->query( &oSearch, apCandidates );
+    if( apCandidates.empty() )
+        return false;
+
+    geos::geom::Point *poPoint = factory->createPoint( geos::geom::Coordinate( dfLong, dfLat ) );
+    bool bLand = false;
+
+    for( size_t i = 0; i < apCandidates.size() && !bLand; i++ )
+    {
+        size_t iPart = (size_t) apCandidates[i];
+        bLand = prepared[iPart]->covers( poPoint );
+    }
+
+    for( size_t i = 0; i < apCandidates.size() && !bLand && dfBuffer > 0.0; i++ )
+    {
+        size_t iPart = (size_t) apCandidates[i];
+        bLand = parts[iPart]->isWithinDistance( poPoint, dfBuffer );
+    }
+
+    factory->destroyGeometry( poPoint );
+
+    return bLand;
+}
+
+/************************************************************************/
+/*                           queryPolygons()                            */
+/*                                                                      */
+/*      Land polygons whose envelope meets the search envelope.         */
+/************************************************************************/
+
+void LandMask::queryPolygons(const geos::geom::Envelope *poSearch, std::vector<const geos::geom::Geometry*> &apoPolygons)
+{
+    std::vector<void*> apCandidates;
+
+    apoPolygons.clear();
+    if( tree == NULL )
+        return;
+
+    tree->query( poSearch, apCandidates );
+    for( size_t i = 0; i < apCandidates.size(); i++ )
+        apoPolygons.push_back( parts[(size_t) apCandidates[i]] );
+}
+
+/************************************************************************/
+/*                           maskDetections()                           */
+/*                                                                      */
+/*      Drops the detections on land, returns how many were dropped.    */
+/************************************************************************/
+
+int LandMask::maskDetections(std::vector<ShipDetection> &detections, double dfBufferMetres)
+{
+    std::vector<ShipDetection> oSea;
+
+    for( size_t i = 0; i < detections.size(); i++ )
+    {
+        if( !isLand( detections[i].dfLat, detections[i].dfLong, dfBufferMetres ) )
+            oSea.push_back( detections[i] );
+    }
+
+    int nMasked = detections.size() - oSea.size();
+    detections.swap( oSea );
+
+    return nMasked;
+}
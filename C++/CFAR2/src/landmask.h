@@ -0,0 +1,58 @@
+/** 
+ *
+ * CFAR2 ship detection pipeline
+ * Point-in-polygon land mask for detections
+ *
+**/
+
+#ifndef LANDMASK_H
+#define LANDMASK_H
+
+#include "ogr_api.h"
+#include "ogr_srs_api.h"
+#include "cpl_conv.h"
+
+#include <geos/geom/Geometry.h>
+#include <geos/geom/GeometryFactory.h>
+#include <geos/geom/prep/PreparedGeometry.h>
+#include <geos/index/strtree/STRtree.h>
+
+#include "detectionwriter.h"
+
+#include <string>
+#include <vector>
+
+/// Point-in-polygon land mask for detections.  The land polygons are read
+/// once, split into their parts, prepared and indexed with an STRtree, so a
+/// query costs O(log polygons) whatever the raster size.
+class LandMask
+{
+
+public:
+LandMask();
+
+int load(std::string inputFilenameSHP);
+std::string getFilename(void){return filename;};
+int getPolygonCount(void){return prepared.size();};
+
+bool isLand(double dfLat, double dfLong, double dfBufferMetres = 0.0);
+int maskDetections(std::vector<ShipDetection> &detections, double dfBufferMetres = 0.0);
+void queryPolygons(const geos::geom::Envelope *poSearch, std::vector<const geos::geom::Geometry*> &apoPolygons);
+const geos::geom::GeometryFactory *getFactory(void){return factory;};
+int getGeometryCount(void){return geometries.size();};
+const geos::geom::Geometry *getGeometry(int i){return geometries[i];};
+
+virtual ~LandMask();
+
+private:
+  void clear();
+
+  std::string filename;
+  const geos::geom::GeometryFactory *factory;
+  std::vector<geos::geom::Geometry*> geometries;		// Owned, one per OGR feature
+  std::vector<const geos::geom::Geometry*> parts;		// Polygons of the geometries
+  std::vector<const geos::geom::prep::PreparedGeometry*> prepared;
+  geos::index::strtree::STRtree *tree;			// Items are indices into parts
+};
+
+#endif // LANDMASK_H
@@ -0,0 +1,705 @@
+/** 
+ *
+ * CFAR2 ship detection pipeline
+ * Persistent pre-rasterised land mask tile cache
+ *
+**/
+
+#include "landtilecache.h"
+#include "processingsession.h"
+
+#include "opencv/cv.h"
+
+#include <geos/geom/Coordinate.h>
+#include <geos/geom/CoordinateSequence.h>
+#include <geos/geom/Envelope.h>
+#include <geos/geom/LinearRing.h>
+#include <geos/geom/Polygon.h>
+#include <geos/io/WKBWriter.h>
+#include <geos/util/GEOSException.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+/* Resolution levels: ~600 m, ~76 m and ~19 m pixels at the equator */
+static const int anDefaultLevels[] = { 7, 10, 12 };
+
+#define CACHE_MAGIC "CFARLMC1"
+
+/* Start of the cache file, followed by the deflated masks, the feature */
+/* table (hash and envelope of every source polygon) and the node table */
+struct LandCacheHeader
+{
+    char szMagic[8];
+    GUInt32 nTileSize;
+    GUInt32 nLevelCount;
+    GUInt32 anLevels[4];
+    GUIntBig nSourceChecksum;
+    GUIntBig nFeatureOffset;
+    GUIntBig nFeatureCount;
+    GUIntBig nNodeOffset;
+    GUIntBig nNodeCount;
+};
+
+/* 64 bit FNV-1a */
+static GUIntBig HashBytes( const unsigned char *pabyData, size_t nBytes,
+                           GUIntBig nHash = 14695981039346656037ULL )
+{
+    for( size_t i = 0; i < nBytes; i++ )
+    {
+        nHash ^= pabyData[i];
+        nHash *= 1099511628211ULL;
+    }
+    return nHash;
+}
+
+LandTileCache::LandTileCache()
+  : rebuiltCount(0), nodeCount(0), pabyMap(NULL), nMapSize(0),
+    pasFeatures(NULL), featureCount(0), fullBuild(true),
+    lastKey(~(GUIntBig) 0), lastClass(SEA), lastBits(NULL)
+{
+    levels.assign( anDefaultLevels, anDefaultLevels + sizeof(anDefaultLevels) / sizeof(int) );
+}
+
+LandTileCache::~LandTileCache()
+{
+    close();
+}
+
+void LandTileCache::close()
+{
+    unmap();
+    filename = "";
+    source = "";
+}
+
+/************************************************************************/
+/*                              checksum()                              */
+/************************************************************************/
+
+GUIntBig LandTileCache::checksum(std::string inputFilename)
+{
+    VSILFILE *fp = VSIFOpenL( inputFilename.c_str(), "rb" );
+    if( fp == NULL )
+        return 0;
+
+    std::vector<unsigned char> abyChunk( 65536 );
+    GUIntBig nHash = 14695981039346656037ULL;
+    size_t nRead;
+    while( (nRead = VSIFReadL( &abyChunk[0], 1, abyChunk.size(), fp )) > 0 )
+        nHash = HashBytes( &abyChunk[0], nRead, nHash );
+
+    VSIFCloseL( fp );
+    return nHash;
+}
+
+/************************************************************************/
+/*                                open()                                */
+/*                                                                      */
+/*      Maps <cacheDirectory>/<shapefile basename>.landcache.  If the   */
+/*      shapefile checksum differs from the one recorded, the land     */
+/*      polygons are loaded and compared feature by feature with the    */
+/*      recorded hashes; only the quadtree nodes under the envelopes    */
+/*      of added or removed features are rasterised again.              */
+/************************************************************************/
+
+int LandTileCache::open(std::string cacheDirectory, std::string inputFilenameSHP, LandMask &landMask)
+{
+    close();
+
+    GUIntBig nChecksum = checksum( inputFilenameSHP );
+    if( nChecksum == 0 )
+    {
+        fprintf( stderr, "Unable to read land polygons %s.\n", inputFilenameSHP.c_str() );
+        return 1;
+    }
+
+    VSIMkdir( cacheDirectory.c_str(), 0755 );
+    std::string cacheFilename = CPLFormFilename( cacheDirectory.c_str(),
+                                                 CPLGetBasename( inputFilenameSHP.c_str() ),
+                                                 "landcache" );
+
+    bool bMapped = (map( cacheFilename ) == 0);
+    rebuiltCount = 0;
+    if( bMapped && ((LandCacheHeader *) pabyMap)->nSourceChecksum == nChecksum )
+    {
+        filename = cacheFilename;
+        source = inputFilenameSHP;
+        return 0;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Hash the polygons of the new coastline.                         */
+/* -------------------------------------------------------------------- */
+    if( landMask.getFilename() != inputFilenameSHP && landMask.load( inputFilenameSHP ) != 0 )
+    {
+        unmap();
+        return 1;
+    }
+
+    std::vector<Feature> features;
+    geos::io::WKBWriter oWriter;
+    for( int i = 0; i < landMask.getGeometryCount(); i++ )
+    {
+        const geos::geom::Geometry *poGeom = landMask.getGeometry( i );
+        const geos::geom::Envelope *poEnv = poGeom->getEnvelopeInternal();
+        std::ostringstream oStream( std::ios::out | std::ios::binary );
+        oWriter.write( *poGeom, oStream );
+        std::string osWKB = oStream.str();
+
+        Feature sFeature;
+        sFeature.nHash = HashBytes( (const unsigned char *) osWKB.data(), osWKB.size() );
+        sFeature.dfMinX = poEnv->getMinX();
+        sFeature.dfMinY = poEnv->getMinY();
+        sFeature.dfMaxX = poEnv->getMaxX();
+        sFeature.dfMaxY = poEnv->getMaxY();
+        features.push_back( sFeature );
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Features only in the old or only in the new coastline mark      */
+/*      the areas to rebuild.                                           */
+/* -------------------------------------------------------------------- */
+    dirty.clear();
+    fullBuild = !bMapped;
+    if( bMapped )
+    {
+        std::map<GUIntBig, int> oOldCount;
+        int i;
+        for( i = 0; i < featureCount; i++ )
+            oOldCount[pasFeatures[i].nHash]++;
+
+        for( i = 0; i < (int) features.size(); i++ )
+        {
+            std::map<GUIntBig, int>::iterator oIter = oOldCount.find( features[i].nHash );
+            if( oIter != oOldCount.end() && oIter->second > 0 )
+                oIter->second--;
+            else
+                dirty.push_back( features[i] );
+        }
+        for( i = 0; i < featureCount; i++ )
+        {
+            if( oOldCount[pasFeatures[i].nHash] > 0 )
+            {
+                oOldCount[pasFeatures[i].nHash]--;
+                dirty.push_back( pasFeatures[i] );
+            }
+        }
+    }
+
+    std::string tempFilename = cacheFilename + ".tmp";
+    if( build( tempFilename, nChecksum, landMask, features ) != 0 )
+    {
+        VSIUnlink( tempFilename.c_str() );
+        unmap();
+        return 1;
+    }
+
+    unmap();
+    if( VSIRename( tempFilename.c_str(), cacheFilename.c_str() ) != 0 || map( cacheFilename ) != 0 )
+    {
+        fprintf( stderr, "Unable to replace land mask cache %s.\n", cacheFilename.c_str() );
+        return 1;
+    }
+
+    filename = cacheFilename;
+    source = inputFilenameSHP;
+    return 0;
+}
+
+/************************************************************************/
+/*                             map()/unmap()                            */
+/************************************************************************/
+
+int LandTileCache::map(std::string cacheFilename)
+{
+    unmap();
+
+    int fd = ::open( cacheFilename.c_str(), O_RDONLY );
+    if( fd < 0 )
+        return 1;
+
+    struct stat sStat;
+    if( fstat( fd, &sStat ) != 0 || sStat.st_size < (off_t) sizeof(LandCacheHeader) )
+    {
+        ::close( fd );
+        return 1;
+    }
+
+    void *pMap = mmap( NULL, sStat.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    ::close( fd );
+    if( pMap == MAP_FAILED )
+        return 1;
+
+    pabyMap = (unsigned char *) pMap;
+    nMapSize = sStat.st_size;
+
+/* -------------------------------------------------------------------- */
+/*      A cache written with other levels or tile size is rebuilt.      */
+/* -------------------------------------------------------------------- */
+    const LandCacheHeader *psHeader = (const LandCacheHeader *) pabyMap;
+    bool bValid = memcmp( psHeader->szMagic, CACHE_MAGIC, 8 ) == 0
+        && psHeader->nTileSize == TILE_SIZE
+        && psHeader->nLevelCount == levels.size()
+        && psHeader->nFeatureOffset + psHeader->nFeatureCount * sizeof(Feature) <= nMapSize
+        && psHeader->nNodeOffset + psHeader->nNodeCount * sizeof(Node) <= nMapSize;
+    for( size_t i = 0; bValid && i < levels.size(); i++ )
+        bValid = (psHeader->anLevels[i] == (GUInt32) levels[i]);
+
+    if( !bValid )
+    {
+        unmap();
+        return 1;
+    }
+
+    pasFeatures = (const Feature *) (pabyMap + psHeader->nFeatureOffset);
+    featureCount = (int) psHeader->nFeatureCount;
+
+    const Node *pasNodes = (const Node *) (pabyMap + psHeader->nNodeOffset);
+    nodeCount = (int) psHeader->nNodeCount;
+    for( int i = 0; i < nodeCount; i++ )
+        index[key( pasNodes[i].nLevel, pasNodes[i].nX, pasNodes[i].nY )] = pasNodes + i;
+
+    return 0;
+}
+
+void LandTileCache::unmap()
+{
+    if( pabyMap != NULL )
+        munmap( pabyMap, nMapSize );
+    pabyMap = NULL;
+    nMapSize = 0;
+    pasFeatures = NULL;
+    featureCount = 0;
+    nodeCount = 0;
+    index.clear();
+    decoded.clear();
+    lastKey = ~(GUIntBig) 0;
+}
+
+/************************************************************************/
+/*                               build()                                */
+/*                                                                      */
+/*      Descends the quadtree from the two level 0 tiles, clipping the  */
+/*      polygons of the parent node to each child so the deep levels    */
+/*      only ever see a few kilometres of coastline.                    */
+/************************************************************************/
+
+int LandTileCache::build(std::string cacheFilename, GUIntBig nSourceChecksum,
+                         LandMask &landMask, const std::vector<Feature> &features)
+{
+    VSILFILE *fp = VSIFOpenL( cacheFilename.c_str(), "wb" );
+    if( fp == NULL )
+    {
+        fprintf( stderr, "Unable to create land mask cache %s.\n", cacheFilename.c_str() );
+        return 1;
+    }
+
+    LandCacheHeader sHeader;
+    memset( &sHeader, 0, sizeof(sHeader) );
+    VSIFWriteL( &sHeader, sizeof(sHeader), 1, fp );
+
+    std::vector<const geos::geom::Geometry*> apoParts;
+    for( int i = 0; i < landMask.getGeometryCount(); i++ )
+    {
+        const geos::geom::Geometry *poGeom = landMask.getGeometry( i );
+        for( size_t j = 0; j < poGeom->getNumGeometries(); j++ )
+            if( !poGeom->getGeometryN( j )->isEmpty() )
+                apoParts.push_back( poGeom->getGeometryN( j ) );
+    }
+
+    newNodes.clear();
+    rebuiltCount = 0;
+    buildNode( 0, 0, 0, apoParts, landMask.getFactory(), fp );
+    buildNode( 0, 1, 0, apoParts, landMask.getFactory(), fp );
+
+/* -------------------------------------------------------------------- */
+/*      Tables after the masks, aligned for the mapping.                */
+/* -------------------------------------------------------------------- */
+    static const unsigned char abyPad[8] = { 0 };
+    VSIFWriteL( abyPad, 1, (8 - VSIFTellL( fp ) % 8) % 8, fp );
+
+    sHeader.nFeatureOffset = VSIFTellL( fp );
+    sHeader.nFeatureCount = features.size();
+    if( !features.empty() )
+        VSIFWriteL( &features[0], sizeof(Feature), features.size(), fp );
+
+    sHeader.nNodeOffset = VSIFTellL( fp );
+    sHeader.nNodeCount = newNodes.size();
+    if( !newNodes.empty() )
+        VSIFWriteL( &newNodes[0], sizeof(Node), newNodes.size(), fp );
+
+    memcpy( sHeader.szMagic, CACHE_MAGIC, 8 );
+    sHeader.nTileSize = TILE_SIZE;
+    sHeader.nLevelCount = levels.size();
+    for( size_t i = 0; i < levels.size(); i++ )
+        sHeader.anLevels[i] = levels[i];
+    sHeader.nSourceChecksum = nSourceChecksum;
+
+    VSIFSeekL( fp, 0, SEEK_SET );
+    int bOK = VSIFWriteL( &sHeader, sizeof(sHeader), 1, fp ) == 1;
+    bOK &= VSIFCloseL( fp ) == 0;
+    newNodes.clear();
+
+    return bOK ? 0 : 1;
+}
+
+void LandTileCache::buildNode(int nLevel, int nX, int nY,
+                              const std::vector<const geos::geom::Geometry*> &apoParent,
+                              const geos::geom::GeometryFactory *factory, VSILFILE *fp)
+{
+    double dfSize = 180.0 / (1 << nLevel);
+    double dfMinX = -180.0 + nX * dfSize, dfMaxX = dfMinX + dfSize;
+    double dfMaxY = 90.0 - nY * dfSize, dfMinY = dfMaxY - dfSize;
+
+    if( !fullBuild && !isDirty( dfMinX, dfMinY, dfMaxX, dfMaxY ) )
+    {
+        copyNode( nLevel, nX, nY, fp );
+        return;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Clip the parent's polygons to the node.                         */
+/* -------------------------------------------------------------------- */
+    geos::geom::Envelope oBox( dfMinX, dfMaxX, dfMinY, dfMaxY );
+    geos::geom::Geometry *poBox = factory->toGeometry( &oBox );
+    std::vector<const geos::geom::Geometry*> apoParts;
+    std::vector<geos::geom::Geometry*> apoOwned;
+    bool bLand = false;
+
+    for( size_t i = 0; i < apoParent.size() && !bLand; i++ )
+    {
+        const geos::geom::Envelope *poEnv = apoParent[i]->getEnvelopeInternal();
+        if( !poEnv->intersects( oBox ) )
+            continue;
+
+        const geos::geom::Geometry *poPart = apoParent[i];
+        if( !oBox.covers( poEnv ) )
+        {
+            try
+            {
+                geos::geom::Geometry *poClipped = apoParent[i]->intersection( poBox );
+                if( poClipped->isEmpty() )
+                {
+                    factory->destroyGeometry( poClipped );
+                    continue;
+                }
+                apoOwned.push_back( poClipped );
+                poPart = poClipped;
+            }
+            catch( const geos::util::GEOSException &e )
+            {
+                /* Invalid polygon, the children clip it again */
+            }
+        }
+
+        apoParts.push_back( poPart );
+        bLand = poPart->getArea() >= oBox.getArea() * (1.0 - 1e-9) && poPart->covers( poBox );
+    }
+
+    Node sNode;
+    memset( &sNode, 0, sizeof(sNode) );
+    sNode.nLevel = nLevel;
+    sNode.nX = nX;
+    sNode.nY = nY;
+
+    if( bLand )
+    {
+        sNode.nClass = LAND;
+        writeNode( sNode, NULL, fp );
+    }
+    else
+    if( !apoParts.empty() )
+    {
+        sNode.nClass = COAST;
+
+/* -------------------------------------------------------------------- */
+/*      Rasterise coastal nodes at the resolution levels.  Each         */
+/*      polygon is filled with its holes in one call, with 4 bits of    */
+/*      sub-pixel precision and pixel centres at the half pixel.        */
+/* -------------------------------------------------------------------- */
+        if( isResolutionLevel( nLevel ) )
+        {
+            cv::Mat mask( TILE_SIZE, TILE_SIZE, CV_8UC1, cv::Scalar::all(0) );
+            double dfScale = 16.0 * TILE_SIZE / dfSize;
+
+            for( size_t i = 0; i < apoParts.size(); i++ )
+            {
+                for( size_t iGeom = 0; iGeom < apoParts[i]->getNumGeometries(); iGeom++ )
+                {
+                    const geos::geom::Polygon *poPolygon =
+                        dynamic_cast<const geos::geom::Polygon*>( apoParts[i]->getGeometryN( iGeom ) );
+                    if( poPolygon == NULL )
+                        continue;
+
+                    std::vector< std::vector<cv::Point> > rings;
+                    for( int iRing = -1; iRing < (int) poPolygon->getNumInteriorRing(); iRing++ )
+                    {
+                        const geos::geom::CoordinateSequence *poSeq = (iRing < 0)
+                            ? poPolygon->getExteriorRing()->getCoordinatesRO()
+                            : poPolygon->getInteriorRingN( iRing )->getCoordinatesRO();
+                        std::vector<cv::Point> ring;
+                        for( size_t k = 0; k < poSeq->getSize(); k++ )
+                        {
+                            const geos::geom::Coordinate &oCoord = poSeq->getAt( k );
+                            ring.push_back( cv::Point( cvRound( (oCoord.x - dfMinX) * dfScale - 8 ),
+                                                       cvRound( (dfMaxY - oCoord.y) * dfScale - 8 ) ) );
+                        }
+                        if( ring.size() >= 3 )
+                            rings.push_back( ring );
+                    }
+
+                    std::vector<const cv::Point*> apoRings;
+                    std::vector<int> anPoints;
+                    for( size_t k = 0; k < rings.size(); k++ )
+                    {
+                        apoRings.push_back( &rings[k][0] );
+                        anPoints.push_back( rings[k].size() );
+                    }
+                    if( !apoRings.empty() )
+                        cv::fillPoly( mask, &apoRings[0], &anPoints[0], apoRings.size(),
+                                      cv::Scalar::all(1), 8, 4 );
+                }
+            }
+
+            std::vector<unsigned char> abyBits( TILE_SIZE * TILE_SIZE / 8, 0 );
+            for( int j = 0; j < TILE_SIZE; j++ )
+            {
+                const uchar *pabyRow = mask.ptr( j );
+                for( int i = 0; i < TILE_SIZE; i++ )
+                    if( pabyRow[i] )
+                        abyBits[(j * TILE_SIZE + i) >> 3] |= 0x80 >> (i & 7);
+            }
+
+            std::vector<unsigned char> abyDeflated( abyBits.size() + 1024 );
+            size_t nDeflated = 0;
+            if( CPLZLibDeflate( &abyBits[0], abyBits.size(), 6,
+                                &abyDeflated[0], abyDeflated.size(), &nDeflated ) != NULL )
+            {
+                sNode.nSize = nDeflated;
+                writeNode( sNode, &abyDeflated[0], fp );
+            }
+            else
+            {
+                sNode.nSize = abyBits.size();
+                sNode.nRaw = 1;
+                writeNode( sNode, &abyBits[0], fp );
+            }
+            rebuiltCount++;
+        }
+        else
+            writeNode( sNode, NULL, fp );
+
+        if( nLevel < levels.back() )
+        {
+            for( int j = 0; j < 2; j++ )
+                for( int i = 0; i < 2; i++ )
+                    buildNode( nLevel + 1, 2 * nX + i, 2 * nY + j, apoParts, factory, fp );
+        }
+    }
+
+    for( size_t i = 0; i < apoOwned.size(); i++ )
+        factory->destroyGeometry( apoOwned[i] );
+    factory->destroyGeometry( poBox );
+}
+
+/* Unchanged subtree of the previous cache, masks copied from the mapping */
+void LandTileCache::copyNode(int nLevel, int nX, int nY, VSILFILE *fp)
+{
+    const Node *psOld = findNode( nLevel, nX, nY );
+    if( psOld == NULL )
+        return;
+
+    writeNode( *psOld, psOld->nOffset ? pabyMap + psOld->nOffset : NULL, fp );
+
+    if( psOld->nClass == COAST && nLevel < levels.back() )
+    {
+        for( int j = 0; j < 2; j++ )
+            for( int i = 0; i < 2; i++ )
+                copyNode( nLevel + 1, 2 * nX + i, 2 * nY + j, fp );
+    }
+}
+
+void LandTileCache::writeNode(const Node &node, const unsigned char *pabyData, VSILFILE *fp)
+{
+    Node sNode = node;
+    sNode.nOffset = 0;
+    if( pabyData != NULL )
+    {
+        sNode.nOffset = VSIFTellL( fp );
+        VSIFWriteL( pabyData, 1, sNode.nSize, fp );
+    }
+    newNodes.push_back( sNode );
+}
+
+bool LandTileCache::isDirty(double dfMinX, double dfMinY, double dfMaxX, double dfMaxY)
+{
+    for( size_t i = 0; i < dirty.size(); i++ )
+    {
+        if( dirty[i].dfMinX <= dfMaxX && dirty[i].dfMaxX >= dfMinX
+            && dirty[i].dfMinY <= dfMaxY && dirty[i].dfMaxY >= dfMinY )
+            return true;
+    }
+    return false;
+}
+
+bool LandTileCache::isResolutionLevel(int nLevel)
+{
+    return std::find( levels.begin(), levels.end(), nLevel ) != levels.end();
+}
+
+const LandTileCache::Node *LandTileCache::findNode(int nLevel, int nX, int nY)
+{
+    std::map<GUIntBig, const Node*>::iterator oIter = index.find( key( nLevel, nX, nY ) );
+    return oIter == index.end() ? NULL : oIter->second;
+}
+
+/************************************************************************/
+/*                               lookup()                               */
+/*                                                                      */
+/*      Class of a tile at a resolution level, walking down from the    */
+/*      root: a missing node is sea, a land node covers its subtree.    */
+/*      Coastal tiles return their inflated bit mask.                   */
+/************************************************************************/
+
+int LandTileCache::lookup(int nLevel, int nX, int nY, const unsigned char **ppabyBits)
+{
+    *ppabyBits = NULL;
+
+    for( int l = 0; l <= nLevel; l++ )
+    {
+        const Node *psNode = findNode( l, nX >> (nLevel - l), nY >> (nLevel - l) );
+        if( psNode == NULL )
+            return SEA;
+        if( psNode->nClass == LAND )
+            return LAND;
+        if( l < nLevel || psNode->nOffset == 0 )
+            continue;
+
+        GUIntBig nKey = key( nLevel, nX, nY );
+        std::map<GUIntBig, std::vector<unsigned char> >::iterator oIter = decoded.find( nKey );
+        if( oIter == decoded.end() )
+        {
+            if( decoded.size() >= 512 )
+            {
+                decoded.clear();
+                lastKey = ~(GUIntBig) 0;
+            }
+
+            std::vector<unsigned char> &abyBits = decoded[nKey];
+            abyBits.resize( TILE_SIZE * TILE_SIZE / 8 );
+            size_t nOut = 0;
+            if( psNode->nRaw )
+                memcpy( &abyBits[0], pabyMap + psNode->nOffset, abyBits.size() );
+            else
+            if( CPLZLibInflate( pabyMap + psNode->nOffset, psNode->nSize,
+                                &abyBits[0], abyBits.size(), &nOut ) == NULL )
+            {
+                /* Corrupt tile, coast is safer as land */
+                std::fill( abyBits.begin(), abyBits.end(), 0xff );
+            }
+            oIter = decoded.find( nKey );
+        }
+        *ppabyBits = &oIter->second[0];
+    }
+
+    return COAST;
+}
+
+/* Coarsest resolution level at least as fine as the raster */
+int LandTileCache::getLevel(double dfPixelSize)
+{
+    for( size_t i = 0; i < levels.size(); i++ )
+        if( 180.0 / (1 << levels[i]) / TILE_SIZE <= dfPixelSize )
+            return levels[i];
+    return levels.back();
+}
+
+int LandTileCache::classify(double dfLat, double dfLong, int nLevel)
+{
+    double dfRes = 180.0 / (1 << nLevel) / TILE_SIZE;
+    int nXPixels = 2 * TILE_SIZE << nLevel;
+    int nYPixels = TILE_SIZE << nLevel;
+    int nPX = std::min( std::max( (int) floor( (dfLong + 180.0) / dfRes ), 0 ), nXPixels - 1 );
+    int nPY = std::min( std::max( (int) floor( (90.0 - dfLat) / dfRes ), 0 ), nYPixels - 1 );
+    int nX = nPX / TILE_SIZE, nY = nPY / TILE_SIZE;
+
+    GUIntBig nKey = key( nLevel, nX, nY );
+    if( nKey != lastKey )
+    {
+        lastClass = lookup( nLevel, nX, nY, &lastBits );
+        lastKey = nKey;
+    }
+    if( lastClass != COAST )
+        return lastClass;
+    if( lastBits == NULL )
+        return LAND;
+
+    int nBit = (nPY % TILE_SIZE) * TILE_SIZE + (nPX % TILE_SIZE);
+    return (lastBits[nBit >> 3] & (0x80 >> (nBit & 7))) ? LAND : SEA;
+}
+
+/************************************************************************/
+/*                            maskGEOTIFF()                             */
+/*                                                                      */
+/*      Same result as GDALProcess::maskGEOTIFF() on a north-up         */
+/*      lat/long raster: land pixels are set to the burn value.         */
+/************************************************************************/
+
+int LandTileCache::maskGEOTIFF(std::string outputFilename, int burnValue)
+{
+    if( pabyMap == NULL )
+        return 1;
+
+    ProcessingSession::instance()->initializeGDAL();
+
+    GDALDatasetH hDS = GDALOpen( outputFilename.c_str(), GA_Update );
+    if( hDS == NULL )
+        return 1;
+
+    double adfGeoTransform[6];
+    if( GDALGetGeoTransform( hDS, adfGeoTransform ) != CE_None
+        || adfGeoTransform[2] != 0.0 || adfGeoTransform[4] != 0.0 )
+    {
+        fprintf( stderr, "%s is not a north-up lat/long raster, cannot use the land mask cache.\n",
+                 outputFilename.c_str() );
+        GDALClose( hDS );
+        return 1;
+    }
+
+    int nLevel = getLevel( std::min( fabs( adfGeoTransform[1] ), fabs( adfGeoTransform[5] ) ) );
+    int nXSize = GDALGetRasterXSize( hDS );
+    int nYSize = GDALGetRasterYSize( hDS );
+    GDALRasterBandH hBand = GDALGetRasterBand( hDS, 1 );
+    std::vector<GByte> abyLine( nXSize );
+    CPLErr eErr = CE_None;
+
+    for( int j = 0; j < nYSize && eErr == CE_None; j++ )
+    {
+        double dfLat = adfGeoTransform[3] + (j + 0.5) * adfGeoTransform[5];
+        bool bChanged = false;
+
+        eErr = GDALRasterIO( hBand, GF_Read, 0, j, nXSize, 1, &abyLine[0], nXSize, 1, GDT_Byte, 0, 0 );
+        for( int i = 0; i < nXSize && eErr == CE_None; i++ )
+        {
+            double dfLong = adfGeoTransform[0] + (i + 0.5) * adfGeoTransform[1];
+            if( abyLine[i] != burnValue && classify( dfLat, dfLong, nLevel ) == LAND )
+            {
+                abyLine[i] = (GByte) burnValue;
+                bChanged = true;
+            }
+        }
+        if( bChanged && eErr == CE_None )
+            eErr = GDALRasterIO( hBand, GF_Write, 0, j, nXSize, 1, &abyLine[0], nXSize, 1, GDT_Byte, 0, 0 );
+    }
+
+    GDALClose( hDS );
+    return eErr == CE_None ? 0 : 1;
+}
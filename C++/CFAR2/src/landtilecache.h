@@ -0,0 +1,106 @@
+/** 
+ *
+ * CFAR2 ship detection pipeline
+ * Persistent pre-rasterised land mask tile cache
+ *
+**/
+
+#ifndef LANDTILECACHE_H
+#define LANDTILECACHE_H
+
+#include "gdal.h"
+#include "cpl_conv.h"
+#include "cpl_vsi.h"
+
+#include "landmask.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+/// Pre-rasterised land mask shared by every scene.  The coastline is cut
+/// into a quadtree of EPSG:4326 tiles (level z has 2^(z+1) x 2^z tiles of
+/// 180/2^z degrees); land and sea nodes stop the descent, coastal nodes at
+/// the resolution levels carry a bit-packed, deflated 256x256 mask.  The
+/// cache file is memory-mapped, so masking a scene is a tile lookup per
+/// pixel instead of a rasterisation of the shapefile.
+class LandTileCache
+{
+
+public:
+enum { SEA = 0, LAND = 1, COAST = 2 };
+enum { TILE_SIZE = 256 };
+
+LandTileCache();
+
+int open(std::string cacheDirectory, std::string inputFilenameSHP, LandMask &landMask);
+void close();
+std::string getFilename(void){return filename;};
+std::string getSourceFilename(void){return source;};
+int getRebuiltCount(void){return rebuiltCount;};
+int getNodeCount(void){return nodeCount;};
+
+int getLevel(double dfPixelSize);
+int classify(double dfLat, double dfLong, int nLevel);
+int maskGEOTIFF(std::string outputFilename, int burnValue);
+
+static GUIntBig checksum(std::string inputFilename);
+
+virtual ~LandTileCache();
+
+private:
+  struct Feature
+  {
+    GUIntBig nHash;
+    double dfMinX, dfMinY, dfMaxX, dfMaxY;
+  };
+  struct Node
+  {
+    GUInt32 nLevel, nClass, nX, nY;
+    GUIntBig nOffset;			// Deflated mask in the cache file, 0 if none
+    GUInt32 nSize, nRaw;			// nRaw = 1 if deflate failed
+  };
+
+  int map(std::string cacheFilename);
+  void unmap();
+  int build(std::string cacheFilename, GUIntBig nSourceChecksum,
+	    LandMask &landMask, const std::vector<Feature> &features);
+  void buildNode(int nLevel, int nX, int nY,
+		 const std::vector<const geos::geom::Geometry*> &apoParent,
+		 const geos::geom::GeometryFactory *factory, VSILFILE *fp);
+  void copyNode(int nLevel, int nX, int nY, VSILFILE *fp);
+  void writeNode(const Node &node, const unsigned char *pabyData, VSILFILE *fp);
+  bool isDirty(double dfMinX, double dfMinY, double dfMaxX, double dfMaxY);
+  bool isResolutionLevel(int nLevel);
+  const Node *findNode(int nLevel, int nX, int nY);
+  int lookup(int nLevel, int nX, int nY, const unsigned char **ppabyBits);
+
+  static GUIntBig key(int nLevel, int nX, int nY)
+    { return ((GUIntBig) nLevel << 58) | ((GUIntBig) nX << 29) | (GUIntBig) nY; }
+
+  std::string filename;
+  std::string source;
+  std::vector<int> levels;			// Resolution levels, finest last
+  int rebuiltCount;
+  int nodeCount;
+
+  /* Memory-mapped cache file */
+  unsigned char *pabyMap;
+  size_t nMapSize;
+  std::map<GUIntBig, const Node*> index;
+  const Feature *pasFeatures;
+  int featureCount;
+
+  /* Build state */
+  std::vector<Node> newNodes;
+  std::vector<Feature> dirty;
+  bool fullBuild;
+
+  /* Decoded coastal tiles */
+  std::map<GUIntBig, std::vector<unsigned char> > decoded;
+  GUIntBig lastKey;				// Tile of the previous classify()
+  int lastClass;
+  const unsigned char *lastBits;
+};
+
+#endif // LANDTILECACHE_H
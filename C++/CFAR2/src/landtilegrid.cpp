@@ -0,0 +1,300 @@
+/** 
+ *
+ * CFAR2 ship detection pipeline
+ * Land/sea/mixed grid of a scene in image space
+ *
+**/
+
+#include "landtilegrid.h"
+
+#include <geos/geom/Coordinate.h>
+#include <geos/geom/CoordinateSequence.h>
+#include <geos/geom/CoordinateSequenceFactory.h>
+#include <geos/geom/Envelope.h>
+#include <geos/geom/LinearRing.h>
+#include <geos/geom/Polygon.h>
+#include <geos/geom/prep/PreparedGeometryFactory.h>
+#include <geos/util/GEOSException.h>
+
+#include <algorithm>
+
+/* Image space rectangle (pixel/line corners) as a lat/long polygon */
+static geos::geom::Geometry *createGeoPolygon(TiePointGeocoder &geocoder,
+                                              const geos::geom::GeometryFactory *factory,
+                                              const std::vector<double> &adfPixel,
+                                              const std::vector<double> &adfLine)
+{
+    std::vector<geos::geom::Coordinate> *paoCoords = new std::vector<geos::geom::Coordinate>();
+
+    for( size_t i = 0; i < adfPixel.size(); i++ )
+    {
+        double dfLat, dfLong;
+        if( geocoder.pixelToLatLong( adfPixel[i], adfLine[i], dfLat, dfLong ) )
+            paoCoords->push_back( geos::geom::Coordinate( dfLong, dfLat ) );
+    }
+    if( paoCoords->size() < 3 )
+    {
+        delete paoCoords;
+        return NULL;
+    }
+    paoCoords->push_back( (*paoCoords)[0] );
+
+    geos::geom::CoordinateSequence *poSeq =
+        factory->getCoordinateSequenceFactory()->create( paoCoords, 2 );
+    return factory->createPolygon( factory->createLinearRing( poSeq ), NULL );
+}
+
+LandTileGrid::LandTileGrid()
+  : cellSize(0), gridWidth(0), gridHeight(0)
+{
+}
+
+LandTileGrid::~LandTileGrid()
+{
+}
+
+/************************************************************************/
+/*                               build()                                */
+/*                                                                      */
+/*      1. Scene footprint: the image border, sampled every cell,       */
+/*         through the tie point geocoder.                              */
+/*      2. Land polygons from the LandMask STRtree that meet the        */
+/*         footprint envelope, intersected with the footprint.          */
+/*      3. Each cell's lat/long quadrilateral is classified against     */
+/*         the clipped land with prepared covers()/intersects().        */
+/*      4. The clipped rings are kept in pixel/line for the per-pixel   */
+/*         mask of mixed cells.                                         */
+/************************************************************************/
+
+int LandTileGrid::build(TiePointGeocoder &geocoder, LandMask &landMask, int nCellSize)
+{
+    const geos::geom::GeometryFactory *factory = landMask.getFactory();
+    int nXSize = geocoder.getRasterXSize();
+    int nYSize = geocoder.getRasterYSize();
+    int i, x, y;
+
+    cells.clear();
+    rings.clear();
+    ringBounds.clear();
+
+    if( nXSize <= 0 || nYSize <= 0 || nCellSize <= 0 )
+        return 1;
+
+    cellSize = nCellSize;
+    gridWidth = (nXSize + cellSize - 1) / cellSize;
+    gridHeight = (nYSize + cellSize - 1) / cellSize;
+    cells.assign( gridWidth * gridHeight, SEA );
+
+/* -------------------------------------------------------------------- */
+/*      Scene footprint.                                                */
+/* -------------------------------------------------------------------- */
+    std::vector<double> adfPixel, adfLine;
+    for( x = 0; x < nXSize; x += cellSize )
+        { adfPixel.push_back( x ); adfLine.push_back( 0 ); }
+    for( y = 0; y < nYSize; y += cellSize )
+        { adfPixel.push_back( nXSize ); adfLine.push_back( y ); }
+    for( x = nXSize; x > 0; x -= cellSize )
+        { adfPixel.push_back( x ); adfLine.push_back( nYSize ); }
+    for( y = nYSize; y > 0; y -= cellSize )
+        { adfPixel.push_back( 0 ); adfLine.push_back( y ); }
+
+    geos::geom::Geometry *poFootprint = createGeoPolygon( geocoder, factory, adfPixel, adfLine );
+    if( poFootprint == NULL )
+        return 1;
+
+/* -------------------------------------------------------------------- */
+/*      Clip the land to the footprint.                                 */
+/* -------------------------------------------------------------------- */
+    std::vector<const geos::geom::Geometry*> apoCandidates;
+    std::vector<geos::geom::Geometry*> apoClipped;
+    landMask.queryPolygons( poFootprint->getEnvelopeInternal(), apoCandidates );
+
+    for( i = 0; i < (int) apoCandidates.size(); i++ )
+    {
+        try
+        {
+            geos::geom::Geometry *poClipped = apoCandidates[i]->intersection( poFootprint );
+            if( poClipped->isEmpty() )
+                factory->destroyGeometry( poClipped );
+            else
+                apoClipped.push_back( poClipped );
+        }
+        catch( const geos::util::GEOSException &e )
+        {
+            /* Invalid coastline polygon, keep it whole */
+            apoClipped.push_back( apoCandidates[i]->clone() );
+        }
+    }
+    factory->destroyGeometry( poFootprint );
+
+/* -------------------------------------------------------------------- */
+/*      Classify the cells.                                             */
+/* -------------------------------------------------------------------- */
+    std::vector<const geos::geom::prep::PreparedGeometry*> apoPrepared;
+    geos::index::strtree::STRtree oTree;
+    for( i = 0; i < (int) apoClipped.size(); i++ )
+    {
+        apoPrepared.push_back( geos::geom::prep::PreparedGeometryFactory::prepare( apoClipped[i] ) );
+        oTree.insert( apoClipped[i]->getEnvelopeInternal(), (void *) (size_t) i );
+    }
+
+    for( y = 0; y < gridHeight && !apoClipped.empty(); y++ )
+    {
+        for( x = 0; x < gridWidth; x++ )
+        {
+            double dfX0 = x * cellSize, dfY0 = y * cellSize;
+            double dfX1 = std::min( (x+1) * cellSize, nXSize ), dfY1 = std::min( (y+1) * cellSize, nYSize );
+            double adfCellPixel[4] = { dfX0, dfX1, dfX1, dfX0 };
+            double adfCellLine[4] = { dfY0, dfY0, dfY1, dfY1 };
+
+            geos::geom::Geometry *poCell = createGeoPolygon( geocoder, factory,
+                std::vector<double>( adfCellPixel, adfCellPixel + 4 ),
+                std::vector<double>( adfCellLine, adfCellLine + 4 ) );
+            if( poCell == NULL )
+            {
+                cells[y*gridWidth + x] = MIXED;
+                continue;
+            }
+
+            std::vector<void*> apHits;
+            oTree.query( poCell->getEnvelopeInternal(), apHits );
+
+            unsigned char nClass = SEA;
+            for( size_t j = 0; j < apHits.size() && nClass != LAND; j++ )
+            {
+                const geos::geom::prep::PreparedGeometry *poLand = apoPrepared[(size_t) apHits[j]];
+                if( poLand->covers( poCell ) )
+                    nClass = LAND;
+                else if( poLand->intersects( poCell ) )
+                    nClass = MIXED;
+            }
+            cells[y*gridWidth + x] = nClass;
+
+            factory->destroyGeometry( poCell );
+        }
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Pixel space rings for the mixed cells, then drop the GEOS       */
+/*      objects.                                                        */
+/* -------------------------------------------------------------------- */
+    for( i = 0; i < (int) apoClipped.size(); i++ )
+    {
+        addRings( apoClipped[i], geocoder );
+        geos::geom::prep::PreparedGeometryFactory::destroy( apoPrepared[i] );
+        factory->destroyGeometry( apoClipped[i] );
+    }
+
+    return 0;
+}
+
+/* Exterior and interior rings of every polygon in poGeom, in pixel/line */
+void LandTileGrid::addRings(const geos::geom::Geometry *poGeom, TiePointGeocoder &geocoder)
+{
+    for( size_t iGeom = 0; iGeom < poGeom->getNumGeometries(); iGeom++ )
+    {
+        const geos::geom::Polygon *poPolygon =
+            dynamic_cast<const geos::geom::Polygon*>( poGeom->getGeometryN( iGeom ) );
+        if( poPolygon == NULL )
+            continue;
+
+        for( int iRing = -1; iRing < (int) poPolygon->getNumInteriorRing(); iRing++ )
+        {
+            const geos::geom::LineString *poRing = (iRing < 0) ? poPolygon->getExteriorRing()
+                                                               : poPolygon->getInteriorRingN( iRing );
+            const geos::geom::CoordinateSequence *poSeq = poRing->getCoordinatesRO();
+            std::vector<cv::Point> ring;
+
+            for( size_t i = 0; i < poSeq->getSize(); i++ )
+            {
+                const geos::geom::Coordinate &oCoord = poSeq->getAt( i );
+                double dfPixel, dfLine;
+                if( geocoder.latLongToPixel( oCoord.y, oCoord.x, dfPixel, dfLine ) )
+                    ring.push_back( cv::Point( cvRound( dfPixel ), cvRound( dfLine ) ) );
+            }
+
+            if( ring.size() >= 3 )
+            {
+                rings.push_back( ring );
+                ringBounds.push_back( cv::boundingRect( ring ) );
+            }
+        }
+    }
+}
+
+int LandTileGrid::getCellCount(int nClass)
+{
+    return std::count( cells.begin(), cells.end(), (unsigned char) nClass );
+}
+
+/************************************************************************/
+/*                              classify()                              */
+/*                                                                      */
+/*      Class of an inclusive pixel rectangle: LAND or SEA if every     */
+/*      cell it touches is, MIXED otherwise.  Unbuilt grids are SEA.    */
+/************************************************************************/
+
+int LandTileGrid::classify(int nX0, int nY0, int nX1, int nY1)
+{
+    if( cells.empty() )
+        return SEA;
+
+    int nCX0 = std::max( nX0 / cellSize, 0 ), nCY0 = std::max( nY0 / cellSize, 0 );
+    int nCX1 = std::min( nX1 / cellSize, gridWidth - 1 ), nCY1 = std::min( nY1 / cellSize, gridHeight - 1 );
+    if( nCX0 > nCX1 || nCY0 > nCY1 )
+        return SEA;
+
+    int nClass = cells[nCY0*gridWidth + nCX0];
+    for( int y = nCY0; y <= nCY1 && nClass != MIXED; y++ )
+        for( int x = nCX0; x <= nCX1; x++ )
+            if( cells[y*gridWidth + x] != nClass )
+            {
+                nClass = MIXED;
+                break;
+            }
+
+    return nClass;
+}
+
+/************************************************************************/
+/*                              getMask()                               */
+/*                                                                      */
+/*      255 on land, 0 on sea, for a window of the scene.               */
+/************************************************************************/
+
+void LandTileGrid::getMask(int nX0, int nY0, int nWidth, int nHeight, cv::Mat &mask)
+{
+    cv::Rect window( nX0, nY0, nWidth, nHeight );
+    std::vector<const cv::Point*> apoRings;
+    std::vector<int> anPoints;
+
+    mask = cv::Mat( nHeight, nWidth, CV_8UC1, cv::Scalar::all(0) );
+
+    for( size_t i = 0; i < rings.size(); i++ )
+    {
+        if( (ringBounds[i] & window).area() == 0 )
+            continue;
+        apoRings.push_back( &rings[i][0] );
+        anPoints.push_back( rings[i].size() );
+    }
+
+    /* All rings in one call so the interior rings punch holes */
+    if( !apoRings.empty() )
+        cv::fillPoly( mask, &apoRings[0], &anPoints[0], apoRings.size(),
+                      cv::Scalar::all(255), 8, 0, cv::Point( -nX0, -nY0 ) );
+}
+
+/************************************************************************/
+/*                             applyMask()                              */
+/*                                                                      */
+/*      Zeroes the land pixels of a contiguous 8-bit tile buffer.       */
+/************************************************************************/
+
+void LandTileGrid::applyMask(unsigned char *pabyBuf, int nX0, int nY0, int nWidth, int nHeight)
+{
+    cv::Mat mask;
+    getMask( nX0, nY0, nWidth, nHeight, mask );
+
+    cv::Mat tile( nHeight, nWidth, CV_8UC1, pabyBuf );
+    tile.setTo( cv::Scalar::all(0), mask );
+}
@@ -0,0 +1,52 @@
+/** 
+ *
+ * CFAR2 ship detection pipeline
+ * Land/sea/mixed grid of a scene in image space
+ *
+**/
+
+#ifndef LANDTILEGRID_H
+#define LANDTILEGRID_H
+
+#include "opencv/cv.h"
+
+#include "tiepointgeocoder.h"
+#include "landmask.h"
+
+#include <vector>
+
+/// Coarse land/sea/mixed classification of a scene in image space, from the
+/// land polygons clipped to the scene footprint.  Detectors skip land cells
+/// and only need the per-pixel mask (the clipped coastline rasterised in
+/// pixel/line) on mixed cells.
+class LandTileGrid
+{
+
+public:
+enum { SEA = 0, LAND = 1, MIXED = 2 };
+
+LandTileGrid();
+
+int build(TiePointGeocoder &geocoder, LandMask &landMask, int nCellSize = 256);
+
+int getCellSize(void){return cellSize;};
+int getCellCount(int nClass);
+int classify(int nX0, int nY0, int nX1, int nY1);
+void getMask(int nX0, int nY0, int nWidth, int nHeight, cv::Mat &mask);
+void applyMask(unsigned char *pabyBuf, int nX0, int nY0, int nWidth, int nHeight);
+
+virtual ~LandTileGrid();
+
+private:
+  void addRings(const geos::geom::Geometry *poGeom, TiePointGeocoder &geocoder);
+
+  int cellSize;
+  int gridWidth;
+  int gridHeight;
+  std::vector<unsigned char> cells;		// SEA, LAND or MIXED, row major
+
+  std::vector< std::vector<cv::Point> > rings;	// Clipped land rings in pixel/line
+  std::vector<cv::Rect> ringBounds;
+};
+
+#endif // LANDTILEGRID_H
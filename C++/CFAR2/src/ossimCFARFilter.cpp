@@ -29,17 +29,22 @@
 #include <ossim/base/ossimNumericProperty.h>
 
 #include "ossimCFARFilter.h"
+#include "pipelinemetrics.h"
+#include "tracerecorder.h"
+#include "ossimTileBufferPool.h"
 
 RTTI_DEF1(ossimCFARFilter, "ossimCFARFilter", ossimImageSourceFilter)
 
 ossimCFARFilter::ossimCFARFilter(ossimObject* owner)
-   :ossimImageSourceFilter(owner)
+   :ossimImageSourceFilter(owner),
+     landGrid(NULL)
 {
 }
 
 ossimCFARFilter::ossimCFARFilter(ossimImageSource* inputSource)
    : ossimImageSourceFilter(NULL, inputSource),
-     outputTile(NULL)
+     outputTile(NULL),
+     landGrid(NULL)
 {
 }
 
@@ -58,10 +63,30 @@ ossimRefPtr<ossimImageData> ossimCFARFilter::getTile(const ossimIrect& tileRect,
    
    	if(!outputTile.valid()) initialize();
 	if(!outputTile.valid()) return 0;
+	
+	MetricsTimer timer("tile");
+	TraceSpan span("CFAR getTile", "filter", tileRect.ul().x, tileRect.ul().y);
+	PipelineMetrics::addCount("tiles", 1);
   
+	int landClass = LandTileGrid::SEA;
+	if(landGrid)
+	{
+		landClass = landGrid->classify(tileRect.ul().x, tileRect.ul().y, tileRect.lr().x, tileRect.lr().y);
+		if(landClass == LandTileGrid::LAND)
+		{
+			PipelineMetrics::addCount("tiles_land", 1);
+			outputTile->setImageRectangle(tileRect);
+			outputTile->setOrigin(tileRect.ul());
+			outputTile->makeBlank();
+			return outputTile;
+		}
+	}
+
 	ossimRefPtr<ossimImageData> data = 0;
 	if(theInputConnection)
 	{
+		MetricsTimer readTimer("read");
+		TraceSpan readSpan("tile read", "io", tileRect.ul().x, tileRect.ul().y);
 		data  = theInputConnection->getTile(tileRect, resLevel);
    	} else {
 	      return 0;
@@ -77,11 +102,21 @@ ossimRefPtr<ossimImageData> ossimCFARFilter::getTile(const ossimIrect& tileRect,
 	outputTile->makeBlank();
    
 	outputTile->setOrigin(tileRect.ul());
-	runUcharTransformation(data.get());
+	{
+		MetricsTimer detectorTimer("detector");
+		TraceSpan kernelSpan("CFAR kernel", "kernel", tileRect.ul().x, tileRect.ul().y);
+		runUcharTransformation(data.get());
+	}
+	PipelineMetrics::addCount("pixels", (double)tileRect.width()*tileRect.height());
+	PipelineMetrics::addCount("bytes_read", data->getSizeInBytes());
+	if(landClass == LandTileGrid::MIXED)
+	{
+		for(ossim_uint32 k = 0; k < outputTile->getNumberOfBands(); ++k)
+			landGrid->applyMask((uchar*)outputTile->getBuf(k), tileRect.ul().x, tileRect.ul().y,
+			                    outputTile->getWidth(), outputTile->getHeight());
+		outputTile->validate();
+	}
    
-	if(tileRect.ul().x % 1024 == 0 && tileRect.ul().y % 1024 == 0)
-       	 std::cout << "Processing tile: (" << tileRect.ul().x << "," << tileRect.ul().y << ")" << std::endl; 
-   	
 	return outputTile;
    
 }
@@ -150,20 +185,19 @@ void ossimCFARFilter::runUcharTransformation(ossimImageData* tile) {
 	// Run through each channel, get input image, process it then save it to output image
 	for(int k=0; k<nChannels; k++) 
 	{
-	  	// Grab input tile and create shallow OpenCV image (no deep copying)
-		ossim_uint16 *inBuf = (ossim_uint16*)tile->getBuf(k);
-		cv::Mat inputTile(tile->getHeight(), tile->getWidth(), CV_16UC1, (ossim_uint16*)inBuf);
+		// Scale input values by scaleValue into 8 bit through the shared lookup table
+		if(!radiometry.isValid()) radiometry.buildLinear(scaleValue);
+		ossimTileScratch inputClone(tile->getHeight(), tile->getWidth(), CV_8UC1);
+		ossimTileScratch inputTile(tile->getHeight(), tile->getWidth(), CV_8UC1);
 		
-		// Scale input values by some factor (scaleValue)
-		cv::divide(inputTile,cv::Scalar::all(scaleValue),inputTile);
-
-		// Convert input into 8 bit, unsigned single channel
-		inputTile.convertTo(inputTile,CV_8UC1);
+		// 8-bit input tiles are copied into the scratch buffer, so keep the upstream buffer untouched
+		if(tile->getScalarType() == OSSIM_UCHAR)
+		  cv::Mat(tile->getHeight(), tile->getWidth(), CV_8UC1, tile->getBuf(k)).copyTo(inputClone.mat);
+		else
+		  radiometry.toUchar(tile, k, inputClone.mat);
 		
 		// Threshold image using CFAR
-		cv::Mat inputClone;
-		inputClone = inputTile.clone();
-		simpleCFAR(inputClone, inputTile);
+		simpleCFAR(inputClone.mat, inputTile.mat);
 
 		uchar *outBuf = (uchar*)outputTile->getBuf(k);
 		cv::Mat outputTile(tile->getHeight(), tile->getWidth(), CV_8UC1, (unsigned char *)outBuf);
@@ -173,7 +207,7 @@ void ossimCFARFilter::runUcharTransformation(ossimImageData* tile) {
 		{
 		  for (unsigned int j = 0; j < tile->getHeight(); j++)
 		  {
-			outputTile.at<uchar>(j,i) = (uchar)(inputTile.at<uchar>(j,i));
+			outputTile.at<uchar>(j,i) = (uchar)(inputTile.mat.at<uchar>(j,i));
 		  }
 		}
 		
@@ -184,50 +218,49 @@ void ossimCFARFilter::runUcharTransformation(ossimImageData* tile) {
 
 void ossimCFARFilter::simpleCFAR(cv::Mat& inputImage, cv::Mat& outputImage)
 {
-  cv::Mat outputImageFinal;
-   
-  outputImage.create(inputImage.rows,inputImage.cols, inputImage.type());
-  outputImage.setTo(cv::Scalar::zeros());
-  outputImageFinal.create(inputImage.rows,inputImage.cols, inputImage.type());
-  outputImageFinal.setTo(cv::Scalar::zeros());
-  
   int borderSize = 100, pixel = 255;
     
   int top = borderSize, left = borderSize, bottom = borderSize, right = borderSize;
-  std::vector<int> neighbours;
+  
+  /// Bordered working images come from the thread's buffer pool
+  ossimTileScratch borderScratch(inputImage.rows + top + bottom, inputImage.cols + left + right, inputImage.type());
+  ossimTileScratch finalScratch(inputImage.rows + top + bottom, inputImage.cols + left + right, inputImage.type());
+  cv::Mat& borderImage = borderScratch.mat;
+  cv::Mat& outputImageFinal = finalScratch.mat;
   
   /// Add border (zeros) for actual image border processing
-  cv::copyMakeBorder(inputImage, outputImage, top, bottom, left, right, cv::BORDER_CONSTANT, cv::Scalar::all(0));
-  outputImage.copyTo(outputImageFinal);
+  cv::copyMakeBorder(inputImage, borderImage, top, bottom, left, right, cv::BORDER_CONSTANT, cv::Scalar::all(0));
+  borderImage.copyTo(outputImageFinal);
   
   if(cfarMethod == 0)
   {
+    /// The guard window is the same for every pixel, build it (and the mask buffer) once per tile
+    ossimTileScratch guardScratch(neighbourSize, neighbourSize, CV_8UC1);
+    ossimTileScratch maskScratch(neighbourSize, neighbourSize, CV_8UC1);
+    cv::Mat& guardBinaryImage = guardScratch.mat;
+    cv::Mat& mask = maskScratch.mat;
+    
+    // Switch on all non-guard pixels (1) and the guard area must be off (0).
+    guardBinaryImage.setTo(cv::Scalar::all(1));
+    cv::Mat guardPixels = guardBinaryImage(cv::Rect(guardBinaryImage.rows/2 - guardSize/2, guardBinaryImage.cols/2 - guardSize/2, guardSize, guardSize));
+    guardPixels.setTo(cv::Scalar::all(0));
+    
     /// Run through buffer while simulaneously filling the OpenCV matrix/image (raster).
-    for (int i = borderSize; i < outputImage.rows - borderSize; i++)  
+    for (int i = borderSize; i < borderImage.rows - borderSize; i++)  
     {
-	    for (int j = borderSize; j < outputImage.cols - borderSize; j++)
+	    for (int j = borderSize; j < borderImage.cols - borderSize; j++)
 	    {	
 		    // Centre pixel
-		    pixel = outputImage.at<uint8_t>(i,j);
+		    pixel = borderImage.at<uint8_t>(i,j);
 		    
 		    if(pixel != 0)
 		    { 
-		      // Get guard and neighbour rectangles  cout 
-		      // Make a copy of sub-image ('normal').
+		      // Neighbour rectangle, a view of the bordered image (no copy).
 		      // Binary image must be the same size to multiply.
 		      cv::Rect rect = cv::Rect(j - neighbourSize/2, i - neighbourSize/2, neighbourSize, neighbourSize);
-		      cv::Mat nImage = outputImage(rect).clone();
-		      cv::Mat guardBinaryImage = outputImage(rect).clone();
-		      
-		      // Switch on all non-guard pixels (1) and the guard area must be off (0).
-		      guardBinaryImage.setTo(cv::Scalar::all(1));
-		      rect = cv::Rect(guardBinaryImage.rows/2 - guardSize/2, guardBinaryImage.cols/2 - guardSize/2, guardSize, guardSize);
-		      cv::Mat guardPixels = guardBinaryImage(rect);
-		      guardPixels.setTo(cv::Scalar::all(0));
+		      cv::Mat nImage = borderImage(rect);
 
 		      // Multiply the original image by the binary gaurd image to get the 'mask' of processable pixel value (valid neighbours). 
-		      cv::Mat mask;
-		      mask = guardBinaryImage.clone();
 		      cv::multiply(nImage,guardBinaryImage,mask);
 		      
 		      // Use OpenCV + mask to find only valid neighbours mean pixel value	  
@@ -250,14 +283,14 @@ void ossimCFARFilter::simpleCFAR(cv::Mat& inputImage, cv::Mat& outputImage)
   else
   {
     /// Run through buffer while simulaneously filling the OpenCV matrix/image (raster).
-    for (int i = borderSize; i < outputImage.rows - borderSize; i++)  
+    for (int i = borderSize; i < borderImage.rows - borderSize; i++)  
     {
-	    for (int j = borderSize; j < outputImage.cols - borderSize; j++)
+	    for (int j = borderSize; j < borderImage.cols - borderSize; j++)
 	    {	
 		    double sum = 0.0, avg = 0.0;
 		    
 		    // Centre pixel
-		    pixel = outputImage.at<uint8_t>(i,j);
+		    pixel = borderImage.at<uint8_t>(i,j);
 		    
 		    if(pixel != 0)
 		    { 
@@ -265,7 +298,7 @@ void ossimCFARFilter::simpleCFAR(cv::Mat& inputImage, cv::Mat& outputImage)
 		      {
 			  for(int y = -floor(neighbourSize/2); y <= floor(neighbourSize/2); y++)
 			  {
-			      sum += (int) outputImage.at<uint8_t>(i+y, j+x);
+			      sum += (int) borderImage.at<uint8_t>(i+y, j+x);
 			  }
 		      }
 
@@ -275,7 +308,7 @@ void ossimCFARFilter::simpleCFAR(cv::Mat& inputImage, cv::Mat& outputImage)
 		      {
 			  for(int y = -floor(guardSize/2); y <= floor(guardSize/2); y++)
 			  {
-			      sum -= (int) outputImage.at<uint8_t>(i+y, j+x);
+			      sum -= (int) borderImage.at<uint8_t>(i+y, j+x);
 			  }
 		      }
 
@@ -298,8 +331,8 @@ void ossimCFARFilter::simpleCFAR(cv::Mat& inputImage, cv::Mat& outputImage)
     }
   }
   /// Remove border
-  cv::Rect borderlessRect = cv::Rect(borderSize, borderSize, outputImage.cols - borderSize - borderSize, outputImage.rows - borderSize - borderSize);
-  outputImage = outputImageFinal(borderlessRect).clone();
+  cv::Rect borderlessRect = cv::Rect(borderSize, borderSize, borderImage.cols - borderSize - borderSize, borderImage.rows - borderSize - borderSize);
+  outputImageFinal(borderlessRect).copyTo(outputImage);
 }
 
 
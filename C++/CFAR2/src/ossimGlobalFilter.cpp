@@ -29,17 +29,25 @@
 #include <ossim/base/ossimNumericProperty.h>
 
 #include "ossimGlobalFilter.h"
+#include "pipelinemetrics.h"
+#include "tracerecorder.h"
 
 RTTI_DEF1(ossimGlobalFilter, "ossimGlobalFilter", ossimImageSourceFilter)
 
 ossimGlobalFilter::ossimGlobalFilter(ossimObject* owner)
-   :ossimImageSourceFilter(owner)
+   :ossimImageSourceFilter(owner),
+     inputCutoff(0),
+     cutoffValid(false),
+     landGrid(NULL)
 {
 }
 
 ossimGlobalFilter::ossimGlobalFilter(ossimImageSource* inputSource)
    : ossimImageSourceFilter(NULL, inputSource),
-     outputTile(NULL)
+     outputTile(NULL),
+     inputCutoff(0),
+     cutoffValid(false),
+     landGrid(NULL)
 {
 }
 
@@ -58,10 +66,30 @@ ossimRefPtr<ossimImageData> ossimGlobalFilter::getTile(const ossimIrect& tileRec
    
    	if(!outputTile.valid()) initialize();
 	if(!outputTile.valid()) return 0;
+	
+	MetricsTimer timer("tile");
+	TraceSpan span("Global getTile", "filter", tileRect.ul().x, tileRect.ul().y);
+	PipelineMetrics::addCount("tiles", 1);
   
+	int landClass = LandTileGrid::SEA;
+	if(landGrid)
+	{
+		landClass = landGrid->classify(tileRect.ul().x, tileRect.ul().y, tileRect.lr().x, tileRect.lr().y);
+		if(landClass == LandTileGrid::LAND)
+		{
+			PipelineMetrics::addCount("tiles_land", 1);
+			outputTile->setImageRectangle(tileRect);
+			outputTile->setOrigin(tileRect.ul());
+			outputTile->makeBlank();
+			return outputTile;
+		}
+	}
+
 	ossimRefPtr<ossimImageData> data = 0;
 	if(theInputConnection)
 	{
+		MetricsTimer readTimer("read");
+		TraceSpan readSpan("tile read", "io", tileRect.ul().x, tileRect.ul().y);
 		data  = theInputConnection->getTile(tileRect, resLevel);
    	} else {
 	      return 0;
@@ -77,7 +105,20 @@ ossimRefPtr<ossimImageData> ossimGlobalFilter::getTile(const ossimIrect& tileRec
 	outputTile->makeBlank();
    
 	outputTile->setOrigin(tileRect.ul());
-	runUcharTransformation(data.get());
+	{
+		MetricsTimer detectorTimer("detector");
+		TraceSpan kernelSpan("Global kernel", "kernel", tileRect.ul().x, tileRect.ul().y);
+		runUcharTransformation(data.get());
+	}
+	PipelineMetrics::addCount("pixels", (double)tileRect.width()*tileRect.height());
+	PipelineMetrics::addCount("bytes_read", data->getSizeInBytes());
+	if(landClass == LandTileGrid::MIXED)
+	{
+		for(ossim_uint32 k = 0; k < outputTile->getNumberOfBands(); ++k)
+			landGrid->applyMask((uchar*)outputTile->getBuf(k), tileRect.ul().x, tileRect.ul().y,
+			                    outputTile->getWidth(), outputTile->getHeight());
+		outputTile->validate();
+	}
    
    	return outputTile;
    
@@ -141,56 +182,78 @@ bool ossimGlobalFilter::loadState(const ossimKeywordlist& kwl, const char* prefi
 
 void ossimGlobalFilter::runUcharTransformation(ossimImageData* tile) {
 	
-// 	/// Get openCV image from the N1 file
-// 	/// Use whatever band the user selected
-// 	/// Current limitation is that the data type (SHORT, FLOAT, INT) isn't 
-// 	/// known in advance for all data types.
-// 	/// This program currently uses only the UINT16 (SHORT) data type for
-// 	/// ENVISAT ASAR N1 files. This may differ for other satellite data
-// 	cv::Mat inputImage, inputTempImage, outputImage;
+	// Scaling, 8-bit conversion and thresholding are folded into one compare
+	// against a cutoff in the input (uint16) domain
+	ossim_int32 cutoff = getInputCutoff();
 	
-	// Build up OpenCV image
 	int nChannels = tile->getNumberOfBands();
+	ossim_uint32 nPixels = tile->getWidth()*tile->getHeight();
 	
-// 	// Create an OpenCV C++ matrix and set its dimensions to that of the satellite image.
-// 	// N1 files have a unsigned 16 bit data type and only use one channel (for the moment)
-// 	inputImage.create(tile->getHeight(), tile->getWidth(), CV_16UC1);
-// 	inputTempImage.create(tile->getHeight(), tile->getWidth(), CV_32FC1);
-// 	outputImage.create(tile->getHeight(), tile->getWidth(), CV_16UC1);
-	
-	// Run through each channel, get input image, process it then save it to output image
+	// Run through each channel and write the mask straight into the output tile
 	for(int k=0; k<nChannels; k++) {
 	  
-		// Grab input tile and create shallow OpenCV image (no deep copying)
-		ossim_uint16 *inBuf = (ossim_uint16*)tile->getBuf(k);
-		cv::Mat inputTile(tile->getHeight(), tile->getWidth(), CV_16UC1, (ossim_uint16*)inBuf);
-		
-		// Scale input values by some factor (scaleValue)
-		cv::divide(inputTile,cv::Scalar::all(scaleValue),inputTile);
-
-		// Convert input into 8 bit, unsigned single channel
-		inputTile.convertTo(inputTile,CV_8UC1);
-		
-		// Threshold image globally
-		cv::threshold(inputTile, inputTile, thresholdValue, 255, cv::THRESH_BINARY);
-		
 		uchar *outBuf = (uchar*)outputTile->getBuf(k);
-		cv::Mat outputTile(tile->getHeight(), tile->getWidth(), CV_8UC1, (unsigned char *)outBuf);
-
-		// Write processed data to output
-		for (unsigned int i = 0; i < tile->getWidth(); i++)
+		
+		// Input already scaled to 8 bit upstream (ossimRadiometricFilter)
+		if(tile->getScalarType() == OSSIM_UCHAR)
 		{
-		  for (unsigned int j = 0; j < tile->getHeight(); j++)
-		  {
-			outputTile.at<uchar>(j,i) = (uchar)(inputTile.at<uchar>(j,i));
-		  }
+		  const uchar *inBuf = (const uchar*)tile->getBuf(k);
+		  for(ossim_uint32 i = 0; i < nPixels; i++)
+		    outBuf[i] = (inBuf[i] > thresholdValue) ? 255 : 0;
+		  continue;
 		}
 		
+		const ossim_uint16 *inBuf = (const ossim_uint16*)tile->getBuf(k);
+		thresholdToMask(inBuf, outBuf, nPixels, cutoff);
 	}
 
 	outputTile->validate(); 
 }
 
+/*! @brief Smallest input value that is marked as a detection
+ *
+ * The cutoff reproduces divide(scaleValue) + convertTo(CV_8UC1) + 
+ * threshold(thresholdValue) exactly (rounding and saturation included). It is
+ * found once per configuration by a binary search over the uint16 range.
+ * A cutoff of 65536 means nothing is marked.
+ */
+ossim_int32 ossimGlobalFilter::getInputCutoff(void)
+{
+	if(!cutoffValid)
+	{
+		ossim_int32 lo = 0, hi = 65536;
+		while(lo < hi)
+		{
+			ossim_int32 mid = (lo + hi)/2;
+			if(isAboveThreshold(mid))
+				hi = mid;
+			else
+				lo = mid + 1;
+		}
+		inputCutoff = lo;
+		cutoffValid = true;
+	}
+	return inputCutoff;
+}
+
+bool ossimGlobalFilter::isAboveThreshold(ossim_int32 inputValue) const
+{
+	// OpenCV's divide gives 0 for a zero divisor
+	int scaled = (scaleValue != 0) ? cvRound((double)inputValue/scaleValue) : 0;
+	scaled = std::min(std::max(scaled, 0), 255);
+	return scaled > thresholdValue;
+}
+
+/*! @brief 8-bit mask kernel (255 where inBuf >= cutoff, 0 elsewhere)
+ *
+ * Branch free single pass, written so the compiler can vectorise it.
+ */
+void ossimGlobalFilter::thresholdToMask(const ossim_uint16* inBuf, uchar* outBuf, ossim_uint32 nPixels, ossim_int32 cutoff)
+{
+	for(ossim_uint32 i = 0; i < nPixels; i++)
+		outBuf[i] = (inBuf[i] >= cutoff) ? 255 : 0;
+}
+
 
 void ossimGlobalFilter::setProperty(ossimRefPtr<ossimProperty> property)
 
@@ -10,6 +10,8 @@
 #include "opencv/cv.h"
 #include "opencv/highgui.h"
 
+#include "landtilegrid.h"
+
 class ossimGlobalFilter : public ossimImageSourceFilter
 {
 
@@ -39,10 +41,20 @@ public:
                           const char* prefix=0)const;
    
    int getScaleValue(void){return scaleValue;};
-   void setScaleValue(int val){scaleValue = val;};
+   void setScaleValue(int val){scaleValue = val; cutoffValid = false;};
+
+   LandTileGrid* getLandGrid(void){return landGrid;};
+   void setLandGrid(LandTileGrid* val){landGrid = val;};
 
    int getThreshold(void){return thresholdValue;};
-   void setThreshold(int val){thresholdValue = val;};
+   void setThreshold(int val){thresholdValue = val; cutoffValid = false;};
+
+   /*
+   * Fused threshold kernel: uint16 input compared against a cutoff in the
+   * input domain, 8-bit (0/255) mask out
+   */
+   static void thresholdToMask(const ossim_uint16* inBuf, uchar* outBuf, ossim_uint32 nPixels, ossim_int32 cutoff);
+   ossim_int32 getInputCutoff(void);
 
    /*!
     * Method to the load (recreate) the state of an object from a keyword
@@ -61,9 +73,13 @@ public:
 protected:
    ossimRefPtr<ossimImageData> outputTile; // Output tile Output tile
    void runUcharTransformation(ossimImageData* tile); 
+   bool isAboveThreshold(ossim_int32 inputValue) const;
 
    int scaleValue;
    int thresholdValue;
+   ossim_int32 inputCutoff;
+   bool cutoffValid;
+   LandTileGrid* landGrid; // Land/sea cells of the scene, not owned
 TYPE_DATA
 };
 
@@ -0,0 +1,271 @@
+// Copyright (C) 2010 Argongra 
+//
+// OSSIM is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License 
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+//
+// You should have received a copy of the GNU General Public License
+// along with this software. If not, write to the Free Software 
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-
+// 1307, USA.
+//
+// See the GPL in the COPYING.GPL file for more details.
+//
+//*************************************************************************
+
+#include <ossim/base/ossimRefPtr.h>
+#include <ossim/base/ossimConstants.h>
+#include <ossim/base/ossimCommon.h>
+#include <ossim/imaging/ossimU16ImageData.h>
+
+#include <EnvisatAsar/mph.h>
+#include <EnvisatAsar/sph.h>
+#include <EnvisatAsar/dsd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include "ossimN1MappedHandler.h"
+#include "tracerecorder.h"
+
+RTTI_DEF1(ossimN1MappedHandler, "ossimN1MappedHandler", ossimImageHandler)
+
+static const ossim_uint32 MDSR_HEADER_SIZE = 17;	// Zero doppler time (12), quality flag (1), line number (4)
+static const ossim_uint32 TILE_SIZE = 256;
+
+ossimN1MappedHandler::ossimN1MappedHandler()
+   :ossimImageHandler(),
+     theTile(NULL),
+     map(NULL),
+     mapSize(0),
+     mdsOffset(0),
+     recordSize(0),
+     lines(0),
+     samples(0),
+     streaming(false),
+     availableLines(0)
+{
+}
+
+ossimN1MappedHandler::~ossimN1MappedHandler()
+{
+   close();
+}
+
+/*
+ * MPH, then the SPH sized from it, then the DSDs: the MDS of a detected
+ * product is "MDS1", one record per range line of uint16 samples.
+ */
+bool ossimN1MappedHandler::readHeaders(const std::string& filename)
+{
+   std::ifstream is(filename.c_str(), std::ios::in | std::ios::binary);
+   if(!is.good()) return false;
+
+   ossimplugins::mph mphRecord;
+   is >> mphRecord;
+   if(is.fail() || mphRecord.get_product().substr(0, 4) != "ASA_") return false;
+
+   ossimplugins::sph sphRecord;
+   sphRecord.update_sph_from_mph(mphRecord);
+   is >> sphRecord;
+   if(is.fail()) return false;
+
+   // Complex (SLC) products are not what the detectors expect
+   if(sphRecord.get_sample_type().substr(0, 8) != "DETECTED") return false;
+
+   std::vector<ossimplugins::dsd> dsds = sphRecord.get_dsd_vector();
+   for(unsigned int i = 0; i < dsds.size(); i++)
+   {
+      if(dsds[i].get_ds_name().substr(0, 4) != "MDS1" || dsds[i].get_ds_size() == 0) continue;
+
+      mdsOffset = (size_t)dsds[i].get_ds_offset();
+      recordSize = dsds[i].get_dsr_size();
+      lines = dsds[i].get_num_dsr();
+      samples = (recordSize - MDSR_HEADER_SIZE) / 2;
+      productType = mphRecord.get_product();
+      return recordSize > MDSR_HEADER_SIZE && lines > 0;
+   }
+   return false;
+}
+
+bool ossimN1MappedHandler::open()
+{
+   close();
+
+   if(!readHeaders(theImageFile.c_str())) return false;
+
+   int fd = ::open(theImageFile.c_str(), O_RDONLY);
+   if(fd < 0) return false;
+
+   // A growing file is mapped to its final size, pages past the end of
+   // the file are only touched once getAvailableLines says they landed
+   size_t productSize = mdsOffset + (size_t)recordSize*lines;
+   struct stat sStat;
+   if(fstat(fd, &sStat) != 0 || (!streaming && (size_t)sStat.st_size < productSize))
+   {
+      ::close(fd);
+      return false;
+   }
+
+   mapSize = streaming ? std::max((size_t)sStat.st_size, productSize) : (size_t)sStat.st_size;
+   void* pMap = mmap(NULL, mapSize, PROT_READ, MAP_SHARED, fd, 0);
+   ::close(fd);
+   if(pMap == MAP_FAILED) return false;
+
+   // The detectors scan the records top to bottom
+   madvise(pMap, mapSize, MADV_SEQUENTIAL);
+
+   map = (unsigned char*)pMap;
+   availableLines = streaming ? 0 : lines;
+   if(streaming) getAvailableLines();
+
+   theTile = new ossimU16ImageData(this, 1, TILE_SIZE, TILE_SIZE);
+   theTile->initialize();
+
+   completeOpen();
+   return true;
+}
+
+void ossimN1MappedHandler::close()
+{
+   if(map)
+   {
+      munmap(map, mapSize);
+      map = NULL;
+      mapSize = 0;
+   }
+   theTile = NULL;
+   ossimImageHandler::close();
+}
+
+bool ossimN1MappedHandler::isOpen()const
+{
+   return map != NULL;
+}
+
+ossim_uint32 ossimN1MappedHandler::getAvailableLines()
+{
+   if(!map || !streaming || availableLines == lines) return availableLines;
+
+   struct stat sStat;
+   if(stat(theImageFile.c_str(), &sStat) == 0 && (size_t)sStat.st_size > mdsOffset)
+      availableLines = std::min((ossim_uint32)(((size_t)sStat.st_size - mdsOffset) / recordSize), lines);
+   return availableLines;
+}
+
+/*
+ * Byte swap big-endian uint16 samples four at a time in a 64 bit word
+ * (unaligned loads through memcpy, records start at odd offsets)
+ */
+void ossimN1MappedHandler::swapSamples(const unsigned char* src, ossim_uint16* dst, ossim_uint32 count)
+{
+   if(ossim::byteOrder() == OSSIM_BIG_ENDIAN)
+   {
+      memcpy(dst, src, 2*count);
+      return;
+   }
+
+   const ossim_uint64 lowBytes = 0x00FF00FF00FF00FFULL;
+   ossim_uint32 i = 0;
+   for(; i + 4 <= count; i += 4)
+   {
+      ossim_uint64 word;
+      memcpy(&word, src + 2*i, sizeof(word));
+      word = ((word & lowBytes) << 8) | ((word >> 8) & lowBytes);
+      memcpy(dst + i, &word, sizeof(word));
+   }
+   for(; i < count; i++)
+      dst[i] = (ossim_uint16)((src[2*i] << 8) | src[2*i + 1]);
+}
+
+ossimRefPtr<ossimImageData> ossimN1MappedHandler::getTile(const ossimIrect& tileRect,
+                                                          ossim_uint32 resLevel)
+{
+   if(!isOpen() || !isSourceEnabled() || resLevel != 0) return 0;
+
+   // Resizing the rectangle does not reallocate the buffer
+   bool resize = theTile->getWidth() != tileRect.width() || theTile->getHeight() != tileRect.height();
+   theTile->setImageRectangle(tileRect);
+   if(resize) theTile->initialize();
+
+   ossimIrect imageRect(0, 0, samples - 1, lines - 1);
+   if(streaming)
+   {
+      if(availableLines == 0)
+      {
+         theTile->makeBlank();
+         return theTile;
+      }
+      imageRect = ossimIrect(0, 0, samples - 1, availableLines - 1);
+   }
+   if(!tileRect.intersects(imageRect))
+   {
+      theTile->makeBlank();
+      return theTile;
+   }
+
+   // Edge tiles hang over the image, the rest of the tile stays blank
+   ossimIrect clipRect = tileRect.clipToRect(imageRect);
+   if(clipRect != tileRect) theTile->makeBlank();
+
+   TraceSpan span("N1 swap", "io", tileRect.ul().x, tileRect.ul().y);
+   ossim_uint16* buf = theTile->getUshortBuf(0);
+   ossim_uint32 tileWidth = theTile->getWidth();
+   ossim_uint32 count = clipRect.width();
+   for(ossim_int32 y = clipRect.ul().y; y <= clipRect.lr().y; y++)
+   {
+      const unsigned char* record = map + mdsOffset + (size_t)recordSize*y + MDSR_HEADER_SIZE;
+      swapSamples(record + 2*clipRect.ul().x,
+                  buf + (size_t)(y - tileRect.ul().y)*tileWidth + (clipRect.ul().x - tileRect.ul().x),
+                  count);
+   }
+
+   theTile->validate();
+   return theTile;
+}
+
+ossim_uint32 ossimN1MappedHandler::getNumberOfLines(ossim_uint32 resLevel) const
+{
+   return (resLevel == 0) ? lines : 0;
+}
+
+ossim_uint32 ossimN1MappedHandler::getNumberOfSamples(ossim_uint32 resLevel) const
+{
+   return (resLevel == 0) ? samples : 0;
+}
+
+ossim_uint32 ossimN1MappedHandler::getImageTileWidth() const
+{
+   return 0;	// Not tiled, one record per line
+}
+
+ossim_uint32 ossimN1MappedHandler::getImageTileHeight() const
+{
+   return 0;
+}
+
+ossim_uint32 ossimN1MappedHandler::getNumberOfInputBands() const
+{
+   return 1;
+}
+
+ossim_uint32 ossimN1MappedHandler::getNumberOfOutputBands() const
+{
+   return 1;
+}
+
+ossimScalarType ossimN1MappedHandler::getOutputScalarType() const
+{
+   return OSSIM_UINT16;
+}
@@ -0,0 +1,77 @@
+#ifndef ossimN1MappedHandler_HEADER
+#define ossimN1MappedHandler_HEADER
+
+#include "ossim/base/ossimString.h"
+#include "ossim/imaging/ossimImageHandler.h"
+#include "ossim/imaging/ossimImageData.h"
+
+#include <string>
+
+/*
+ * Detected ENVISAT ASAR (.N1) image handler reading the MDS straight from
+ * a memory map. The MPH/SPH/DSD records are parsed with the EnvisatAsar
+ * plugin classes to find the MDS; each tile line is then byte swapped
+ * from its big-endian record into the tile buffer, skipping the 17 byte
+ * record header (zero doppler time, quality flag, line number).
+ *
+ * In streaming mode the file may still be growing: open succeeds once the
+ * headers have landed, the whole MDS is mapped up front and only the lines
+ * already on disk (getAvailableLines) are read, the rest of a tile is blank.
+ */
+class ossimN1MappedHandler : public ossimImageHandler
+{
+
+public:
+   ossimN1MappedHandler();
+   virtual ~ossimN1MappedHandler();
+   ossimString getShortName()const
+      {
+         return ossimString("N1MappedHandler");
+      }
+
+   ossimString getLongName()const
+      {
+         return ossimString("Memory mapped ENVISAT ASAR N1 reader");
+      }
+
+   using ossimImageHandler::open;
+   virtual bool open();
+   virtual void close();
+   virtual bool isOpen()const;
+
+   virtual ossimRefPtr<ossimImageData> getTile(const ossimIrect& tileRect, ossim_uint32 resLevel=0);
+
+   virtual ossim_uint32 getNumberOfLines(ossim_uint32 resLevel = 0) const;
+   virtual ossim_uint32 getNumberOfSamples(ossim_uint32 resLevel = 0) const;
+   virtual ossim_uint32 getImageTileWidth() const;
+   virtual ossim_uint32 getImageTileHeight() const;
+   virtual ossim_uint32 getNumberOfInputBands() const;
+   virtual ossim_uint32 getNumberOfOutputBands() const;
+   virtual ossimScalarType getOutputScalarType() const;
+
+   std::string getProductType(void){return productType;};
+
+   bool getStreaming(void){return streaming;};
+   void setStreaming(bool val){streaming = val;};
+   ossim_uint32 getAvailableLines();		// Complete MDS records on disk
+
+   static void swapSamples(const unsigned char* src, ossim_uint16* dst, ossim_uint32 count);
+
+protected:
+   bool readHeaders(const std::string& filename);
+
+   ossimRefPtr<ossimImageData> theTile;
+
+   unsigned char* map;
+   size_t mapSize;
+   size_t mdsOffset;		// First MDS record
+   ossim_uint32 recordSize;	// Bytes per MDS record (line)
+   ossim_uint32 lines;
+   ossim_uint32 samples;
+   std::string productType;	// MPH product name, ASA_IMP_1P, ASA_WSM_1P, ...
+   bool streaming;
+   ossim_uint32 availableLines;
+TYPE_DATA
+};
+
+#endif
@@ -0,0 +1,303 @@
+// Copyright (C) 2010 Argongra 
+//
+// OSSIM is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License 
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+//
+// You should have received a copy of the GNU General Public License
+// along with this software. If not, write to the Free Software 
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-
+// 1307, USA.
+//
+// See the GPL in the COPYING.GPL file for more details.
+//
+//*************************************************************************
+
+#include <ossim/base/ossimRefPtr.h>
+#include <ossim/base/ossimConstants.h>
+#include <ossim/base/ossimCommon.h>
+#include <ossim/base/ossimKeywordlist.h>
+#include <ossim/imaging/ossimImageData.h>
+
+#include <OpenThreads/ScopedLock>
+#include <OpenThreads/Thread>
+
+#include <iostream>
+
+#include "opencv/cv.h"
+
+#include "ossimPrefetchFilter.h"
+#include "pipelinemetrics.h"
+#include "tracerecorder.h"
+
+RTTI_DEF1(ossimPrefetchFilter, "ossimPrefetchFilter", ossimImageSourceFilter)
+
+class ossimPrefetchThread : public OpenThreads::Thread
+{
+public:
+   ossimPrefetchThread(ossimPrefetchFilter* prefetch)
+      : filter(prefetch),
+        metrics(PipelineMetrics::current()),
+        metricsPath(PipelineMetrics::currentPath()) {}
+   virtual void run()
+   {
+      // Reads ahead count towards the metrics of the thread that started it
+      MetricsScope scope(metrics, metricsPath);
+      TraceRecorder::instance()->setThreadName("prefetch");
+      filter->runPrefetch();
+   }
+
+private:
+   ossimPrefetchFilter* filter;
+   PipelineMetrics* metrics;
+   std::string metricsPath;
+};
+
+ossimPrefetchFilter::ossimPrefetchFilter(ossimObject* owner)
+   :ossimImageSourceFilter(owner),
+     readAhead(4),
+     reading(false),
+     done(false),
+     hits(0),
+     misses(0),
+     stallSeconds(0.0),
+     readSeconds(0.0),
+     thread(NULL)
+{
+   scanArea.makeNan();
+}
+
+ossimPrefetchFilter::ossimPrefetchFilter(ossimImageSource* inputSource)
+   : ossimImageSourceFilter(NULL, inputSource),
+     readAhead(4),
+     reading(false),
+     done(false),
+     hits(0),
+     misses(0),
+     stallSeconds(0.0),
+     readSeconds(0.0),
+     thread(NULL)
+{
+   scanArea.makeNan();
+}
+
+ossimPrefetchFilter::~ossimPrefetchFilter()
+{
+   stopThread();
+}
+
+ossimRefPtr<ossimImageData> ossimPrefetchFilter::getTile(const ossimIrect& tileRect,
+                                                          ossim_uint32 resLevel)
+{
+	if(!isSourceEnabled() || readAhead <= 0 || resLevel != 0)
+	{
+	      return ossimImageSourceFilter::getTile(tileRect, resLevel);
+	}
+	if(!theInputConnection) return 0;
+
+	if(!thread)
+	{
+		bounds = getScanBounds();
+		startThread();
+	}
+
+	TileKey key(tileRect.ul().x, tileRect.ul().y);
+	ossimRefPtr<ossimImageData> data = 0;
+	double t = (double) cv::getTickCount();
+	TraceSpan span("prefetch wait", "io", tileRect.ul().x, tileRect.ul().y);
+
+	mutex.lock();
+	while(true)
+	{
+		std::map<TileKey, ossimRefPtr<ossimImageData> >::iterator it = cache.find(key);
+		if(it != cache.end() && (!it->second.valid() || it->second->getImageRectangle() == tileRect))
+		{
+			data = it->second;
+			cache.erase(it);
+			hits++;
+			break;
+		}
+
+		// Already being read ahead, wait for it rather than read it twice
+		if(reading && readingRect == tileRect)
+		{
+			condition.wait(&mutex);
+			continue;
+		}
+
+		// Not predicted (first tile, or the scan jumped): read it here
+		for(std::deque<ossimIrect>::iterator p = pending.begin(); p != pending.end(); ++p)
+		{
+			if(*p == tileRect)
+			{
+				pending.erase(p);
+				break;
+			}
+		}
+		misses++;
+		mutex.unlock();
+		data = readTile(tileRect);
+		mutex.lock();
+		break;
+	}
+	stallSeconds += ((double)cv::getTickCount() - t)/cv::getTickFrequency();
+
+	schedule(tileRect);
+	mutex.unlock();
+	condition.broadcast();
+
+	return data;
+}
+
+/*
+ * Predict the next readAhead tiles in raster scan order after tileRect,
+ * queue the ones not yet read and drop cached tiles that fell out of the
+ * window (called with the mutex held).
+ */
+void ossimPrefetchFilter::schedule(const ossimIrect& tileRect)
+{
+	std::map<TileKey, ossimRefPtr<ossimImageData> > keep;
+	pending.clear();
+
+	ossim_int32 width = tileRect.width();
+	ossim_int32 height = tileRect.height();
+	ossim_int32 x = tileRect.ul().x;
+	ossim_int32 y = tileRect.ul().y;
+	for(int i = 0; i < readAhead; i++)
+	{
+		x += width;
+		if(x > bounds.lr().x)
+		{
+			x = bounds.ul().x;
+			y += height;
+		}
+		if(y > bounds.lr().y) break;
+
+		ossimIrect next(x, y, x + width - 1, y + height - 1);
+		TileKey key(x, y);
+		std::map<TileKey, ossimRefPtr<ossimImageData> >::iterator it = cache.find(key);
+		if(it != cache.end())
+			keep.insert(*it);
+		else
+		if(!(reading && readingRect == next))
+			pending.push_back(next);
+	}
+
+	cache.swap(keep);
+}
+
+ossimRefPtr<ossimImageData> ossimPrefetchFilter::readTile(const ossimIrect& tileRect)
+{
+	double t = (double) cv::getTickCount();
+	ossimRefPtr<ossimImageData> copy = 0;
+	{
+		// Handlers hand back their own tile buffer, keep a copy per request
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(inputMutex);
+		MetricsTimer timer("prefetch");
+		TraceSpan span("prefetch read", "io", tileRect.ul().x, tileRect.ul().y);
+		ossimRefPtr<ossimImageData> data = theInputConnection->getTile(tileRect, 0);
+		if(data.valid())
+			copy = (ossimImageData*)data->dup();
+	}
+	t = ((double)cv::getTickCount() - t)/cv::getTickFrequency();
+
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex);
+	readSeconds += t;
+	return copy;
+}
+
+void ossimPrefetchFilter::runPrefetch()
+{
+	mutex.lock();
+	while(!done)
+	{
+		if(pending.empty())
+		{
+			condition.wait(&mutex);
+			continue;
+		}
+
+		ossimIrect tileRect = pending.front();
+		pending.pop_front();
+		reading = true;
+		readingRect = tileRect;
+		mutex.unlock();
+
+		ossimRefPtr<ossimImageData> data = readTile(tileRect);
+
+		mutex.lock();
+		reading = false;
+		cache[TileKey(tileRect.ul().x, tileRect.ul().y)] = data;
+		condition.broadcast();
+	}
+	mutex.unlock();
+}
+
+void ossimPrefetchFilter::startThread()
+{
+	done = false;
+	thread = new ossimPrefetchThread(this);
+	thread->start();
+}
+
+void ossimPrefetchFilter::stopThread()
+{
+	if(!thread) return;
+
+	mutex.lock();
+	done = true;
+	mutex.unlock();
+	condition.broadcast();
+
+	thread->join();
+	delete thread;
+	thread = NULL;
+}
+
+void ossimPrefetchFilter::initialize()
+{
+  ossimImageSourceFilter::initialize();
+
+  OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex);
+  cache.clear();
+  pending.clear();
+  if(theInputConnection)
+    bounds = getScanBounds();
+}
+
+ossimIrect ossimPrefetchFilter::getScanBounds()
+{
+   ossimIrect inputBounds = theInputConnection->getBoundingRect(0);
+   if(scanArea.hasNans())
+      return inputBounds;
+   return scanArea.clipToRect(inputBounds);
+}
+
+void ossimPrefetchFilter::printStatistics()
+{
+  std::cout << "Prefetch: " << hits << " hits, " << misses << " misses (" << 100.0*getHitRate()
+	    << "%), stalled " << stallSeconds << " seconds, reading " << readSeconds << " seconds" << std::endl;
+}
+
+bool ossimPrefetchFilter::saveState(ossimKeywordlist& kwl,  const char* prefix)const
+{
+   ossimImageSourceFilter::saveState(kwl, prefix);
+
+   kwl.add(prefix, "read_ahead", readAhead, true);
+
+   return true;
+}
+
+bool ossimPrefetchFilter::loadState(const ossimKeywordlist& kwl, const char* prefix)
+{
+   ossimImageSourceFilter::loadState(kwl, prefix);
+
+   const char* lookup = kwl.find(prefix, "read_ahead");
+   if(lookup) readAhead = atoi(lookup);
+
+   return true;
+}
@@ -0,0 +1,96 @@
+#ifndef ossimPrefetchFilter_HEADER
+#define ossimPrefetchFilter_HEADER
+
+#include "ossim/plugin/ossimSharedObjectBridge.h"
+#include "ossim/base/ossimString.h"
+#include "ossim/imaging/ossimImageSourceFilter.h"
+
+#include <OpenThreads/Condition>
+#include <OpenThreads/Mutex>
+
+#include <deque>
+#include <map>
+
+class ossimPrefetchThread;
+
+/*
+ * Read-ahead between the image handler and the detector: tiles are
+ * requested in the sequencer's raster scan order, so the next tiles are
+ * read on a background thread while the detector works on the current
+ * one. getTile is then served from a bounded cache of copies.
+ */
+class ossimPrefetchFilter : public ossimImageSourceFilter
+{
+
+public:
+   ossimPrefetchFilter(ossimObject* owner=NULL);
+   ossimPrefetchFilter(ossimImageSource* inputSource);
+   virtual ~ossimPrefetchFilter();
+   ossimString getShortName()const
+      {
+         return ossimString("PrefetchFilter");
+      }
+
+   ossimString getLongName()const
+      {
+         return ossimString("Read-ahead tile prefetcher");
+      }
+
+   virtual ossimRefPtr<ossimImageData> getTile(const ossimIrect& tileRect, ossim_uint32 resLevel=0);
+
+   virtual void initialize();
+
+   virtual bool saveState(ossimKeywordlist& kwl,
+                          const char* prefix=0)const;
+   virtual bool loadState(const ossimKeywordlist& kwl,
+                          const char* prefix=0);
+
+   int getReadAhead(void){return readAhead;};
+   void setReadAhead(int val){readAhead = val;};	// Tiles read ahead of the detector, 0 = pass through
+   void setScanArea(const ossimIrect& val){scanArea = val;};	// Tiles the detector reads (an AOI), default the whole input
+
+   /*
+    * Metrics: hits were read before they were asked for, misses were read
+    * on the caller's thread, stall time is the caller waiting on either
+    */
+   ossim_uint32 getHits(void){return hits;};
+   ossim_uint32 getMisses(void){return misses;};
+   double getHitRate(void){return (hits + misses) ? (double)hits/(hits + misses) : 0.0;};
+   double getStallSeconds(void){return stallSeconds;};
+   double getReadSeconds(void){return readSeconds;};
+   void printStatistics();
+
+   void runPrefetch();		// Background thread body
+
+protected:
+   typedef std::pair<ossim_int32, ossim_int32> TileKey;	// Upper left of the tile
+
+   ossimRefPtr<ossimImageData> readTile(const ossimIrect& tileRect);
+   void schedule(const ossimIrect& tileRect);
+   void startThread();
+   void stopThread();
+   ossimIrect getScanBounds();
+
+   int readAhead;
+   ossimIrect scanArea;
+   ossimIrect bounds;
+
+   std::map<TileKey, ossimRefPtr<ossimImageData> > cache;	// Read ahead, not yet served
+   std::deque<ossimIrect> pending;				// Predicted, not yet read
+   bool reading;						// Background thread has a tile out
+   ossimIrect readingRect;
+   bool done;
+
+   ossim_uint32 hits;
+   ossim_uint32 misses;
+   double stallSeconds;
+   double readSeconds;
+
+   ossimPrefetchThread* thread;
+   OpenThreads::Mutex mutex;		// Cache, queue and metrics
+   OpenThreads::Mutex inputMutex;	// The handler is not thread safe
+   OpenThreads::Condition condition;
+TYPE_DATA
+};
+
+#endif
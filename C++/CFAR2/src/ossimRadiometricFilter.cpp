@@ -0,0 +1,355 @@
+// Copyright (C) 2010 Argongra 
+//
+// OSSIM is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License 
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+//
+// You should have received a copy of the GNU General Public License
+// along with this software. If not, write to the Free Software 
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-
+// 1307, USA.
+//
+// See the GPL in the COPYING.GPL file for more details.
+//
+//*************************************************************************
+
+#include <ossim/base/ossimRefPtr.h>
+#include <ossim/imaging/ossimU8ImageData.h>
+#include <ossim/base/ossimConstants.h>
+#include <ossim/base/ossimCommon.h>
+#include <ossim/base/ossimKeywordlist.h>
+#include <ossim/base/ossimKeywordNames.h>
+#include <ossim/imaging/ossimImageSourceFactoryBase.h>
+#include <ossim/imaging/ossimImageSourceFactoryRegistry.h>
+
+#include "ossimRadiometricFilter.h"
+
+RTTI_DEF1(ossimRadiometricFilter, "ossimRadiometricFilter", ossimImageSourceFilter)
+
+ossimRadiometricFilter::ossimRadiometricFilter(ossimObject* owner)
+   :ossimImageSourceFilter(owner),
+     scalingMode(0),
+     scaleValue(35),
+     dbMin(0.0),
+     dbMax(20.0*log10(65535.0)),
+     lowPercent(1.0),
+     highPercent(99.0)
+{
+}
+
+ossimRadiometricFilter::ossimRadiometricFilter(ossimImageSource* inputSource)
+   : ossimImageSourceFilter(NULL, inputSource),
+     outputTile(NULL),
+     scalingMode(0),
+     scaleValue(35),
+     dbMin(0.0),
+     dbMax(20.0*log10(65535.0)),
+     lowPercent(1.0),
+     highPercent(99.0)
+{
+}
+
+ossimRadiometricFilter::~ossimRadiometricFilter()
+{
+}
+
+ossimRefPtr<ossimImageData> ossimRadiometricFilter::getTile(const ossimIrect& tileRect,
+                                                                ossim_uint32 resLevel)
+{
+  
+	if(!isSourceEnabled())
+   	{
+	      return ossimImageSourceFilter::getTile(tileRect, resLevel);
+	}
+   
+   	if(!outputTile.valid()) initialize();
+	if(!outputTile.valid()) return 0;
+  
+	ossimRefPtr<ossimImageData> data = 0;
+	if(theInputConnection)
+	{
+		data  = theInputConnection->getTile(tileRect, resLevel);
+   	} else {
+	      return 0;
+   	}
+
+	if(!data.valid()) return 0;
+	if(data->getDataObjectStatus() == OSSIM_NULL ||  data->getDataObjectStatus() == OSSIM_EMPTY)
+   	{
+	     return 0;
+   	}
+
+	// Table is built once per configuration
+	const ossimRadiometricLut& table = getLut();
+
+	outputTile->setImageRectangle(tileRect);
+	outputTile->setOrigin(tileRect.ul());
+	
+	// One table lookup per pixel, written straight into the output tile
+	for(ossim_uint32 k = 0; k < data->getNumberOfBands(); k++)
+	{
+		cv::Mat outputImage(data->getHeight(), data->getWidth(), CV_8UC1, outputTile->getBuf(k));
+		cv::Mat inputImage;
+		table.toUchar(data.get(), k, inputImage);
+		if(inputImage.data != outputImage.data)
+		  inputImage.copyTo(outputImage);
+	}
+	
+	outputTile->validate();
+	
+	return outputTile;
+   
+}
+
+void ossimRadiometricFilter::initialize()
+{
+  if(theInputConnection)
+  {
+      ossimImageSourceFilter::initialize();
+
+      outputTile = new ossimU8ImageData(this,
+				     theInputConnection->getNumberOfOutputBands(),   
+                                     theInputConnection->getTileWidth(),
+                                     theInputConnection->getTileHeight());  
+      outputTile->initialize();
+      
+      lut.invalidate();
+   }
+
+}
+
+ossimScalarType ossimRadiometricFilter::getOutputScalarType() const
+{
+   if(!isSourceEnabled())
+   {
+      return ossimImageSourceFilter::getOutputScalarType();
+   }
+   
+   return OSSIM_UCHAR;
+}
+
+ossim_uint32 ossimRadiometricFilter::getNumberOfOutputBands() const
+{
+   if(!isSourceEnabled())
+   {
+      return ossimImageSourceFilter::getNumberOfOutputBands();
+   }
+   return theInputConnection->getNumberOfOutputBands();
+}
+
+bool ossimRadiometricFilter::saveState(ossimKeywordlist& kwl,  const char* prefix)const
+{
+   ossimImageSourceFilter::saveState(kwl, prefix);
+
+   kwl.add(prefix, "scaling_mode", scalingMode, true);
+   kwl.add(prefix, "scale_value", scaleValue, true);
+   kwl.add(prefix, "db_min", dbMin, true);
+   kwl.add(prefix, "db_max", dbMax, true);
+   kwl.add(prefix, "low_percent", lowPercent, true);
+   kwl.add(prefix, "high_percent", highPercent, true);
+   
+   return true;
+}
+
+bool ossimRadiometricFilter::loadState(const ossimKeywordlist& kwl, const char* prefix)
+{
+   ossimImageSourceFilter::loadState(kwl, prefix);
+
+   const char* lookup = kwl.find(prefix, "scaling_mode");
+   if(lookup) scalingMode = ossimString(lookup).toInt();
+   lookup = kwl.find(prefix, "scale_value");
+   if(lookup) scaleValue = ossimString(lookup).toInt();
+   lookup = kwl.find(prefix, "db_min");
+   if(lookup) dbMin = ossimString(lookup).toDouble();
+   lookup = kwl.find(prefix, "db_max");
+   if(lookup) dbMax = ossimString(lookup).toDouble();
+   lookup = kwl.find(prefix, "low_percent");
+   if(lookup) lowPercent = ossimString(lookup).toDouble();
+   lookup = kwl.find(prefix, "high_percent");
+   if(lookup) highPercent = ossimString(lookup).toDouble();
+   
+   lut.invalidate();
+   return true;
+}
+
+/*! @brief Returns the lookup table for the current configuration, building it if needed
+ */
+const ossimRadiometricLut& ossimRadiometricFilter::getLut(void)
+{
+  if(!lut.isValid())
+  {
+    if(scalingMode == 1)
+      lut.buildLog(dbMin, dbMax);
+    else if(scalingMode == 2)
+    {
+      std::vector<double> histogram;
+      computeHistogram(histogram);
+      lut.buildPercentile(histogram, lowPercent, highPercent);
+    }
+    else
+      lut.buildLinear(scaleValue);
+  }
+  return lut;
+}
+
+/*! @brief Histogram of the raw input values for the percentile mapping
+ * 
+ * Only every 4th tile in each direction is read, which is plenty to place
+ * the percentiles of a SAR scene. Tiles that are not 16-bit (e.g. already 
+ * 8-bit) do not go through the table and are left out.
+ * 
+ * @param histogram returned 65536 bin histogram 
+ */
+void ossimRadiometricFilter::computeHistogram(std::vector<double>& histogram)
+{
+  histogram.assign(65536, 0.0);
+  if(!theInputConnection)
+    return;
+  
+  const ossim_int32 stride = 4;
+  ossimIrect bounds = theInputConnection->getBoundingRect(0);
+  ossim_int32 tileWidth = theInputConnection->getTileWidth();
+  ossim_int32 tileHeight = theInputConnection->getTileHeight();
+  
+  for(ossim_int32 y = bounds.ul().y; y <= bounds.lr().y; y += tileHeight*stride)
+  {
+    for(ossim_int32 x = bounds.ul().x; x <= bounds.lr().x; x += tileWidth*stride)
+    {
+      ossimIrect tileRect(x, y, x + tileWidth - 1, y + tileHeight - 1);
+      ossimRefPtr<ossimImageData> data = theInputConnection->getTile(tileRect, 0);
+      if(!data.valid() || data->getDataObjectStatus() == OSSIM_NULL || data->getDataObjectStatus() == OSSIM_EMPTY)
+	continue;
+      if(data->getScalarType() != OSSIM_UINT16 && data->getScalarType() != OSSIM_USHORT11)
+	continue;
+      
+      ossim_uint32 nPixels = data->getWidth()*data->getHeight();
+      for(ossim_uint32 k = 0; k < data->getNumberOfBands(); k++)
+      {
+	const ossim_uint16 *inBuf = (const ossim_uint16*)data->getBuf(k);
+	for(ossim_uint32 i = 0; i < nPixels; i++)
+	  histogram[inBuf[i]] += 1.0;
+      }
+    }
+  }
+}
+
+
+ossimRadiometricLut::ossimRadiometricLut()
+{
+}
+
+/*! @brief Linear mapping, identical to cv::divide(scaleValue) followed by convertTo(CV_8UC1)
+ */
+void ossimRadiometricLut::buildLinear(int scaleValue)
+{
+  table.resize(65536);
+  for(int v = 0; v < 65536; v++)
+  {
+    // OpenCV's divide gives 0 for a zero divisor
+    int scaled = (scaleValue != 0) ? cvRound((double)v/scaleValue) : 0;
+    table[v] = (uchar)std::min(std::max(scaled, 0), 255);
+  }
+}
+
+/*! @brief Logarithmic mapping of the amplitude in dB (20*log10) from [dbMin,dbMax] to [0,255]
+ */
+void ossimRadiometricLut::buildLog(double dbMin, double dbMax)
+{
+  table.resize(65536);
+  double range = (dbMax > dbMin) ? dbMax - dbMin : 1.0;
+  
+  table[0] = 0;
+  for(int v = 1; v < 65536; v++)
+  {
+    int scaled = cvRound(255.0*(20.0*log10((double)v) - dbMin)/range);
+    table[v] = (uchar)std::min(std::max(scaled, 0), 255);
+  }
+}
+
+/*! @brief Linear stretch between two percentiles of the histogram, clipped outside them
+ * 
+ * @param histogram 65536 bin histogram of the input values
+ * @param lowPercent values at or below this percentile map to 0
+ * @param highPercent values at or above this percentile map to 255
+ */
+void ossimRadiometricLut::buildPercentile(const std::vector<double>& histogram, double lowPercent, double highPercent)
+{
+  double total = 0;
+  for(std::vector<double>::const_iterator it = histogram.begin(); it != histogram.end(); ++it)
+    total += *it;
+
+  int lowValue = 0, highValue = 65535;
+  if(total > 0)
+  {
+    double cumulative = 0;
+    bool lowFound = false;
+    for(int v = 0; v < (int)histogram.size(); v++)
+    {
+      cumulative += histogram[v];
+      if(!lowFound && cumulative >= lowPercent/100.0*total)
+      {
+	lowValue = v;
+	lowFound = true;
+      }
+      if(cumulative >= highPercent/100.0*total)
+      {
+	highValue = v;
+	break;
+      }
+    }
+  }
+  if(highValue <= lowValue)
+    highValue = lowValue + 1;
+  
+  table.resize(65536);
+  for(int v = 0; v < 65536; v++)
+  {
+    int scaled = cvRound(255.0*(v - lowValue)/(double)(highValue - lowValue));
+    table[v] = (uchar)std::min(std::max(scaled, 0), 255);
+  }
+}
+
+/*! @brief Applies the table to a uint16 buffer
+ * 
+ * The table is 64KB so it stays cache resident, the loop is unrolled to keep
+ * several independent lookups in flight.
+ */
+void ossimRadiometricLut::apply(const ossim_uint16* inBuf, uchar* outBuf, ossim_uint32 nPixels) const
+{
+  const uchar *lookup = &table[0];
+  ossim_uint32 i = 0;
+  for(; i + 4 <= nPixels; i += 4)
+  {
+    outBuf[i]   = lookup[inBuf[i]];
+    outBuf[i+1] = lookup[inBuf[i+1]];
+    outBuf[i+2] = lookup[inBuf[i+2]];
+    outBuf[i+3] = lookup[inBuf[i+3]];
+  }
+  for(; i < nPixels; i++)
+    outBuf[i] = lookup[inBuf[i]];
+}
+
+/*! @brief 8-bit OpenCV image of one band of a tile
+ * 
+ * Tiles that are already 8-bit (e.g. from an upstream ossimRadiometricFilter)
+ * are wrapped without copying, uint16 tiles go through the table.
+ * 
+ * @param tile the input tile
+ * @param band the band to convert
+ * @param outputImage returned image (type CV_8UC1)
+ */
+void ossimRadiometricLut::toUchar(ossimImageData* tile, ossim_uint32 band, cv::Mat& outputImage) const
+{
+  if(tile->getScalarType() == OSSIM_UCHAR)
+  {
+    outputImage = cv::Mat(tile->getHeight(), tile->getWidth(), CV_8UC1, tile->getBuf(band));
+    return;
+  }
+  
+  outputImage.create(tile->getHeight(), tile->getWidth(), CV_8UC1);
+  apply((const ossim_uint16*)tile->getBuf(band), outputImage.ptr<uchar>(0), tile->getWidth()*tile->getHeight());
+}
@@ -0,0 +1,98 @@
+#ifndef ossimRadiometricFilter_HEADER
+#define ossimRadiometricFilter_HEADER
+
+#include "ossim/plugin/ossimSharedObjectBridge.h"
+#include "ossim/base/ossimString.h"
+#include "ossim/imaging/ossimImageSourceFilter.h"
+
+#include <stdlib.h>
+#include <vector>
+
+#include "opencv/cv.h"
+#include "opencv/highgui.h"
+
+/*
+ * 65536 entry uint16 -> uint8 lookup table. Every mapping (linear, log, 
+ * percentile) is built once and then costs one table lookup per pixel.
+ */
+class ossimRadiometricLut
+{
+public:
+   ossimRadiometricLut();
+   
+   void buildLinear(int scaleValue);
+   void buildLog(double dbMin, double dbMax);
+   void buildPercentile(const std::vector<double>& histogram, double lowPercent, double highPercent);
+   
+   bool isValid(void) const {return !table.empty();};
+   void invalidate(void){table.clear();};
+   
+   void apply(const ossim_uint16* inBuf, uchar* outBuf, ossim_uint32 nPixels) const;
+   void toUchar(ossimImageData* tile, ossim_uint32 band, cv::Mat& outputImage) const;
+
+protected:
+   std::vector<uchar> table;
+};
+
+class ossimRadiometricFilter : public ossimImageSourceFilter
+{
+
+public:
+   ossimRadiometricFilter(ossimObject* owner=NULL);
+   ossimRadiometricFilter(ossimImageSource* inputSource);
+   virtual ~ossimRadiometricFilter();
+   ossimString getShortName()const
+      {
+         return ossimString("RadiometricFilter");
+      }
+   
+   ossimString getLongName()const
+      {
+         return ossimString("Lookup table uint16 to uint8 conversion");
+      }
+   
+   virtual ossimRefPtr<ossimImageData> getTile(const ossimIrect& tileRect, ossim_uint32 resLevel=0);
+   
+   virtual void initialize();
+   
+   virtual ossimScalarType getOutputScalarType() const;
+   
+   ossim_uint32 getNumberOfOutputBands() const;
+ 
+   virtual bool saveState(ossimKeywordlist& kwl,
+                          const char* prefix=0)const;
+   
+   /*!
+    * Method to the load (recreate) the state of an object from a keyword
+    * list.  Return true if ok or false on error.
+    */
+   virtual bool loadState(const ossimKeywordlist& kwl,
+                          const char* prefix=0);
+
+   int getScalingMode(void){return scalingMode;};
+   void setScalingMode(int val){scalingMode = val; lut.invalidate();};
+
+   int getScaleValue(void){return scaleValue;};
+   void setScaleValue(int val){scaleValue = val; lut.invalidate();};
+
+   void setDbRange(double minVal, double maxVal){dbMin = minVal; dbMax = maxVal; lut.invalidate();};
+   void setPercentiles(double low, double high){lowPercent = low; highPercent = high; lut.invalidate();};
+
+   const ossimRadiometricLut& getLut(void);
+   void setLut(const ossimRadiometricLut& table){lut = table;};
+
+protected:
+   ossimRefPtr<ossimImageData> outputTile; // Output tile Output tile
+   void computeHistogram(std::vector<double>& histogram);
+
+   ossimRadiometricLut lut;
+   int scalingMode;		// 0 = linear (divide by scaleValue), 1 = log (dB), 2 = clipped percentile
+   int scaleValue;
+   double dbMin;
+   double dbMax;
+   double lowPercent;
+   double highPercent;
+TYPE_DATA
+};
+
+#endif
@@ -79,9 +79,6 @@ ossimRefPtr<ossimImageData> ossimSDFilter::getTile(const ossimIrect& tileRect,
 	outputTile->setOrigin(tileRect.ul());
 	runUcharTransformation(data.get());
    
-	if(tileRect.ul().x % 1024 == 0 && tileRect.ul().y % 1024 == 0)
-       	 std::cout << "Processing tile: (" << tileRect.ul().x << "," << tileRect.ul().y << ")" << std::endl; 
-   	
 	return outputTile;
    
 }
@@ -150,19 +147,15 @@ void ossimSDFilter::runUcharTransformation(ossimImageData* tile) {
 	// Run through each channel, get input image, process it then save it to output image
 	for(int k=0; k<nChannels; k++) 
 	{
-	  	// Grab input tile and create shallow OpenCV image (no deep copying)
-		ossim_uint16 *inBuf = (ossim_uint16*)tile->getBuf(k);
-		cv::Mat inputTile(tile->getHeight(), tile->getWidth(), CV_16UC1, (ossim_uint16*)inBuf);
+		// Scale input values by scaleValue into 8 bit through the shared lookup table
+		if(!radiometry.isValid()) radiometry.buildLinear(scaleValue);
+		cv::Mat inputClone, inputTile;
+		radiometry.toUchar(tile, k, inputClone);
 		
-		// Scale input values by some factor (scaleValue)
-		cv::divide(inputTile,cv::Scalar::all(scaleValue),inputTile);
-
-		// Convert input into 8 bit, unsigned single channel
-		inputTile.convertTo(inputTile,CV_8UC1);
+		// 8-bit input tiles are wrapped, not copied, so keep the upstream buffer untouched
+		if(tile->getScalarType() == OSSIM_UCHAR) inputClone = inputClone.clone();
 		
 		// Threshold image using SD
-		cv::Mat inputClone;
-		inputClone = inputTile.clone();
 		simpleSD(inputClone, inputTile);
 
 		uchar *outBuf = (uchar*)outputTile->getBuf(k);
@@ -193,6 +186,15 @@ void ossimSDFilter::simpleSD(cv::Mat& inputImage, cv::Mat& outputImage)
   else
    findBlobsMS(inputImage, blobs, blobCentres);
     
+   detectedCentres = blobCentres;
+   detectedAreas.assign(blobCentres.size(), 0);
+   detectedBounds.assign(blobCentres.size(), cv::Rect());
+   for(unsigned int i = 0; i < blobs.size() && i < blobCentres.size(); i++)
+   {
+     detectedAreas[i] = blobs[i].size();
+     detectedBounds[i] = cv::boundingRect(blobs[i]);
+   }
+   
    outputImage = cv::Mat(inputImage.rows, inputImage.cols, CV_8UC1, cv::Scalar::all(0));
    paintCentres(outputImage, blobCentres);
    
@@ -365,11 +367,11 @@ void ossimSDFilter::findBlobsCC(cv::Mat& binaryImage, vector< vector< cv::Point2
 
     cv::Mat labelImage,binaryImageTemp;
     
-    //Perform morphological closing if spacing is not zero
-    if(spacing > 0)
-     cv::morphologyEx(binaryImage, binaryImage, cv::MORPH_CLOSE, cv::getStructuringElement(cv::MORPH_RECT, cv::Size(spacing,spacing)));
-   
     binaryImage.convertTo(binaryImage, CV_8UC1);
+
+    //Perform morphological closing if spacing is not zero (only around candidate pixels)
+    if(spacing > 0)
+     closeCandidateRegions(binaryImage, spacing);
     
     //Ensure binary image is in 0 - 1 format rather than 0 - 255 format used usually used
     //when displaying an image (use a LUT)
@@ -424,6 +426,177 @@ void ossimSDFilter::findBlobsCC(cv::Mat& binaryImage, vector< vector< cv::Point2
 
 }
 
+/*! @brief Morphological closing restricted to the neighbourhood of candidate pixels
+ * 
+ * Equivalent to cv::morphologyEx(MORPH_CLOSE) with a size x size rectangular
+ * structuring element, but the van Herk/Gil-Werman running max/min is only run 
+ * inside dilated bounding boxes of the candidate regions, so the cost no longer
+ * depends on the scene size or on the structuring element size. Closing can only 
+ * switch on pixels within 'size' of an existing candidate, so every other pixel 
+ * is left untouched.
+ * 
+ * @param binaryImage the binary either (0-255) or (0-1) input image (type CV_8UC1), closed in place
+ * @param size the length of the square structuring element
+ */
+void ossimSDFilter::closeCandidateRegions(cv::Mat& binaryImage, int size)
+{
+    //A 1x1 structuring element leaves the image unchanged
+    if(size <= 1)
+      return;
+  
+    assert(binaryImage.type() == CV_8UC1);
+    
+    //Same anchor as cv::getStructuringElement so the result matches cv::morphologyEx
+    int anchor = size/2;
+    
+    //The closed value at a pixel depends on pixels up to 2*size away, so read a
+    //3*size margin around each region to get exact values within 'size' of it
+    int margin = 3*size;
+    
+    std::vector<cv::Rect> regions;
+    findCandidateRegions(binaryImage, std::max(size, 32), regions);
+    
+    cv::Mat closedImage = binaryImage.clone();
+    cv::Rect imageRect(0, 0, binaryImage.cols, binaryImage.rows);
+    
+    for(std::vector<cv::Rect>::iterator it = regions.begin(); it != regions.end(); ++it)
+    {
+      cv::Rect outerRect = cv::Rect(it->x - margin, it->y - margin, it->width + 2*margin, it->height + 2*margin) & imageRect;
+      cv::Rect innerRect = cv::Rect(it->x - size, it->y - size, it->width + 2*size, it->height + 2*size) & imageRect;
+      
+      //Dilation then erosion, each split into a row pass and a column pass
+      cv::Mat region = binaryImage(outerRect).clone(), regionT;
+      runningMaxMinRows(region, size, anchor, true);
+      cv::transpose(region, regionT);
+      runningMaxMinRows(regionT, size, anchor, true);
+      runningMaxMinRows(regionT, size, anchor, false);
+      cv::transpose(regionT, region);
+      runningMaxMinRows(region, size, anchor, false);
+      
+      //Only the inner part of the region is exact, copy it back
+      cv::Rect validRect(innerRect.x - outerRect.x, innerRect.y - outerRect.y, innerRect.width, innerRect.height);
+      cv::Mat closedRegion = closedImage(innerRect);
+      region(validRect).copyTo(closedRegion);
+    }
+    
+    binaryImage = closedImage;
+}
+
+/*! @brief Finds the bounding boxes of groups of candidate pixels
+ * 
+ * Runs of non-zero pixels are marked on a coarse grid of blockSize x blockSize
+ * blocks, then 8-connected groups of marked blocks are labelled to give the 
+ * candidate regions.
+ * 
+ * @param binaryImage the binary input image (type CV_8UC1)
+ * @param blockSize the size of each grid block in pixels
+ * @param regions returned bounding boxes (in pixels) of the candidate regions
+ */
+void ossimSDFilter::findCandidateRegions(const cv::Mat& binaryImage, int blockSize, std::vector<cv::Rect>& regions)
+{
+    regions.clear();
+    
+    int gridRows = (binaryImage.rows + blockSize - 1)/blockSize;
+    int gridCols = (binaryImage.cols + blockSize - 1)/blockSize;
+    cv::Mat grid = cv::Mat(gridRows, gridCols, CV_32SC1, cv::Scalar::all(0));
+
+    //Mark every block touched by a run of candidate pixels
+    for(int y = 0; y < binaryImage.rows; y++) {
+        const uchar *row = binaryImage.ptr<uchar>(y);
+        int *gridRow = grid.ptr<int>(y/blockSize);
+        int x = 0;
+        while(x < binaryImage.cols) {
+            if(row[x] == 0) {
+                x++;
+                continue;
+            }
+            
+            int runStart = x;
+            while(x < binaryImage.cols && row[x] != 0)
+                x++;
+    
+            for(int b = runStart/blockSize; b <= (x-1)/blockSize; b++)
+                gridRow[b] = 1;
+        }
+    }
+    
+    //Label the connected blocks (start at 2 because 0 and 1 are already used)
+    int labelCount = 2;
+    cv::Rect imageRect(0, 0, binaryImage.cols, binaryImage.rows);
+    for(int y = 0; y < grid.rows; y++) {
+        int *row = grid.ptr<int>(y);
+        for(int x = 0; x < grid.cols; x++) {
+            if(row[x] != 1) {
+                continue;
+            }
+
+            cv::Rect rect;
+            cv::floodFill(grid, cv::Point(x,y), labelCount, &rect, 0, 0, 8);
+            regions.push_back(cv::Rect(rect.x*blockSize, rect.y*blockSize, 
+                                       rect.width*blockSize, rect.height*blockSize) & imageRect);
+            labelCount++;
+        }
+    }
+}
+
+/*! @brief Running max (dilation) or min (erosion) along each row of an image
+ * 
+ * van Herk/Gil-Werman algorithm: the row is split into blocks of length 'size'
+ * and a forward and a backward running max/min are taken inside each block, so 
+ * any window of length 'size' is the max/min of two lookups (three comparisons 
+ * per pixel regardless of 'size'). Pixels outside the image do not contribute,
+ * as in OpenCV's default morphology border.
+ * 
+ * @param image the image to be processed in place (type CV_8UC1)
+ * @param size the length of the window
+ * @param anchor the position of the output pixel within the window
+ * @param isMax true for a running max (dilation), false for a running min (erosion)
+ */
+void ossimSDFilter::runningMaxMinRows(cv::Mat& image, int size, int anchor, bool isMax)
+{
+    uchar neutral = isMax ? 0 : 255;
+    
+    //Pad the row so that window [x - anchor, x + size - 1 - anchor] becomes [x, x + size - 1]
+    int paddedLength = image.cols + size - 1;
+    paddedLength = ((paddedLength + size - 1)/size)*size;
+    
+    std::vector<uchar> line(paddedLength), forward(paddedLength), backward(paddedLength);
+    
+    for(int y = 0; y < image.rows; y++) {
+        uchar *row = image.ptr<uchar>(y);
+    
+        std::fill(line.begin(), line.end(), neutral);
+        std::copy(row, row + image.cols, line.begin() + anchor);
+    
+        for(int blockStart = 0; blockStart < paddedLength; blockStart += size) {
+            int blockEnd = blockStart + size - 1;
+    
+            forward[blockStart] = line[blockStart];
+            backward[blockEnd] = line[blockEnd];
+            if(isMax) {
+                for(int i = blockStart + 1; i <= blockEnd; i++)
+                    forward[i] = std::max(forward[i-1], line[i]);
+                for(int i = blockEnd - 1; i >= blockStart; i--)
+                    backward[i] = std::max(backward[i+1], line[i]);
+            } else {
+                for(int i = blockStart + 1; i <= blockEnd; i++)
+                    forward[i] = std::min(forward[i-1], line[i]);
+                for(int i = blockEnd - 1; i >= blockStart; i--)
+                    backward[i] = std::min(backward[i+1], line[i]);
+            }
+        }
+    
+        //Each window spans the end of one block and the start of the next
+        if(isMax) {
+            for(int x = 0; x < image.cols; x++)
+                row[x] = std::max(backward[x], forward[x + size - 1]);
+        } else {
+            for(int x = 0; x < image.cols; x++)
+                row[x] = std::min(backward[x], forward[x + size - 1]);
+        }
+    }
+}
+
 /*! @brief Mean Shift (MS) and Centroid Finding Function
  * 
  * This function runs through a binary image and finds the blobs
@@ -15,6 +15,8 @@
 #include "opencv/cv.h"
 #include "opencv/highgui.h"
 
+#include "ossimRadiometricFilter.h"
+
 class ossimSDFilter : public ossimImageSourceFilter
 {
 
@@ -44,7 +46,7 @@ public:
                           const char* prefix=0)const;
    
    int getScaleValue(void){return scaleValue;};
-   void setScaleValue(int val){scaleValue = val;};
+   void setScaleValue(int val){scaleValue = val; radiometry.invalidate();};
 
    int getSpacing(void){return spacing;};
    void setSpacing(int val){spacing = val;};
@@ -62,6 +64,9 @@ public:
    void setSDType(int val){sdType = val;};
 
    void simpleSD(cv::Mat& inputImage, cv::Mat& outputImage);
+   const std::vector<cv::Point2i>& getDetectedCentres(void){return detectedCentres;};
+   const std::vector<int>& getDetectedAreas(void){return detectedAreas;};
+   const std::vector<cv::Rect>& getDetectedBounds(void){return detectedBounds;};
    
    void findBlobsCC(cv::Mat &binaryImage, 
                 std::vector < std::vector<cv::Point2i> > &blobs, 
@@ -69,6 +74,7 @@ public:
    void findBlobsMS(cv::Mat &binaryImage, 
                 std::vector < std::vector<cv::Point2i> > &blobs, 
                 std::vector<cv::Point2i> &blobCentres);
+   void closeCandidateRegions(cv::Mat &binaryImage, int size);
    
    int meanvector(std::vector<double> &x, std::vector<double> &data, int rows, int cols, double bw2, std::vector<double> &mean);
    double dist(std::vector<double> &A, std::vector<double> &B);
@@ -98,8 +104,14 @@ protected:
    void paintCentres(cv::Mat &binaryImage, std::vector<cv::Point2i> &blobCentres);
    void paintBlobs(cv::Mat &binaryImage, std::vector < std::vector<cv::Point2i> > &blobs);
    void find(const cv::Mat& binary, std::vector<cv::Point> &idx);
+   void findCandidateRegions(const cv::Mat& binaryImage, int blockSize, std::vector<cv::Rect> &regions);
+   void runningMaxMinRows(cv::Mat& image, int size, int anchor, bool isMax);
    
    int scaleValue;
+   ossimRadiometricLut radiometry;
+   std::vector<cv::Point2i> detectedCentres; // Blob centres (x = column, y = row) from the last simpleSD
+   std::vector<int> detectedAreas; // Blob pixel counts (0 for mean shift, which has no blobs)
+   std::vector<cv::Rect> detectedBounds; // Blob bounding boxes
    int sdType;
    int spacing;
    double bw;
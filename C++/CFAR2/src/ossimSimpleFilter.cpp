@@ -28,18 +28,24 @@
 #include <ossim/base/ossimRefPtr.h>
 #include <ossim/base/ossimNumericProperty.h>
 
+#include <cstring>
+
 #include "ossimSimpleFilter.h"
+#include "pipelinemetrics.h"
+#include "tracerecorder.h"
 
 RTTI_DEF1(ossimSimpleFilter, "ossimSimpleFilter", ossimImageSourceFilter)
 
 ossimSimpleFilter::ossimSimpleFilter(ossimObject* owner)
-   :ossimImageSourceFilter(owner)
+   :ossimImageSourceFilter(owner),
+     landGrid(NULL)
 {
 }
 
 ossimSimpleFilter::ossimSimpleFilter(ossimImageSource* inputSource)
    : ossimImageSourceFilter(NULL, inputSource),
-     outputTile(NULL)
+     outputTile(NULL),
+     landGrid(NULL)
 {
 }
 
@@ -58,10 +64,30 @@ ossimRefPtr<ossimImageData> ossimSimpleFilter::getTile(const ossimIrect& tileRec
    
    	if(!outputTile.valid()) initialize();
 	if(!outputTile.valid()) return 0;
+	
+	MetricsTimer timer("tile");
+	TraceSpan span("Simple getTile", "filter", tileRect.ul().x, tileRect.ul().y);
+	PipelineMetrics::addCount("tiles", 1);
   
+	int landClass = LandTileGrid::SEA;
+	if(landGrid)
+	{
+		landClass = landGrid->classify(tileRect.ul().x, tileRect.ul().y, tileRect.lr().x, tileRect.lr().y);
+		if(landClass == LandTileGrid::LAND)
+		{
+			PipelineMetrics::addCount("tiles_land", 1);
+			outputTile->setImageRectangle(tileRect);
+			outputTile->setOrigin(tileRect.ul());
+			outputTile->makeBlank();
+			return outputTile;
+		}
+	}
+
 	ossimRefPtr<ossimImageData> data = 0;
 	if(theInputConnection)
 	{
+		MetricsTimer readTimer("read");
+		TraceSpan readSpan("tile read", "io", tileRect.ul().x, tileRect.ul().y);
 		data  = theInputConnection->getTile(tileRect, resLevel);
    	} else {
 	      return 0;
@@ -77,7 +103,20 @@ ossimRefPtr<ossimImageData> ossimSimpleFilter::getTile(const ossimIrect& tileRec
 	outputTile->makeBlank();
    
 	outputTile->setOrigin(tileRect.ul());
-	runUcharTransformation(data.get());
+	{
+		MetricsTimer detectorTimer("detector");
+		TraceSpan kernelSpan("Simple kernel", "kernel", tileRect.ul().x, tileRect.ul().y);
+		runUcharTransformation(data.get());
+	}
+	PipelineMetrics::addCount("pixels", (double)tileRect.width()*tileRect.height());
+	PipelineMetrics::addCount("bytes_read", data->getSizeInBytes());
+	if(landClass == LandTileGrid::MIXED)
+	{
+		for(ossim_uint32 k = 0; k < outputTile->getNumberOfBands(); ++k)
+			landGrid->applyMask((uchar*)outputTile->getBuf(k), tileRect.ul().x, tileRect.ul().y,
+			                    outputTile->getWidth(), outputTile->getHeight());
+		outputTile->validate();
+	}
    
    	return outputTile;
    
@@ -145,21 +184,22 @@ void ossimSimpleFilter::runUcharTransformation(ossimImageData* tile) {
 	
 	for(int k=0; k<nChannels; k++) {
 	  
-		// Get the correct buffer (input) pointer
-		ossim_uint16 *inBuf = (ossim_uint16*)tile->getBuf(k);
-
 		// Grab output buffer
 		uchar *outBuf = (uchar*)outputTile->getBuf(k);
 		
-		for (unsigned int i = 0; i < tile->getWidth(); i++)
+		// Input already scaled to 8 bit upstream (ossimRadiometricFilter)
+		if(tile->getScalarType() == OSSIM_UCHAR)
 		{
-		  for (unsigned int j = 0; j < tile->getHeight(); j++)
-		  {
-		      	*outBuf = (uchar) (*inBuf/scaleValue);
-			++inBuf;
-			++outBuf;		    
-		  }
+		  memcpy(outBuf, tile->getBuf(k), tile->getWidth()*tile->getHeight());
+		  continue;
 		}
+		
+		// Get the correct buffer (input) pointer
+		ossim_uint16 *inBuf = (ossim_uint16*)tile->getBuf(k);
+		
+		// Scale by scaleValue through the shared lookup table (rounded and saturated at 255)
+		if(!radiometry.isValid()) radiometry.buildLinear(scaleValue);
+		radiometry.apply(inBuf, outBuf, tile->getWidth()*tile->getHeight());
 	}
 
 	outputTile->validate(); 
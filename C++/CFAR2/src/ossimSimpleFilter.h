@@ -10,6 +10,10 @@
 #include "opencv/cv.h"
 #include "opencv/highgui.h"
 
+#include "landtilegrid.h"
+
+#include "ossimRadiometricFilter.h"
+
 class ossimSimpleFilter : public ossimImageSourceFilter
 {
 
@@ -39,7 +43,10 @@ public:
                           const char* prefix=0)const;
    
    int getScaleValue(void){return scaleValue;};
-   void setScaleValue(int val){scaleValue = val;};
+   void setScaleValue(int val){scaleValue = val; radiometry.invalidate();};
+
+   LandTileGrid* getLandGrid(void){return landGrid;};
+   void setLandGrid(LandTileGrid* val){landGrid = val;};
 
    /*!
     * Method to the load (recreate) the state of an object from a keyword
@@ -60,6 +67,8 @@ protected:
    void runUcharTransformation(ossimImageData* tile); 
 
    int scaleValue;
+   ossimRadiometricLut radiometry;
+   LandTileGrid* landGrid; // Land/sea cells of the scene, not owned
 TYPE_DATA
 };
 
@@ -0,0 +1,95 @@
+// Copyright (C) 2010 Argongra 
+//
+// OSSIM is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License 
+// as published by the Free Software Foundation.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. 
+//
+// You should have received a copy of the GNU General Public License
+// along with this software. If not, write to the Free Software 
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-
+// 1307, USA.
+//
+// See the GPL in the COPYING.GPL file for more details.
+//
+//*************************************************************************
+
+#include "ossimTileBufferPool.h"
+#include "pipelinemetrics.h"
+
+#include <pthread.h>
+
+static pthread_key_t poolKey;
+static pthread_once_t poolKeyOnce = PTHREAD_ONCE_INIT;
+
+static void destroyPool(void* pool)
+{
+   delete (ossimTileBufferPool*)pool;
+}
+
+static void createPoolKey()
+{
+   pthread_key_create(&poolKey, destroyPool);
+}
+
+ossimTileBufferPool* ossimTileBufferPool::instance()
+{
+   pthread_once(&poolKeyOnce, createPoolKey);
+
+   ossimTileBufferPool* pool = (ossimTileBufferPool*)pthread_getspecific(poolKey);
+   if(!pool)
+   {
+      pool = new ossimTileBufferPool();
+      pthread_setspecific(poolKey, pool);
+   }
+   return pool;
+}
+
+ossimTileBufferPool::ossimTileBufferPool()
+   : bytes(0),
+     maxBytes(64 * 1024 * 1024)
+{
+}
+
+ossimTileBufferPool::~ossimTileBufferPool()
+{
+   clear();
+}
+
+cv::Mat ossimTileBufferPool::borrow(int rows, int cols, int type)
+{
+   Key key = {rows, cols, type};
+   std::multimap<Key, cv::Mat>::iterator it = buffers.find(key);
+   if(it == buffers.end())
+      return cv::Mat(rows, cols, type);
+
+   cv::Mat mat = it->second;
+   buffers.erase(it);
+   bytes -= mat.total()*mat.elemSize();
+   return mat;
+}
+
+void ossimTileBufferPool::giveBack(cv::Mat& mat)
+{
+   // Only whole buffers nobody else holds: a Mat rebound to an ROI or to
+   // someone else's data (or still shared) is just released
+   size_t size = mat.total()*mat.elemSize();
+   if(!mat.empty() && mat.refcount && *mat.refcount == 1 && mat.data == mat.datastart
+      && mat.isContinuous() && bytes + size <= maxBytes)
+   {
+      Key key = {mat.rows, mat.cols, mat.type()};
+      buffers.insert(std::make_pair(key, mat));
+      bytes += size;
+      PipelineMetrics::noteHighWater("tile_pool_bytes", bytes);
+   }
+   mat.release();
+}
+
+void ossimTileBufferPool::clear()
+{
+   buffers.clear();
+   bytes = 0;
+}
@@ -0,0 +1,65 @@
+#ifndef ossimTileBufferPool_HEADER
+#define ossimTileBufferPool_HEADER
+
+#include <map>
+
+#include "opencv/cv.h"
+
+/*
+ * Scratch cv::Mats for the detector filters, one pool per thread so tiles
+ * running in parallel never share or lock. Buffers are keyed by rows, cols
+ * and type; a tile borrows what it needs and gives it back at the end of
+ * getTile, so the steady state allocates nothing.
+ */
+class ossimTileBufferPool
+{
+public:
+   static ossimTileBufferPool* instance();	// Pool of the calling thread
+
+   cv::Mat borrow(int rows, int cols, int type);	// Contents undefined
+   void giveBack(cv::Mat& mat);			// mat is released
+   void clear();
+
+   size_t getBytes(void) const {return bytes;};
+   size_t getMaxBytes(void) const {return maxBytes;};
+   void setMaxBytes(size_t val){maxBytes = val;};	// Buffers beyond this are freed, not kept
+
+   ~ossimTileBufferPool();
+
+protected:
+   ossimTileBufferPool();
+
+   struct Key
+   {
+      int rows, cols, type;
+      bool operator<(const Key& other) const
+      {
+         if(rows != other.rows) return rows < other.rows;
+         if(cols != other.cols) return cols < other.cols;
+         return type < other.type;
+      }
+   };
+
+   std::multimap<Key, cv::Mat> buffers;
+   size_t bytes;
+   size_t maxBytes;
+};
+
+/*
+ * Borrows a scratch Mat from the thread's pool for the enclosing scope.
+ */
+class ossimTileScratch
+{
+public:
+   ossimTileScratch(int rows, int cols, int type)
+      : mat(ossimTileBufferPool::instance()->borrow(rows, cols, type)) {}
+   ~ossimTileScratch(){ossimTileBufferPool::instance()->giveBack(mat);}
+
+   cv::Mat mat;
+
+private:
+   ossimTileScratch(const ossimTileScratch&);
+   ossimTileScratch& operator=(const ossimTileScratch&);
+};
+
+#endif
@@ -29,17 +29,34 @@
 #include <ossim/base/ossimNumericProperty.h>
 
 #include "ossimWaveletFilter.h"
+#include "pipelinemetrics.h"
+#include "tracerecorder.h"
+#include "ossimTileBufferPool.h"
+
+#include <limits>
 
 RTTI_DEF1(ossimWaveletFilter, "ossimWaveletFilter", ossimImageSourceFilter)
 
 ossimWaveletFilter::ossimWaveletFilter(ossimObject* owner)
-   :ossimImageSourceFilter(owner)
+   :ossimImageSourceFilter(owner),
+     waveletType(0),
+     waveletLevels(1),
+     statisticsMode(0),
+     statisticsDecimation(0),
+     sceneStatisticsValid(false),
+     landGrid(NULL)
 {
 }
 
 ossimWaveletFilter::ossimWaveletFilter(ossimImageSource* inputSource)
    : ossimImageSourceFilter(NULL, inputSource),
-     outputTile(NULL)
+     outputTile(NULL),
+     waveletType(0),
+     waveletLevels(1),
+     statisticsMode(0),
+     statisticsDecimation(0),
+     sceneStatisticsValid(false),
+     landGrid(NULL)
 {
 }
 
@@ -58,10 +75,33 @@ ossimRefPtr<ossimImageData> ossimWaveletFilter::getTile(const ossimIrect& tileRe
    
    	if(!outputTile.valid()) initialize();
 	if(!outputTile.valid()) return 0;
+	
+	MetricsTimer timer("tile");
+	TraceSpan span("Wavelet getTile", "filter", tileRect.ul().x, tileRect.ul().y);
+	PipelineMetrics::addCount("tiles", 1);
+	
+	// First pass over the scene (only once) when thresholding against scene statistics
+	if(statisticsMode == 1 && !sceneStatisticsValid) computeSceneStatistics();
   
+	int landClass = LandTileGrid::SEA;
+	if(landGrid)
+	{
+		landClass = landGrid->classify(tileRect.ul().x, tileRect.ul().y, tileRect.lr().x, tileRect.lr().y);
+		if(landClass == LandTileGrid::LAND)
+		{
+			PipelineMetrics::addCount("tiles_land", 1);
+			outputTile->setImageRectangle(tileRect);
+			outputTile->setOrigin(tileRect.ul());
+			outputTile->makeBlank();
+			return outputTile;
+		}
+	}
+
 	ossimRefPtr<ossimImageData> data = 0;
 	if(theInputConnection)
 	{
+		MetricsTimer readTimer("read");
+		TraceSpan readSpan("tile read", "io", tileRect.ul().x, tileRect.ul().y);
 		data  = theInputConnection->getTile(tileRect, resLevel);
    	} else {
 	      return 0;
@@ -77,11 +117,21 @@ ossimRefPtr<ossimImageData> ossimWaveletFilter::getTile(const ossimIrect& tileRe
 	outputTile->makeBlank();
    
 	outputTile->setOrigin(tileRect.ul());
-	runUcharTransformation(data.get());
+	{
+		MetricsTimer detectorTimer("detector");
+		TraceSpan kernelSpan("Wavelet kernel", "kernel", tileRect.ul().x, tileRect.ul().y);
+		runUcharTransformation(data.get());
+	}
+	PipelineMetrics::addCount("pixels", (double)tileRect.width()*tileRect.height());
+	PipelineMetrics::addCount("bytes_read", data->getSizeInBytes());
+	if(landClass == LandTileGrid::MIXED)
+	{
+		for(ossim_uint32 k = 0; k < outputTile->getNumberOfBands(); ++k)
+			landGrid->applyMask((uchar*)outputTile->getBuf(k), tileRect.ul().x, tileRect.ul().y,
+			                    outputTile->getWidth(), outputTile->getHeight());
+		outputTile->validate();
+	}
    
-	if(tileRect.ul().x % 1024 == 0 && tileRect.ul().y % 1024 == 0)
-       	 std::cout << "Processing tile: (" << tileRect.ul().x << "," << tileRect.ul().y << ")" << std::endl; 
-   	
 	return outputTile;
    
 }
@@ -150,20 +200,22 @@ void ossimWaveletFilter::runUcharTransformation(ossimImageData* tile) {
 	// Run through each channel, get input image, process it then save it to output image
 	for(int k=0; k<nChannels; k++) 
 	{
-	  	// Grab input tile and create shallow OpenCV image (no deep copying)
-		ossim_uint16 *inBuf = (ossim_uint16*)tile->getBuf(k);
-		cv::Mat inputTile(tile->getHeight(), tile->getWidth(), CV_16UC1, (ossim_uint16*)inBuf);
+		// Scale input values by scaleValue into 8 bit through the shared lookup table
+		if(!radiometry.isValid()) radiometry.buildLinear(scaleValue);
+		ossimTileScratch inputClone(tile->getHeight(), tile->getWidth(), CV_8UC1);
+		cv::Mat inputTile;
 		
-		// Scale input values by some factor (scaleValue)
-		cv::divide(inputTile,cv::Scalar::all(scaleValue),inputTile);
-
-		// Convert input into 8 bit, unsigned single channel
-		inputTile.convertTo(inputTile,CV_8UC1);
+		// 8-bit input tiles are copied into the scratch buffer, so keep the upstream buffer untouched
+		if(tile->getScalarType() == OSSIM_UCHAR)
+		  cv::Mat(tile->getHeight(), tile->getWidth(), CV_8UC1, tile->getBuf(k)).copyTo(inputClone.mat);
+		else
+		  radiometry.toUchar(tile, k, inputClone.mat);
 		
 		// Threshold image using Wavelet
-		cv::Mat inputClone;
-		inputClone = inputTile.clone();
-		simpleWavelet(inputClone, inputTile);
+		if(waveletType == 0 && statisticsMode == 0)
+		  simpleWavelet(inputClone.mat, inputTile);
+		else
+		  liftingWavelet(inputClone.mat, inputTile);
 
 		uchar *outBuf = (uchar*)outputTile->getBuf(k);
 		cv::Mat outputTile(tile->getHeight(), tile->getWidth(), CV_8UC1, (unsigned char *)outBuf);
@@ -192,16 +244,18 @@ void ossimWaveletFilter::simpleWavelet(cv::Mat& inputImage, cv::Mat& outputImage
   int width = inputImage.cols;
   int height = inputImage.rows;
 
-  //Create empty matrices for processing
+  //Borrow the processing matrices from the thread's buffer pool
   //NOTE: coeffienct matrices are half the height/width of input image
-  cv::Mat sourceImage = cv::Mat(height, width, CV_32FC1),
-          cA = cv::Mat(height/2, width/2, CV_32FC1),
-          cV = cv::Mat(height/2, width/2, CV_32FC1),
-	  cH = cv::Mat(height/2, width/2, CV_32FC1),
-          cD = cv::Mat(height/2, width/2, CV_32FC1);
+  ossimTileScratch sourceScratch(height, width, CV_32FC1),
+                   cAScratch(height/2, width/2, CV_32FC1),
+                   cVScratch(height/2, width/2, CV_32FC1),
+                   cHScratch(height/2, width/2, CV_32FC1),
+                   cDScratch(height/2, width/2, CV_32FC1);
+  cv::Mat &sourceImage = sourceScratch.mat, &cA = cAScratch.mat, &cV = cVScratch.mat,
+          &cH = cHScratch.mat, &cD = cDScratch.mat;
 
   //Convert input image to floating and then get four coeffient images
-  inputImage.clone().convertTo(sourceImage,CV_32FC1);
+  inputImage.convertTo(sourceImage,CV_32FC1);
   assert(sourceImage.type() == CV_32FC1);
   getHaarWaveletCoeff(sourceImage,cA,cH,cV,cD);
 
@@ -273,6 +327,382 @@ void ossimWaveletFilter::scaleImage(cv::Mat& image)
    {image=image*(1.0/(M-m))-m/(M-m);}
 }
 
+/*! @brief Multi-level lifting wavelet detector
+ *
+ * Runs waveletLevels levels of an in-place Haar (waveletType 0 or 1) or CDF 5/3 
+ * (waveletType 2) lifting transform. At each level the normalised A*H*V*D 
+ * product is formed in one pass over the lifted buffer (fusedCoeffProduct)
+ * and thresholded at mu + c*sigma. The normalisation and mu/sigma come from the
+ * tile itself, or from the scene when statisticsMode == 1. The detections of 
+ * all levels are combined into a single binary image the size of the input.
+ * 
+ * @param inputImage 8-bit grayscale single channel input image (type CV_8UC1)
+ * @param outputImage binary output image where TRUE == 255 and FALSE == 0 
+ */
+void ossimWaveletFilter::liftingWavelet(cv::Mat& inputImage, cv::Mat& outputImage)
+{
+  assert(inputImage.type() == CV_8UC1);
+
+  cv::Mat level, lifted;
+  inputImage.convertTo(level, CV_32FC1);
+  outputImage = cv::Mat(inputImage.rows, inputImage.cols, CV_8UC1, cv::Scalar::all(0));
+
+  for(int l = 0; l < waveletLevels && nextLevel(level, lifted); l++)
+  {
+    bool useScene = statisticsMode == 1 && sceneStatisticsValid 
+		    && l < (int)sceneProductStatistics.size()
+		    && sceneProductStatistics[l].getCount() > 0;
+    
+    //Coefficient ranges for the normalisation
+    ossimWaveletStatistics tileBands[4];
+    const ossimWaveletStatistics *bands = tileBands;
+    if(useScene)
+      bands = &sceneBandStatistics[4*l];
+    else
+      coeffBandRange(lifted, tileBands);
+
+    //Fused normalised coefficient product, then threshold at mu + c*sigma
+    cv::Mat rImage, levelMask;
+    ossimWaveletStatistics product;
+    fusedCoeffProduct(lifted, bands, rImage, product);
+    
+    double threshold;
+    if(useScene)
+      threshold = sceneProductStatistics[l].getMean() + cThreshold*sceneProductStatistics[l].getStdDev();
+    else
+      threshold = product.getMean() + cThreshold*product.getStdDev();
+    
+    cv::threshold(rImage, levelMask, threshold, 255, cv::THRESH_BINARY);
+    levelMask.convertTo(levelMask, CV_8UC1);
+
+    //Bring the detections back to input resolution and combine with the other levels
+    cv::resize(levelMask, levelMask, inputImage.size(), 0, 0, cv::INTER_NEAREST);
+    cv::max(outputImage, levelMask, outputImage);
+  }
+}
+
+/*! @brief Moves to the next level of the transform and lifts it
+ * 
+ * On the first call 'level' is lifted as is. On later calls 'level' is first 
+ * replaced by the approximation band (even rows and columns) of 'lifted'.
+ * 
+ * @param level the image for the current level (type CV_32FC1)
+ * @param lifted returned lifted view of level (cropped to an even size) 
+ * @return false when the level is too small to transform
+ */
+bool ossimWaveletFilter::nextLevel(cv::Mat& level, cv::Mat& lifted)
+{
+  if(!lifted.empty())
+  {
+    cv::Mat approximation(lifted.rows/2, lifted.cols/2, CV_32FC1);
+    for(int y = 0; y < approximation.rows; y++)
+    {
+      const float *src = lifted.ptr<float>(2*y);
+      float *dst = approximation.ptr<float>(y);
+      for(int x = 0; x < approximation.cols; x++)
+	dst[x] = src[2*x];
+    }
+    level = approximation;
+  }
+
+  //Lifting works on pairs of samples so drop the last odd row/column
+  int width = level.cols & ~1;
+  int height = level.rows & ~1;
+  if(width < 2 || height < 2)
+    return false;
+
+  lifted = level(cv::Rect(0, 0, width, height));
+  liftForward(lifted);
+  return true;
+}
+
+/*! @brief In-place separable 2D lifting step
+ *
+ * After the row and column passes each 2x2 block holds the approximation (A),
+ * horizontal (H), vertical (V) and diagonal (D) coefficients as
+ * 
+ *   A H
+ *   V D
+ * 
+ * which matches the orientation of getHaarWaveletCoeff. 
+ * 
+ * @param image 32 bit floating image with an even number of rows and columns
+ */
+void ossimWaveletFilter::liftForward(cv::Mat& image)
+{
+  assert(image.type() == CV_32FC1 && image.rows % 2 == 0 && image.cols % 2 == 0);
+  
+  liftRows(image);
+  liftColumns(image);
+}
+
+/*! @brief One lifting level along each row (even = smooth, odd = detail)
+ */
+void ossimWaveletFilter::liftRows(cv::Mat& image)
+{
+  int n = image.cols;
+  
+  for(int y = 0; y < image.rows; y++)
+  {
+    float *r = image.ptr<float>(y);
+    
+    if(waveletType == 2)
+    {
+      //CDF 5/3 predict (symmetric extension at the right edge)
+      for(int i = 1; i < n; i += 2)
+      {
+	float right = (i + 1 < n) ? r[i+1] : r[i-1];
+	r[i] = 0.5f*(r[i-1] + right) - r[i];
+      }
+      //CDF 5/3 update (symmetric extension at the left edge)
+      r[0] -= 0.5f*r[1];
+      for(int i = 2; i < n; i += 2)
+	r[i] -= 0.25f*(r[i-1] + r[i+1]);
+    }
+    else
+    {
+      //Haar predict and update
+      for(int i = 0; i < n; i += 2)
+      {
+	r[i+1] = r[i] - r[i+1];
+	r[i] -= 0.5f*r[i+1];
+      }
+    }
+  }
+}
+
+/*! @brief One lifting level along each column (even = smooth, odd = detail)
+ * 
+ * The lifting steps are applied to whole rows at a time so the inner loops 
+ * run over contiguous memory.
+ */
+void ossimWaveletFilter::liftColumns(cv::Mat& image)
+{
+  int n = image.rows;
+  int width = image.cols;
+  
+  if(waveletType == 2)
+  {
+    //CDF 5/3 predict (symmetric extension at the bottom edge)
+    for(int i = 1; i < n; i += 2)
+    {
+      const float *above = image.ptr<float>(i-1);
+      const float *below = (i + 1 < n) ? image.ptr<float>(i+1) : above;
+      float *r = image.ptr<float>(i);
+      for(int x = 0; x < width; x++)
+	r[x] = 0.5f*(above[x] + below[x]) - r[x];
+    }
+    //CDF 5/3 update (symmetric extension at the top edge)
+    for(int i = 0; i < n; i += 2)
+    {
+      const float *above = (i > 0) ? image.ptr<float>(i-1) : image.ptr<float>(i+1);
+      const float *below = image.ptr<float>(i+1);
+      float *r = image.ptr<float>(i);
+      for(int x = 0; x < width; x++)
+	r[x] -= 0.25f*(above[x] + below[x]);
+    }
+  }
+  else
+  {
+    //Haar predict and update
+    for(int i = 0; i < n; i += 2)
+    {
+      float *even = image.ptr<float>(i);
+      float *odd = image.ptr<float>(i+1);
+      for(int x = 0; x < width; x++)
+      {
+	odd[x] = even[x] - odd[x];
+	even[x] -= 0.5f*odd[x];
+      }
+    }
+  }
+}
+
+/*! @brief Range of each coefficient band of a lifted buffer
+ * 
+ * @param lifted the output of liftForward (type CV_32FC1)
+ * @param bands four accumulators (A, H, V, D) updated with the band min/max
+ */
+void ossimWaveletFilter::coeffBandRange(const cv::Mat& lifted, ossimWaveletStatistics* bands)
+{
+  int height = lifted.rows/2;
+  int width = lifted.cols/2;
+
+  //Band order A, H, V, D
+  float minVal[4], maxVal[4];
+  for(int b = 0; b < 4; b++)
+  {
+    minVal[b] = lifted.at<float>(b/2, b%2);
+    maxVal[b] = minVal[b];
+  }
+
+  for(int y = 0; y < height; y++)
+  {
+    const float *r0 = lifted.ptr<float>(2*y);
+    const float *r1 = lifted.ptr<float>(2*y+1);
+    for(int x = 0; x < width; x++)
+    {
+      minVal[0] = std::min(minVal[0], r0[2*x]);   maxVal[0] = std::max(maxVal[0], r0[2*x]);
+      minVal[1] = std::min(minVal[1], r0[2*x+1]); maxVal[1] = std::max(maxVal[1], r0[2*x+1]);
+      minVal[2] = std::min(minVal[2], r1[2*x]);   maxVal[2] = std::max(maxVal[2], r1[2*x]);
+      minVal[3] = std::min(minVal[3], r1[2*x+1]); maxVal[3] = std::max(maxVal[3], r1[2*x+1]);
+    }
+  }
+
+  for(int b = 0; b < 4; b++)
+    bands[b].addRange(minVal[b], maxVal[b]);
+}
+
+/*! @brief Normalised A*H*V*D product straight from the lifted buffer
+ * 
+ * Equivalent to running scaleImage on the four coefficient images and 
+ * multiplying them, without materialising the coefficient images: a single 
+ * pass writes the normalised product while accumulating its mean and variance.
+ * 
+ * @param lifted the output of liftForward (type CV_32FC1)
+ * @param bands the A, H, V, D ranges used for the normalisation 
+ * @param rImage returned product image, half the height/width of lifted
+ * @param product accumulator updated with the moments of rImage
+ */
+void ossimWaveletFilter::fusedCoeffProduct(const cv::Mat& lifted, const ossimWaveletStatistics* bands, 
+                                           cv::Mat& rImage, ossimWaveletStatistics& product)
+{
+  int height = lifted.rows/2;
+  int width = lifted.cols/2;
+
+  //Same normalisation as scaleImage (bands with no range are left unscaled). A scene 
+  //range from sampled tiles may not cover this tile, so the factors are clamped to [0,1]: 
+  //two out of range negative factors would otherwise multiply into a detection
+  float scale[4], offset[4], lower[4], upper[4];
+  for(int b = 0; b < 4; b++)
+  {
+    double range = bands[b].getMax() - bands[b].getMin();
+    scale[b] = (range > 0) ? 1.0/range : 1.0f;
+    offset[b] = (range > 0) ? bands[b].getMin() : 0.0f;
+    lower[b] = (range > 0) ? 0.0f : -std::numeric_limits<float>::max();
+    upper[b] = (range > 0) ? 1.0f : std::numeric_limits<float>::max();
+  }
+
+  rImage.create(height, width, CV_32FC1);
+  double sum = 0, sumSq = 0;
+  for(int y = 0; y < height; y++)
+  {
+    const float *r0 = lifted.ptr<float>(2*y);
+    const float *r1 = lifted.ptr<float>(2*y+1);
+    float *out = rImage.ptr<float>(y);
+    float rowSum = 0, rowSumSq = 0;
+    for(int x = 0; x < width; x++)
+    {
+      float p = std::min(std::max((r0[2*x]   - offset[0])*scale[0], lower[0]), upper[0])
+	       *std::min(std::max((r0[2*x+1] - offset[1])*scale[1], lower[1]), upper[1])
+	       *std::min(std::max((r1[2*x]   - offset[2])*scale[2], lower[2]), upper[2])
+	       *std::min(std::max((r1[2*x+1] - offset[3])*scale[3], lower[3]), upper[3]);
+      out[x] = p;
+      rowSum += p;
+      rowSumSq += p*p;
+    }
+    sum += rowSum;
+    sumSq += rowSumSq;
+  }
+
+  product.addMoments((double)width*height, sum, sumSq);
+}
+
+/*! @brief First pass of the two pass (scene statistics) mode
+ * 
+ * Sweeps the input twice, sampling every 2^statisticsDecimation th tile in 
+ * each direction: the first sweep gathers the scene range of every coefficient 
+ * band at every level, the second the scene mean/variance of the normalised 
+ * product using those ranges. Tiles are then thresholded against these 
+ * statistics, so the result no longer depends on tile size or tile content.
+ * 
+ * The product is normalised by the scene ranges, so its moments cannot be 
+ * gathered before the ranges are known: every sampled tile is read and lifted 
+ * twice, about 2/4^n of the cost of the detection pass itself. Filters running 
+ * the same scene on other threads should take the result through 
+ * copySceneStatistics rather than sweeping the scene again.
+ */
+void ossimWaveletFilter::computeSceneStatistics(void)
+{
+  sceneBandStatistics.assign(4*waveletLevels, ossimWaveletStatistics());
+  sceneProductStatistics.assign(waveletLevels, ossimWaveletStatistics());
+  sceneStatisticsValid = false;
+  
+  if(!theInputConnection)
+    return;
+  
+  ossimIrect bounds = theInputConnection->getBoundingRect(0);
+  ossim_int32 tileWidth = theInputConnection->getTileWidth();
+  ossim_int32 tileHeight = theInputConnection->getTileHeight();
+  ossim_int32 stride = 1 << std::max(0, statisticsDecimation);
+  if(!radiometry.isValid()) radiometry.buildLinear(scaleValue);
+  
+  for(int pass = 0; pass < 2; pass++)
+  {
+    for(ossim_int32 y = bounds.ul().y; y <= bounds.lr().y; y += tileHeight*stride)
+    {
+      for(ossim_int32 x = bounds.ul().x; x <= bounds.lr().x; x += tileWidth*stride)
+      {
+	ossimIrect tileRect(x, y, x + tileWidth - 1, y + tileHeight - 1);
+	ossimRefPtr<ossimImageData> data = theInputConnection->getTile(tileRect, 0);
+	if(!data.valid() || data->getDataObjectStatus() == OSSIM_NULL || data->getDataObjectStatus() == OSSIM_EMPTY)
+	  continue;
+	
+	for(ossim_uint32 k = 0; k < data->getNumberOfBands(); k++)
+	{
+	  // Same scaling as runUcharTransformation, without touching the input tile
+	  cv::Mat scaledTile;
+	  radiometry.toUchar(data.get(), k, scaledTile);
+	  
+	  accumulateSceneStatistics(scaledTile, pass == 0);
+	}
+      }
+    }
+  }
+  
+  sceneStatisticsValid = true;
+}
+
+/*! @brief Takes the scene statistics already gathered by another filter
+ * 
+ * @param source a filter on the same scene, with the same levels and scaling
+ */
+void ossimWaveletFilter::copySceneStatistics(const ossimWaveletFilter& source)
+{
+  sceneBandStatistics = source.sceneBandStatistics;
+  sceneProductStatistics = source.sceneProductStatistics;
+  sceneStatisticsValid = source.sceneStatisticsValid;
+}
+
+/*! @brief Merges the statistics of one tile into the scene statistics
+ * 
+ * @param image scaled 8-bit tile (type CV_8UC1)
+ * @param bandPass true to accumulate the band ranges, false for the product moments
+ */
+void ossimWaveletFilter::accumulateSceneStatistics(cv::Mat& image, bool bandPass)
+{
+  cv::Mat level, lifted;
+  image.convertTo(level, CV_32FC1);
+  
+  for(int l = 0; l < waveletLevels && nextLevel(level, lifted); l++)
+  {
+    if(bandPass)
+    {
+      ossimWaveletStatistics tileBands[4];
+      coeffBandRange(lifted, tileBands);
+      for(int b = 0; b < 4; b++)
+	sceneBandStatistics[4*l+b].merge(tileBands[b]);
+    }
+    else
+    {
+      cv::Mat rImage;
+      ossimWaveletStatistics tileProduct;
+      fusedCoeffProduct(lifted, &sceneBandStatistics[4*l], rImage, tileProduct);
+      sceneProductStatistics[l].merge(tileProduct);
+    }
+  }
+}
+
 void ossimWaveletFilter::setProperty(ossimRefPtr<ossimProperty> property)
 
 {
@@ -339,3 +769,53 @@ void ossimWaveletFilter::getPropertyNames(std::vector<ossimString>& propertyName
         propertyNames.push_back("aperture_size");
 
 }
+
+
+
+ossimWaveletStatistics::ossimWaveletStatistics()
+   : count(0),
+     mean(0),
+     m2(0),
+     minVal(std::numeric_limits<double>::max()),
+     maxVal(-std::numeric_limits<double>::max())
+{
+}
+
+void ossimWaveletStatistics::addRange(double minValue, double maxValue)
+{
+  minVal = std::min(minVal, minValue);
+  maxVal = std::max(maxVal, maxValue);
+}
+
+void ossimWaveletStatistics::addMoments(double n, double sum, double sumSq)
+{
+  if(n <= 0)
+    return;
+  
+  ossimWaveletStatistics other;
+  other.count = n;
+  other.mean = sum/n;
+  other.m2 = std::max(0.0, sumSq - sum*sum/n);
+  merge(other);
+}
+
+/*! @brief Pairwise combination of two accumulators (Chan et al.)
+ */
+void ossimWaveletStatistics::merge(const ossimWaveletStatistics& other)
+{
+  addRange(other.minVal, other.maxVal);
+  
+  if(other.count <= 0)
+    return;
+  
+  double n = count + other.count;
+  double delta = other.mean - mean;
+  mean += delta*other.count/n;
+  m2 += other.m2 + delta*delta*count*other.count/n;
+  count = n;
+}
+
+double ossimWaveletStatistics::getStdDev(void) const
+{
+  return (count > 0) ? sqrt(m2/count) : 0.0;
+}
@@ -6,10 +6,42 @@
 #include "ossim/imaging/ossimImageSourceFilter.h"
 
 #include <stdlib.h>
+#include <vector>
 
 #include "opencv/cv.h"
 #include "opencv/highgui.h"
 
+#include "landtilegrid.h"
+
+#include "ossimRadiometricFilter.h"
+
+/*
+ * Mergeable min/max and mean/variance accumulator. Partial results from 
+ * different tiles (or threads) can be merged in any order.
+ */
+class ossimWaveletStatistics
+{
+public:
+   ossimWaveletStatistics();
+   
+   void addRange(double minValue, double maxValue);
+   void addMoments(double n, double sum, double sumSq);
+   void merge(const ossimWaveletStatistics& other);
+   
+   double getCount(void) const {return count;};
+   double getMin(void) const {return minVal;};
+   double getMax(void) const {return maxVal;};
+   double getMean(void) const {return mean;};
+   double getStdDev(void) const;
+
+protected:
+   double count;
+   double mean;
+   double m2;
+   double minVal;
+   double maxVal;
+};
+
 class ossimWaveletFilter : public ossimImageSourceFilter
 {
 
@@ -39,12 +71,31 @@ public:
                           const char* prefix=0)const;
    
    int getScaleValue(void){return scaleValue;};
-   void setScaleValue(int val){scaleValue = val;};
+   void setScaleValue(int val){scaleValue = val; radiometry.invalidate();};
+
+   LandTileGrid* getLandGrid(void){return landGrid;};
+   void setLandGrid(LandTileGrid* val){landGrid = val;};
 
    double getThreshold(void){return cThreshold;};
    void setThreshold(double val){cThreshold = val;};
     
+   int getWaveletType(void){return waveletType;};
+   void setWaveletType(int val){waveletType = val;};
+
+   int getWaveletLevels(void){return waveletLevels;};
+   void setWaveletLevels(int val){waveletLevels = val; sceneStatisticsValid = false;};
+
+   int getStatisticsMode(void){return statisticsMode;};
+   void setStatisticsMode(int val){statisticsMode = val; sceneStatisticsValid = false;};
+
+   int getStatisticsDecimation(void){return statisticsDecimation;};
+   void setStatisticsDecimation(int val){statisticsDecimation = val; sceneStatisticsValid = false;};
+
    void simpleWavelet(cv::Mat& inputImage, cv::Mat& outputImage);
+   void liftingWavelet(cv::Mat& inputImage, cv::Mat& outputImage);
+   void computeSceneStatistics(void);
+   void copySceneStatistics(const ossimWaveletFilter& source);
+   bool hasSceneStatistics(void) const {return sceneStatisticsValid;};
    
    
    /*!
@@ -66,9 +117,26 @@ protected:
    void runUcharTransformation(ossimImageData* tile);
    void getHaarWaveletCoeff(cv::Mat &src, cv::Mat &cA, cv::Mat &cH, cv::Mat &cV, cv::Mat &cD);
    void scaleImage(cv::Mat& image);
+   void liftForward(cv::Mat& image);
+   void liftRows(cv::Mat& image);
+   void liftColumns(cv::Mat& image);
+   bool nextLevel(cv::Mat& level, cv::Mat& lifted);
+   void coeffBandRange(const cv::Mat& lifted, ossimWaveletStatistics* bands);
+   void fusedCoeffProduct(const cv::Mat& lifted, const ossimWaveletStatistics* bands, 
+                          cv::Mat& rImage, ossimWaveletStatistics& product);
+   void accumulateSceneStatistics(cv::Mat& image, bool bandPass);
 
    int scaleValue;
+   ossimRadiometricLut radiometry;
    double cThreshold;
+   int waveletType;		// 0 = single level Haar, 1 = Haar lifting, 2 = CDF 5/3 lifting
+   int waveletLevels;
+   int statisticsMode;		// 0 = per tile, 1 = scene (two pass)
+   int statisticsDecimation;	// Scene statistics sample every 2^n th tile in each direction
+   bool sceneStatisticsValid;
+   std::vector<ossimWaveletStatistics> sceneBandStatistics;	// A,H,V,D per level
+   std::vector<ossimWaveletStatistics> sceneProductStatistics;	// One per level
+   LandTileGrid* landGrid; // Land/sea cells of the scene, not owned
 TYPE_DATA
 };
 
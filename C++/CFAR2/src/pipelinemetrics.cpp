@@ -0,0 +1,263 @@
+/** 
+ *
+ * CFAR2 ship detection pipeline
+ * Per-scene stage and tile metrics
+ *
+**/
+
+#include "pipelinemetrics.h"
+#include "jsonstring.h"
+
+#include "opencv/cv.h"
+
+#include <OpenThreads/ScopedLock>
+
+#include <pthread.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+static pthread_key_t bufferKey;
+static pthread_once_t bufferKeyOnce = PTHREAD_ONCE_INIT;
+
+static void destroyBuffer(void *buffer)
+{
+  delete (MetricsThreadBuffer*) buffer;
+}
+
+static void createBufferKey()
+{
+  pthread_key_create(&bufferKey, destroyBuffer);
+}
+
+TimerStats::TimerStats()
+  : nCount(0), dfTotal(0.0), dfMin(0.0), dfMax(0.0)
+{
+  for(int i = 0; i < METRICS_BUCKETS; i++)
+    anBuckets[i] = 0;
+}
+
+void TimerStats::add(double dfSeconds)
+{
+  dfMin = nCount ? std::min(dfMin, dfSeconds) : dfSeconds;
+  dfMax = nCount ? std::max(dfMax, dfSeconds) : dfSeconds;
+  dfTotal += dfSeconds;
+  nCount++;
+
+  int nBucket = 0;
+  double dfMicro = dfSeconds * 1e6;
+  while(nBucket < METRICS_BUCKETS - 1 && dfMicro > (double)(1L << nBucket))
+    nBucket++;
+  anBuckets[nBucket]++;
+}
+
+void TimerStats::merge(const TimerStats &oOther)
+{
+  if(oOther.nCount == 0)
+    return;
+  dfMin = nCount ? std::min(dfMin, oOther.dfMin) : oOther.dfMin;
+  dfMax = nCount ? std::max(dfMax, oOther.dfMax) : oOther.dfMax;
+  dfTotal += oOther.dfTotal;
+  nCount += oOther.nCount;
+  for(int i = 0; i < METRICS_BUCKETS; i++)
+    anBuckets[i] += oOther.anBuckets[i];
+}
+
+double TimerStats::percentile(double dfFraction) const
+{
+  long nTarget = (long) ceil(dfFraction * nCount);
+  long nSeen = 0;
+  for(int i = 0; i < METRICS_BUCKETS; i++)
+  {
+    nSeen += anBuckets[i];
+    if(nSeen >= nTarget && nSeen > 0)
+      return std::min((double)(1L << i) * 1e-6, dfMax);
+  }
+  return dfMax;
+}
+
+PipelineMetrics::PipelineMetrics(std::string sceneName)
+  : scene(sceneName), startTicks((double) cv::getTickCount())
+{
+}
+
+PipelineMetrics::~PipelineMetrics()
+{
+}
+
+MetricsThreadBuffer *PipelineMetrics::threadBuffer()
+{
+  pthread_once(&bufferKeyOnce, createBufferKey);
+
+  MetricsThreadBuffer *buffer = (MetricsThreadBuffer*) pthread_getspecific(bufferKey);
+  if(!buffer)
+  {
+    buffer = new MetricsThreadBuffer();
+    pthread_setspecific(bufferKey, buffer);
+  }
+  return buffer;
+}
+
+PipelineMetrics *PipelineMetrics::current()
+{
+  return threadBuffer()->owner;
+}
+
+std::string PipelineMetrics::currentPath()
+{
+  return threadBuffer()->path;
+}
+
+void PipelineMetrics::addTime(const char *pszName, double dfSeconds)
+{
+  MetricsThreadBuffer *buffer = threadBuffer();
+  if(!buffer->owner)
+    return;
+  std::string name = buffer->path.empty() ? pszName : buffer->path + "/" + pszName;
+  buffer->timers[name].add(dfSeconds);
+}
+
+void PipelineMetrics::addCount(const char *pszName, double dfValue)
+{
+  MetricsThreadBuffer *buffer = threadBuffer();
+  if(buffer->owner)
+    buffer->counters[pszName] += dfValue;
+}
+
+void PipelineMetrics::noteHighWater(const char *pszName, double dfValue)
+{
+  MetricsThreadBuffer *buffer = threadBuffer();
+  if(!buffer->owner)
+    return;
+  std::map<std::string, double>::iterator it = buffer->highWater.find(pszName);
+  if(it == buffer->highWater.end())
+    buffer->highWater[pszName] = dfValue;
+  else
+    it->second = std::max(it->second, dfValue);
+}
+
+void PipelineMetrics::merge(MetricsThreadBuffer &oBuffer)
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex);
+
+  for(std::map<std::string, TimerStats>::iterator it = oBuffer.timers.begin(); it != oBuffer.timers.end(); ++it)
+    timers[it->first].merge(it->second);
+  for(std::map<std::string, double>::iterator it = oBuffer.counters.begin(); it != oBuffer.counters.end(); ++it)
+    counters[it->first] += it->second;
+  for(std::map<std::string, double>::iterator it = oBuffer.highWater.begin(); it != oBuffer.highWater.end(); ++it)
+  {
+    if(highWater.find(it->first) == highWater.end())
+      highWater[it->first] = it->second;
+    else
+      highWater[it->first] = std::max(highWater[it->first], it->second);
+  }
+
+  oBuffer.timers.clear();
+  oBuffer.counters.clear();
+  oBuffer.highWater.clear();
+}
+
+/*! @brief Writes the scene's metrics as JSON
+ *
+ * Times are in seconds, the histogram buckets are labelled with their
+ * upper bound in microseconds.  peak_rss_bytes is the process high-water
+ * mark so far (getrusage), it covers every scene run before this one.
+ */
+int PipelineMetrics::writeReport(std::string outputFilename)
+{
+  FILE *fp = fopen(outputFilename.c_str(), "w");
+  if(fp == NULL)
+  {
+    fprintf(stderr, "Unable to write metrics report %s.\n", outputFilename.c_str());
+    return 1;
+  }
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  double wall = ((double) cv::getTickCount() - startTicks)/cv::getTickFrequency();
+
+  OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex);
+
+  fprintf(fp, "{\n  \"scene\": %s,\n  \"wall_seconds\": %.6f,\n", jsonString(scene).c_str(), wall);
+
+  fprintf(fp, "  \"timers\": {");
+  for(std::map<std::string, TimerStats>::iterator it = timers.begin(); it != timers.end(); ++it)
+  {
+    const TimerStats &stats = it->second;
+    fprintf(fp, "%s\n    %s: {\"count\": %ld, \"total\": %.6f, \"mean\": %.6f, \"min\": %.6f, \"max\": %.6f, "
+	    "\"p50\": %.6f, \"p90\": %.6f, \"p99\": %.6f, \"histogram_us\": {",
+	    it == timers.begin() ? "" : ",", jsonString(it->first).c_str(), stats.nCount, stats.dfTotal,
+	    stats.nCount ? stats.dfTotal / stats.nCount : 0.0, stats.dfMin, stats.dfMax,
+	    stats.percentile(0.5), stats.percentile(0.9), stats.percentile(0.99));
+    bool first = true;
+    for(int i = 0; i < METRICS_BUCKETS; i++)
+    {
+      if(stats.anBuckets[i] == 0)
+	continue;
+      fprintf(fp, "%s\"%ld\": %ld", first ? "" : ", ", 1L << i, stats.anBuckets[i]);
+      first = false;
+    }
+    fprintf(fp, "}}");
+  }
+  fprintf(fp, "\n  },\n");
+
+  fprintf(fp, "  \"counters\": {");
+  for(std::map<std::string, double>::iterator it = counters.begin(); it != counters.end(); ++it)
+    fprintf(fp, "%s\n    %s: %.0f", it == counters.begin() ? "" : ",", jsonString(it->first).c_str(), it->second);
+  fprintf(fp, "\n  },\n");
+
+  fprintf(fp, "  \"high_water\": {\n    \"peak_rss_bytes\": %.0f", usage.ru_maxrss * 1024.0);
+  for(std::map<std::string, double>::iterator it = highWater.begin(); it != highWater.end(); ++it)
+    fprintf(fp, ",\n    %s: %.0f", jsonString(it->first).c_str(), it->second);
+  fprintf(fp, "\n  }\n}\n");
+
+  fclose(fp);
+  return 0;
+}
+
+MetricsScope::MetricsScope(PipelineMetrics *metrics, std::string path)
+{
+  MetricsThreadBuffer *buffer = PipelineMetrics::threadBuffer();
+  previousOwner = buffer->owner;
+  previousPath = buffer->path;
+
+  if(previousOwner && previousOwner != metrics)
+    previousOwner->merge(*buffer);
+  buffer->owner = metrics;
+  buffer->path = path;
+}
+
+MetricsScope::~MetricsScope()
+{
+  MetricsThreadBuffer *buffer = PipelineMetrics::threadBuffer();
+  if(buffer->owner)
+    buffer->owner->merge(*buffer);
+  buffer->owner = previousOwner;
+  buffer->path = previousPath;
+}
+
+MetricsTimer::MetricsTimer(const char *pszName)
+  : buffer(PipelineMetrics::threadBuffer()), pathLength(0), startTicks(0.0)
+{
+  if(!buffer->owner)
+  {
+    buffer = NULL;
+    return;
+  }
+  pathLength = buffer->path.size();
+  if(!buffer->path.empty())
+    buffer->path += "/";
+  buffer->path += pszName;
+  startTicks = (double) cv::getTickCount();
+}
+
+MetricsTimer::~MetricsTimer()
+{
+  if(!buffer)
+    return;
+  double t = ((double) cv::getTickCount() - startTicks)/cv::getTickFrequency();
+  if(buffer->owner)
+    buffer->timers[buffer->path].add(t);
+  buffer->path.resize(pathLength);
+}
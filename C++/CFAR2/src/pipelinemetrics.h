@@ -0,0 +1,109 @@
+/** 
+ *
+ * CFAR2 ship detection pipeline
+ * Per-scene stage and tile metrics
+ *
+**/
+
+#ifndef PIPELINEMETRICS_H
+#define PIPELINEMETRICS_H
+
+#include <OpenThreads/Mutex>
+
+#include <map>
+#include <string>
+
+#define METRICS_BUCKETS 32	// Latency histogram, bucket i holds times up to 2^i microseconds
+
+/// Count, total, extremes and log2 histogram of one timer
+struct TimerStats
+{
+  TimerStats();
+  void add(double dfSeconds);
+  void merge(const TimerStats &oOther);
+  double percentile(double dfFraction) const;	// Upper bound of the bucket, seconds
+
+  long nCount;
+  double dfTotal;
+  double dfMin;
+  double dfMax;
+  long anBuckets[METRICS_BUCKETS];
+};
+
+class PipelineMetrics;
+
+/// What the calling thread has recorded since it last flushed, and where to
+struct MetricsThreadBuffer
+{
+  MetricsThreadBuffer() : owner(NULL) {}
+
+  PipelineMetrics *owner;
+  std::string path;				// Timer names are nested under it, "detect/tile"
+  std::map<std::string, TimerStats> timers;
+  std::map<std::string, double> counters;
+  std::map<std::string, double> highWater;
+};
+
+/// Timers, counters and high-water marks of one scene.  Threads record into
+/// their own buffer without locking and merge it into the scene's metrics
+/// when their MetricsScope ends, so tiles on many threads only contend once
+/// per thread.  With no scope bound to a thread recording is a no-op.
+class PipelineMetrics
+{
+
+public:
+PipelineMetrics(std::string sceneName);
+
+static MetricsThreadBuffer *threadBuffer();		// Of the calling thread
+static PipelineMetrics *current();			// Bound to the calling thread, NULL = not recording
+static std::string currentPath();
+
+static void addTime(const char *pszName, double dfSeconds);	// Under the current path
+static void addCount(const char *pszName, double dfValue);
+static void noteHighWater(const char *pszName, double dfValue);
+
+void merge(MetricsThreadBuffer &oBuffer);		// Empties oBuffer
+int writeReport(std::string outputFilename);		// JSON
+
+virtual ~PipelineMetrics();
+
+private:
+  std::string scene;
+  double startTicks;
+
+  OpenThreads::Mutex mutex;
+  std::map<std::string, TimerStats> timers;
+  std::map<std::string, double> counters;
+  std::map<std::string, double> highWater;
+};
+
+/// Binds the calling thread to a scene's metrics (NULL to stop recording)
+/// under a timer path, and flushes the thread's buffer when it ends
+class MetricsScope
+{
+
+public:
+MetricsScope(PipelineMetrics *metrics, std::string path);
+~MetricsScope();
+
+private:
+  PipelineMetrics *previousOwner;
+  std::string previousPath;
+};
+
+/// Times the enclosing block as <current path>/<name>; timers started
+/// inside it nest under that name
+class MetricsTimer
+{
+
+public:
+MetricsTimer(const char *pszName);
+~MetricsTimer();
+
+private:
+  MetricsThreadBuffer *buffer;
+  size_t pathLength;
+  double startTicks;
+};
+
+#endif // PIPELINEMETRICS_H
@@ -0,0 +1,77 @@
+/** 
+ *
+ * CFAR2 ship detection pipeline
+ * Process wide OSSIM/GDAL/OGR session
+ *
+**/
+
+#include "processingsession.h"
+
+#include "gdal.h"
+#include "ogr_api.h"
+#include "ossim/init/ossimInit.h"
+
+ProcessingSession::ProcessingSession()
+  : hMutex(NULL), ossimInitialized(false), gdalInitialized(false)
+{
+}
+
+ProcessingSession *ProcessingSession::instance()
+{
+    static ProcessingSession oSession;
+    return &oSession;
+}
+
+/************************************************************************/
+/*                             initialize()                             */
+/************************************************************************/
+
+void ProcessingSession::initialize()
+{
+    {
+        CPLMutexHolderD( &hMutex );
+        if( !ossimInitialized )
+        {
+            ossimInit::instance()->initialize();
+            ossimInitialized = true;
+        }
+    }
+
+    initializeGDAL();
+}
+
+void ProcessingSession::initializeGDAL()
+{
+    CPLMutexHolderD( &hMutex );
+    if( gdalInitialized )
+        return;
+
+    GDALAllRegister();
+    OGRRegisterAll();
+    gdalInitialized = true;
+}
+
+/************************************************************************/
+/*                              finalize()                              */
+/*                                                                      */
+/*      Every dataset must be closed.  Releases the driver managers     */
+/*      and with them all /vsimem/ files.                               */
+/************************************************************************/
+
+void ProcessingSession::finalize()
+{
+    CPLMutexHolderD( &hMutex );
+
+    if( gdalInitialized )
+    {
+        GDALDestroyDriverManager();
+        OGRCleanupAll();
+        gdalInitialized = false;
+    }
+
+    if( ossimInitialized )
+    {
+        ossimInit::instance()->finalize();
+        ossimInitialized = false;
+    }
+}
@@ -0,0 +1,40 @@
+/** 
+ *
+ * CFAR2 ship detection pipeline
+ * Process wide OSSIM/GDAL/OGR session
+ *
+**/
+
+#ifndef PROCESSINGSESSION_H
+#define PROCESSINGSESSION_H
+
+#include "cpl_multiproc.h"
+
+/// One OSSIM/GDAL/OGR session per process.  Drivers and plugins are
+/// registered on first use and torn down once by finalize(), so a batch
+/// of scenes pays the registration cost once and /vsimem/ files live
+/// until the end of the run.
+class ProcessingSession
+{
+
+public:
+static ProcessingSession *instance();
+
+void initialize();		// OSSIM (with its plugins), GDAL and OGR
+void initializeGDAL();		// GDAL and OGR only, for the GDAL-side classes
+void finalize();
+
+bool isOssimInitialized(void){return ossimInitialized;};
+bool isGDALInitialized(void){return gdalInitialized;};
+
+private:
+  ProcessingSession();
+  ProcessingSession(const ProcessingSession &);
+  ProcessingSession &operator=(const ProcessingSession &);
+
+  void *hMutex;
+  bool ossimInitialized;
+  bool gdalInitialized;
+};
+
+#endif // PROCESSINGSESSION_H
@@ -0,0 +1,457 @@
+/** 
+ *
+ * CFAR2 ship detection pipeline
+ * Pixel/line <-> lat/long from the N1 geolocation tie points
+ *
+**/
+
+#include "tiepointgeocoder.h"
+#include "processingsession.h"
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <map>
+#include <utility>
+
+TiePointGeocoder::TiePointGeocoder()
+  : nGCPCount(0), pasGCPList(NULL), nRasterXSize(0), nRasterYSize(0), hTPSArg(NULL), hInverseArg(NULL),
+    dfCentreLong(0.0)
+{
+}
+
+/// dfLong shifted by whole turns into [dfRef - 180, dfRef + 180]
+static double unwrapLong(double dfLong, double dfRef)
+{
+    while( dfLong - dfRef > 180.0 )
+        dfLong -= 360.0;
+    while( dfLong - dfRef < -180.0 )
+        dfLong += 360.0;
+    return dfLong;
+}
+
+TiePointGeocoder::~TiePointGeocoder()
+{
+  clear();
+}
+
+void TiePointGeocoder::clear()
+{
+    if( pasGCPList != NULL )
+    {
+        GDALDeinitGCPs( nGCPCount, pasGCPList );
+        CPLFree( pasGCPList );
+        pasGCPList = NULL;
+    }
+    nGCPCount = 0;
+
+    if( hTPSArg != NULL )
+    {
+        GDALDestroyTPSTransformer( hTPSArg );
+        hTPSArg = NULL;
+    }
+
+    if( hInverseArg != NULL )
+    {
+        GDALDestroyGCPTransformer( hInverseArg );
+        hInverseArg = NULL;
+    }
+
+    gridPixels.clear();
+    gridLines.clear();
+    gridLats.clear();
+    gridLongs.clear();
+}
+
+/************************************************************************/
+/*                                load()                                */
+/*                                                                      */
+/*      The N1 is only opened for its GCPs, which the ENVISAT driver    */
+/*      reads from the geolocation grid ADS.                            */
+/************************************************************************/
+
+int TiePointGeocoder::load(std::string inputFilenameN1)
+{
+    GDALDatasetH hDataset;
+    int nErr;
+
+    ProcessingSession::instance()->initializeGDAL();
+
+    hDataset = GDALOpen( inputFilenameN1.c_str(), GA_ReadOnly );
+    if( hDataset == NULL )
+    {
+        fprintf( stderr,
+                 "GDALOpen failed - %d\n%s\n",
+                 CPLGetLastErrorNo(), CPLGetLastErrorMsg() );
+        return 1;
+    }
+
+    nErr = loadGCPs( GDALGetGCPCount( hDataset ), GDALGetGCPs( hDataset ),
+                     GDALGetRasterXSize( hDataset ),
+                     GDALGetRasterYSize( hDataset ) );
+
+    GDALClose( hDataset );
+
+    return nErr;
+}
+
+int TiePointGeocoder::loadGCPs(int nGCPs, const GDAL_GCP *pasGCPs, int nXSize, int nYSize)
+{
+    clear();
+
+    if( nGCPs < 3 )
+    {
+        fprintf( stderr, "Tie point geocoder needs at least 3 GCPs, got %d.\n", nGCPs );
+        return 1;
+    }
+
+    nGCPCount = nGCPs;
+    pasGCPList = GDALDuplicateGCPs( nGCPs, pasGCPs );
+    nRasterXSize = nXSize;
+    nRasterYSize = nYSize;
+
+    double dfBest = -1.0;
+    for( int i = 0; i < nGCPCount; i++ )
+    {
+        double dfDX = pasGCPList[i].dfGCPPixel - 0.5 * nXSize;
+        double dfDY = pasGCPList[i].dfGCPLine - 0.5 * nYSize;
+        if( dfBest < 0.0 || dfDX*dfDX + dfDY*dfDY < dfBest )
+        {
+            dfBest = dfDX*dfDX + dfDY*dfDY;
+            dfCentreLong = pasGCPList[i].dfGCPX;
+        }
+    }
+
+    if( buildGrid() == 0 )
+        return 0;
+
+/* -------------------------------------------------------------------- */
+/*      Irregular GCPs: thin plate spline through all of them.          */
+/* -------------------------------------------------------------------- */
+    hTPSArg = GDALCreateTPSTransformer( nGCPCount, pasGCPList, FALSE );
+
+    return (hTPSArg == NULL) ? 1 : 0;
+}
+
+/************************************************************************/
+/*                             buildGrid()                              */
+/*                                                                      */
+/*      Succeeds only if every (line, pixel) pair of the distinct GCP   */
+/*      lines and pixels is present exactly once.                       */
+/************************************************************************/
+
+int TiePointGeocoder::buildGrid()
+{
+    std::map< std::pair<double,double>, int > oIndex;
+    int i;
+
+    for( i = 0; i < nGCPCount; i++ )
+    {
+        gridPixels.push_back( pasGCPList[i].dfGCPPixel );
+        gridLines.push_back( pasGCPList[i].dfGCPLine );
+        oIndex[std::make_pair( pasGCPList[i].dfGCPLine, pasGCPList[i].dfGCPPixel )] = i;
+    }
+
+    std::sort( gridPixels.begin(), gridPixels.end() );
+    gridPixels.erase( std::unique( gridPixels.begin(), gridPixels.end() ), gridPixels.end() );
+    std::sort( gridLines.begin(), gridLines.end() );
+    gridLines.erase( std::unique( gridLines.begin(), gridLines.end() ), gridLines.end() );
+
+    if( gridPixels.size() < 2 || gridLines.size() < 2
+        || (int) oIndex.size() != nGCPCount
+        || gridPixels.size() * gridLines.size() != (size_t) nGCPCount )
+    {
+        gridPixels.clear();
+        gridLines.clear();
+        return 1;
+    }
+
+    gridLats.resize( nGCPCount );
+    gridLongs.resize( nGCPCount );
+    for( size_t iLine = 0; iLine < gridLines.size(); iLine++ )
+    {
+        for( size_t iPixel = 0; iPixel < gridPixels.size(); iPixel++ )
+        {
+            int iGCP = oIndex[std::make_pair( gridLines[iLine], gridPixels[iPixel] )];
+            gridLats[iLine*gridPixels.size() + iPixel] = pasGCPList[iGCP].dfGCPY;
+            gridLongs[iLine*gridPixels.size() + iPixel] = pasGCPList[iGCP].dfGCPX;
+        }
+    }
+
+    return 0;
+}
+
+/************************************************************************/
+/*                           pixelToLatLong()                           */
+/*                                                                      */
+/*      Bilinear interpolation in the grid cell containing the point,   */
+/*      the edge cells are extrapolated.  Longitudes are unwrapped      */
+/*      against the first corner so cells across the antimeridian      */
+/*      interpolate correctly.                                          */
+/************************************************************************/
+
+bool TiePointGeocoder::pixelToLatLong(double dfPixel, double dfLine, double &dfLat, double &dfLong)
+{
+    if( hTPSArg != NULL )
+    {
+        double dfX = dfPixel, dfY = dfLine, dfZ = 0.0;
+        int bSuccess = FALSE;
+
+        GDALTPSTransform( hTPSArg, FALSE, 1, &dfX, &dfY, &dfZ, &bSuccess );
+        dfLat = dfY;
+        dfLong = dfX;
+        return bSuccess != FALSE;
+    }
+
+    if( gridPixels.empty() )
+        return false;
+
+    int nPixels = gridPixels.size();
+    int nLines = gridLines.size();
+    int iPixel = std::upper_bound( gridPixels.begin(), gridPixels.end(), dfPixel ) - gridPixels.begin() - 1;
+    int iLine = std::upper_bound( gridLines.begin(), gridLines.end(), dfLine ) - gridLines.begin() - 1;
+    iPixel = std::min( std::max( iPixel, 0 ), nPixels - 2 );
+    iLine = std::min( std::max( iLine, 0 ), nLines - 2 );
+
+    double dfU = (dfPixel - gridPixels[iPixel]) / (gridPixels[iPixel+1] - gridPixels[iPixel]);
+    double dfV = (dfLine - gridLines[iLine]) / (gridLines[iLine+1] - gridLines[iLine]);
+
+    int i00 = iLine*nPixels + iPixel;
+    int i01 = i00 + 1;
+    int i10 = i00 + nPixels;
+    int i11 = i10 + 1;
+
+    dfLat = (1-dfV) * ((1-dfU) * gridLats[i00] + dfU * gridLats[i01])
+          + dfV * ((1-dfU) * gridLats[i10] + dfU * gridLats[i11]);
+
+    double dfLong00 = gridLongs[i00];
+    double adfLong[3] = { gridLongs[i01], gridLongs[i10], gridLongs[i11] };
+    for( int i = 0; i < 3; i++ )
+    {
+        if( adfLong[i] - dfLong00 > 180.0 )
+            adfLong[i] -= 360.0;
+        else if( adfLong[i] - dfLong00 < -180.0 )
+            adfLong[i] += 360.0;
+    }
+
+    dfLong = (1-dfV) * ((1-dfU) * dfLong00 + dfU * adfLong[0])
+           + dfV * ((1-dfU) * adfLong[1] + dfU * adfLong[2]);
+    if( dfLong > 180.0 )
+        dfLong -= 360.0;
+    else if( dfLong < -180.0 )
+        dfLong += 360.0;
+
+    return true;
+}
+
+/************************************************************************/
+/*                           latLongToPixel()                           */
+/*                                                                      */
+/*      Inverse of pixelToLatLong(): the reverse polynomial fit of the  */
+/*      GCPs gives a first guess, refined with Newton steps on the      */
+/*      forward interpolator (finite difference Jacobian).  Both the    */
+/*      fit and the solve work on longitudes unwrapped against the      */
+/*      scene centre, so scenes across the antimeridian stay smooth.    */
+/************************************************************************/
+
+bool TiePointGeocoder::latLongToPixel(double dfLat, double dfLong, double &dfPixel, double &dfLine)
+{
+    if( nGCPCount == 0 )
+        return false;
+
+    if( hInverseArg == NULL )
+    {
+        GDAL_GCP *pasUnwrapped = GDALDuplicateGCPs( nGCPCount, pasGCPList );
+        for( int i = 0; i < nGCPCount; i++ )
+            pasUnwrapped[i].dfGCPX = unwrapLong( pasUnwrapped[i].dfGCPX, dfCentreLong );
+
+        hInverseArg = GDALCreateGCPTransformer( nGCPCount, pasUnwrapped, 0, FALSE );
+        GDALDeinitGCPs( nGCPCount, pasUnwrapped );
+        CPLFree( pasUnwrapped );
+        if( hInverseArg == NULL )
+            return false;
+    }
+
+    dfLong = unwrapLong( dfLong, dfCentreLong );
+
+    double dfX = dfLong, dfY = dfLat, dfZ = 0.0;
+    int bSuccess = FALSE;
+    GDALGCPTransform( hInverseArg, TRUE, 1, &dfX, &dfY, &dfZ, &bSuccess );
+    if( !bSuccess )
+        return false;
+
+    dfPixel = dfX;
+    dfLine = dfY;
+
+    const double dfStep = 1.0;
+    for( int iIter = 0; iIter < 3; iIter++ )
+    {
+        double dfLat0, dfLong0, dfLatX, dfLongX, dfLatY, dfLongY;
+
+        if( !pixelToLatLong( dfPixel, dfLine, dfLat0, dfLong0 )
+            || !pixelToLatLong( dfPixel + dfStep, dfLine, dfLatX, dfLongX )
+            || !pixelToLatLong( dfPixel, dfLine + dfStep, dfLatY, dfLongY ) )
+            break;
+
+        dfLong0 = unwrapLong( dfLong0, dfCentreLong );
+        dfLongX = unwrapLong( dfLongX, dfCentreLong );
+        dfLongY = unwrapLong( dfLongY, dfCentreLong );
+
+        double dfA = (dfLongX - dfLong0) / dfStep, dfB = (dfLongY - dfLong0) / dfStep;
+        double dfC = (dfLatX - dfLat0) / dfStep, dfD = (dfLatY - dfLat0) / dfStep;
+        double dfDet = dfA * dfD - dfB * dfC;
+        if( fabs(dfDet) < 1e-20 )
+            break;
+
+        double dfELong = dfLong - dfLong0, dfELat = dfLat - dfLat0;
+        double dfDPixel = ( dfD * dfELong - dfB * dfELat) / dfDet;
+        double dfDLine  = (-dfC * dfELong + dfA * dfELat) / dfDet;
+
+        dfPixel += dfDPixel;
+        dfLine += dfDLine;
+        if( fabs(dfDPixel) < 0.01 && fabs(dfDLine) < 0.01 )
+            break;
+    }
+
+    return true;
+}
+
+/************************************************************************/
+/*                              geocode()                               */
+/*                                                                      */
+/*      Same layout as GDALProcess::getLATLONG(), returns the number    */
+/*      of points that could not be transformed.                        */
+/************************************************************************/
+
+int TiePointGeocoder::geocode(const std::vector<double> &x,
+                              const std::vector<double> &y,
+                              std::vector<double> &Lats,
+                              std::vector<double> &Longs)
+{
+    int nFailed = 0;
+
+    Lats.resize( x.size() );
+    Longs.resize( x.size() );
+    for( size_t i = 0; i < x.size(); i++ )
+    {
+        if( !pixelToLatLong( x[i], y[i], Lats[i], Longs[i] ) )
+            nFailed++;
+    }
+
+    return nFailed;
+}
+
+/************************************************************************/
+/*                              distance()                              */
+/*                                                                      */
+/*      Great circle (haversine) distance in metres.                    */
+/************************************************************************/
+
+double TiePointGeocoder::distance(double dfLat1, double dfLong1, double dfLat2, double dfLong2)
+{
+    const double dfRadius = 6371008.8;
+    const double dfToRad = M_PI / 180.0;
+    double dfDLat = (dfLat2 - dfLat1) * dfToRad;
+    double dfDLong = (dfLong2 - dfLong1) * dfToRad;
+    double dfA = sin(dfDLat/2) * sin(dfDLat/2)
+               + cos(dfLat1*dfToRad) * cos(dfLat2*dfToRad) * sin(dfDLong/2) * sin(dfDLong/2);
+
+    return 2.0 * dfRadius * asin( std::min( 1.0, sqrt(dfA) ) );
+}
+
+/************************************************************************/
+/*                     compareWithGCPTransformer()                      */
+/*                                                                      */
+/*      Accuracy report against the polynomial GCP transformer the      */
+/*      warp falls back on, on a grid of sample points every nStep      */
+/*      pixels, plus that transformer's residual at the tie points      */
+/*      themselves (where the bilinear grid is exact).                  */
+/************************************************************************/
+
+int TiePointGeocoder::compareWithGCPTransformer(int nStep, TiePointAccuracy &accuracy)
+{
+    void *hGCPArg;
+    std::vector<double> adfX, adfY, adfZ, adfLat, adfLong;
+    std::vector<int> abSuccess;
+    clock_t nStart;
+    int i, nPoints;
+
+    accuracy.nSamples = 0;
+    accuracy.dfMeanError = accuracy.dfRMSError = accuracy.dfMaxError = 0.0;
+    accuracy.dfTiePointMean = accuracy.dfTiePointMax = 0.0;
+    accuracy.dfGeocoderTime = accuracy.dfGDALTime = 0.0;
+
+    if( nGCPCount == 0 || nStep <= 0 )
+        return 1;
+
+    hGCPArg = GDALCreateGCPTransformer( nGCPCount, pasGCPList, 0, FALSE );
+    if( hGCPArg == NULL )
+        return 1;
+
+    for( double dfLine = 0.5; dfLine < nRasterYSize; dfLine += nStep )
+    {
+        for( double dfPixel = 0.5; dfPixel < nRasterXSize; dfPixel += nStep )
+        {
+            adfX.push_back( dfPixel );
+            adfY.push_back( dfLine );
+        }
+    }
+    nPoints = adfX.size();
+    if( nPoints == 0 )
+    {
+        GDALDestroyGCPTransformer( hGCPArg );
+        return 1;
+    }
+
+    nStart = clock();
+    geocode( adfX, adfY, adfLat, adfLong );
+    accuracy.dfGeocoderTime = 1e6 * (double)(clock() - nStart) / CLOCKS_PER_SEC / nPoints;
+
+    std::vector<double> adfGX( adfX ), adfGY( adfY );
+    adfZ.assign( nPoints, 0.0 );
+    abSuccess.assign( nPoints, FALSE );
+    nStart = clock();
+    GDALGCPTransform( hGCPArg, FALSE, nPoints, &adfGX[0], &adfGY[0], &adfZ[0], &abSuccess[0] );
+    accuracy.dfGDALTime = 1e6 * (double)(clock() - nStart) / CLOCKS_PER_SEC / nPoints;
+
+    double dfSum = 0.0, dfSumSq = 0.0;
+    for( i = 0; i < nPoints; i++ )
+    {
+        if( !abSuccess[i] )
+            continue;
+
+        double dfError = distance( adfLat[i], adfLong[i], adfGY[i], adfGX[i] );
+        dfSum += dfError;
+        dfSumSq += dfError * dfError;
+        accuracy.dfMaxError = std::max( accuracy.dfMaxError, dfError );
+        accuracy.nSamples++;
+    }
+    if( accuracy.nSamples > 0 )
+    {
+        accuracy.dfMeanError = dfSum / accuracy.nSamples;
+        accuracy.dfRMSError = sqrt( dfSumSq / accuracy.nSamples );
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Residual of the GDAL transformer at the tie points.             */
+/* -------------------------------------------------------------------- */
+    dfSum = 0.0;
+    for( i = 0; i < nGCPCount; i++ )
+    {
+        double dfX = pasGCPList[i].dfGCPPixel, dfY = pasGCPList[i].dfGCPLine, dfZ = 0.0;
+        int bSuccess = FALSE;
+
+        GDALGCPTransform( hGCPArg, FALSE, 1, &dfX, &dfY, &dfZ, &bSuccess );
+        if( !bSuccess )
+            continue;
+
+        double dfError = distance( pasGCPList[i].dfGCPY, pasGCPList[i].dfGCPX, dfY, dfX );
+        dfSum += dfError;
+        accuracy.dfTiePointMax = std::max( accuracy.dfTiePointMax, dfError );
+    }
+    accuracy.dfTiePointMean = dfSum / nGCPCount;
+
+    GDALDestroyGCPTransformer( hGCPArg );
+
+    return 0;
+}
@@ -0,0 +1,81 @@
+/** 
+ *
+ * CFAR2 ship detection pipeline
+ * Pixel/line <-> lat/long from the N1 geolocation tie points
+ *
+**/
+
+#ifndef TIEPOINTGEOCODER_H
+#define TIEPOINTGEOCODER_H
+
+#include "gdal.h"
+#include "gdal_alg.h"
+#include "cpl_conv.h"
+
+#include <string>
+#include <vector>
+
+/// Agreement between the tie point geocoder and GDAL's GCP (polynomial) transformer
+struct TiePointAccuracy
+{
+  int nSamples;			// Sample points compared
+  double dfMeanError;		// Metres
+  double dfRMSError;		// Metres
+  double dfMaxError;		// Metres
+  double dfTiePointMean;	// GDAL transformer residual at the tie points (metres)
+  double dfTiePointMax;
+  double dfGeocoderTime;	// Microseconds per point
+  double dfGDALTime;		// Microseconds per point
+};
+
+/// Pixel/line to lat/long straight from the N1 geolocation tie points.
+/// The ENVISAT GCPs form a regular grid (fixed samples across each
+/// geolocation ADSR), which is interpolated bilinearly per cell.  When the
+/// GCPs do not form a grid a thin plate spline is used instead.
+class TiePointGeocoder
+{
+
+public:
+TiePointGeocoder();
+
+int load(std::string inputFilenameN1);
+int loadGCPs(int nGCPs, const GDAL_GCP *pasGCPs, int nXSize, int nYSize);
+
+bool isGrid(void){return !gridPixels.empty();};
+int getGCPCount(void){return nGCPCount;};
+int getRasterXSize(void){return nRasterXSize;};
+int getRasterYSize(void){return nRasterYSize;};
+
+bool pixelToLatLong(double dfPixel, double dfLine, double &dfLat, double &dfLong);
+bool latLongToPixel(double dfLat, double dfLong, double &dfPixel, double &dfLine);
+int geocode(const std::vector<double> &x,
+	    const std::vector<double> &y,
+	    std::vector<double> &Lats,
+	    std::vector<double> &Longs);
+
+int compareWithGCPTransformer(int nStep, TiePointAccuracy &accuracy);
+
+static double distance(double dfLat1, double dfLong1, double dfLat2, double dfLong2);
+
+virtual ~TiePointGeocoder();
+
+private:
+  void clear();
+  int buildGrid();
+
+  int nGCPCount;
+  GDAL_GCP *pasGCPList;
+  int nRasterXSize;
+  int nRasterYSize;
+
+  std::vector<double> gridPixels;	// Sorted tie point columns
+  std::vector<double> gridLines;	// Sorted tie point rows
+  std::vector<double> gridLats;		// gridLines x gridPixels, row major
+  std::vector<double> gridLongs;
+
+  void *hTPSArg;			// Fallback for irregular GCPs
+  void *hInverseArg;			// Polynomial GCP transformer, first guess for latLongToPixel
+  double dfCentreLong;			// Longitude nearest the raster centre, latLongToPixel unwraps against it
+};
+
+#endif // TIEPOINTGEOCODER_H
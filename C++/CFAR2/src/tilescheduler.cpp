@@ -0,0 +1,190 @@
+/** 
+ *
+ * CFAR2 ship detection pipeline
+ * Memory budgeted scheduling of detector tiles
+ *
+**/
+
+#include "tilescheduler.h"
+#include "pipelinemetrics.h"
+#include "tracerecorder.h"
+
+#include <ossim/base/ossimCommon.h>
+
+#include "opencv/cv.h"
+
+#include <OpenThreads/ScopedLock>
+#include <OpenThreads/Thread>
+
+#include <algorithm>
+#include <iostream>
+
+/// One thread of the pool, pulling tiles through its own chain
+class TileWorker : public OpenThreads::Thread
+{
+public:
+  TileWorker(TileScheduler *poScheduler, ossimImageSource *poChain, TileConsumer *poConsumer)
+    : scheduler(poScheduler), chain(poChain), consumer(poConsumer),
+      metrics(PipelineMetrics::current()), metricsPath(PipelineMetrics::currentPath()) {}
+
+  virtual void run()
+  {
+    // Tiles are recorded in the metrics of the thread that started the pool
+    MetricsScope scope(metrics, metricsPath);
+    TraceRecorder::instance()->setThreadName("tile worker");
+    ossimIrect tileRect;
+    while(true)
+    {
+      {
+	// Waiting for the memory budget to admit the tile
+	TraceSpan waitSpan("tile budget wait", "scheduler");
+	if(!scheduler->nextTile(tileRect))
+	  break;
+      }
+      TraceSpan span("tile", "scheduler", tileRect.ul().x, tileRect.ul().y);
+      ossimRefPtr<ossimImageData> data = chain->getTile(tileRect, 0);
+      if(data.valid() && data->getDataObjectStatus() != OSSIM_NULL && data->getDataObjectStatus() != OSSIM_EMPTY)
+      {
+	TraceSpan consumeSpan("tile copy", "writer", tileRect.ul().x, tileRect.ul().y);
+	consumer->consume(tileRect, data.get());
+      }
+      scheduler->tileFinished();
+    }
+  }
+
+private:
+  TileScheduler *scheduler;
+  ossimImageSource *chain;
+  TileConsumer *consumer;
+  PipelineMetrics *metrics;
+  std::string metricsPath;
+};
+
+TileScheduler::TileScheduler()
+  : memoryBudget(0.0), workingSet(0.0), memoryInUse(0.0), peakMemory(0.0), tilesInFlight(0), peakTiles(0),
+    tileWidth(0), tileHeight(0), nextX(0), nextY(0)
+{
+}
+
+TileScheduler::~TileScheduler()
+{
+}
+
+/*! @brief Bytes held while one tile is processed
+ *
+ * The input tile, the detector's float copy of the tile plus the window
+ * halo around it, the sorted window of an order statistic and the 8-bit
+ * output tile.  A window radius of 0 is a pixelwise detector.
+ */
+double TileScheduler::estimateWorkingSet(int nTileWidth, int nTileHeight, int nBandCount,
+					 ossimScalarType eScalarType, int nWindowRadius)
+{
+  double dfPixels = (double) nTileWidth * nTileHeight * nBandCount;
+  double dfHaloPixels = (double) (nTileWidth + 2 * nWindowRadius) * (nTileHeight + 2 * nWindowRadius) * nBandCount;
+  double dfWindow = (double) (2 * nWindowRadius + 1) * (2 * nWindowRadius + 1) * sizeof(float);
+
+  return dfPixels * ossim::scalarSizeInBytes(eScalarType)
+       + dfHaloPixels * sizeof(float)
+       + dfWindow
+       + dfPixels;
+}
+
+/*! @brief Threads that fit the budget, at least one
+ */
+int TileScheduler::getConcurrency(int nChains)
+{
+  int nThreads = nChains;
+  if(memoryBudget > 0 && workingSet > 0)
+    nThreads = std::min(nThreads, (int) std::max(1.0, memoryBudget / workingSet));
+  return std::max(nThreads, 1);
+}
+
+bool TileScheduler::nextTile(ossimIrect &tileRect)
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex);
+
+  // A tile larger than the whole budget still runs, on its own
+  while(nextY <= bounds.lr().y && memoryBudget > 0 && tilesInFlight > 0 && memoryInUse + workingSet > memoryBudget)
+    condition.wait(&mutex);
+
+  // The scan is over, wake the other waiting workers so they see it too
+  if(nextY > bounds.lr().y)
+  {
+    condition.broadcast();
+    return false;
+  }
+
+  tileRect = ossimIrect(nextX, nextY, nextX + tileWidth - 1, nextY + tileHeight - 1);
+  nextX += tileWidth;
+  if(nextX > bounds.lr().x)
+  {
+    nextX = bounds.ul().x;
+    nextY += tileHeight;
+  }
+
+  tilesInFlight++;
+  memoryInUse += workingSet;
+  peakTiles = std::max(peakTiles, tilesInFlight);
+  peakMemory = std::max(peakMemory, memoryInUse);
+  return true;
+}
+
+void TileScheduler::tileFinished()
+{
+  OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex);
+  tilesInFlight--;
+  memoryInUse -= workingSet;
+  // Several waiting workers may now fit in the budget
+  condition.broadcast();
+}
+
+/*! @brief Runs every tile of the first chain's bounds and waits for them
+ *
+ * The chains must be independent copies (handler and filter): OSSIM
+ * sources keep their output tile as a member.
+ */
+int TileScheduler::run(std::vector<ossimImageSource*> &chains, TileConsumer *consumer)
+{
+  if(chains.empty())
+    return 1;
+
+  return run(chains, consumer, chains[0]->getBoundingRect(0));
+}
+
+/*! @brief Runs the tiles of area only (tile aligned, e.g. an AOI window)
+ */
+int TileScheduler::run(std::vector<ossimImageSource*> &chains, TileConsumer *consumer, const ossimIrect &area)
+{
+  if(chains.empty())
+    return 1;
+
+  bounds = area;
+  tileWidth = chains[0]->getTileWidth();
+  tileHeight = chains[0]->getTileHeight();
+  nextX = bounds.ul().x;
+  nextY = bounds.ul().y;
+  memoryInUse = peakMemory = 0;
+  tilesInFlight = peakTiles = 0;
+
+  int nThreads = getConcurrency(chains.size());
+
+  double t = (double) cv::getTickCount();
+  std::vector<TileWorker*> workers;
+  for(int i = 0; i < nThreads; i++)
+  {
+    workers.push_back(new TileWorker(this, chains[i], consumer));
+    workers.back()->start();
+  }
+  for(int i = 0; i < nThreads; i++)
+  {
+    workers[i]->join();
+    delete workers[i];
+  }
+  t = ((double)cv::getTickCount() - t)/cv::getTickFrequency();
+  PipelineMetrics::noteHighWater("tile_memory_bytes", peakMemory);
+  PipelineMetrics::noteHighWater("tiles_in_flight", peakTiles);
+
+  std::cout << "Tiles completed in: " << t << " seconds on " << nThreads << " threads, peak "
+	    << peakMemory / (1024.0 * 1024.0) << " MB (" << peakTiles << " tiles in flight)" << std::endl;
+  return 0;
+}
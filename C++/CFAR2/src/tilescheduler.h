@@ -0,0 +1,83 @@
+/** 
+ *
+ * CFAR2 ship detection pipeline
+ * Memory budgeted scheduling of detector tiles
+ *
+**/
+
+#ifndef TILESCHEDULER_H
+#define TILESCHEDULER_H
+
+#include <ossim/base/ossimConstants.h>
+#include <ossim/base/ossimIrect.h>
+#include <ossim/base/ossimRefPtr.h>
+#include <ossim/imaging/ossimImageData.h>
+#include <ossim/imaging/ossimImageSource.h>
+
+#include <OpenThreads/Condition>
+#include <OpenThreads/Mutex>
+
+#include <vector>
+
+/// Receives the finished tiles, called from several threads at once
+/// (with disjoint rectangles)
+class TileConsumer
+{
+
+public:
+virtual ~TileConsumer() {};
+
+virtual void consume(const ossimIrect &tileRect, ossimImageData *data) = 0;
+};
+
+/// Pulls the tiles of a detector through a pool of threads, each with its
+/// own copy of the chain.  A tile is only started while the working sets of
+/// the tiles in flight fit the memory budget, so large windows run fewer
+/// tiles at once than a global threshold does.
+class TileScheduler
+{
+
+public:
+TileScheduler();
+
+static double estimateWorkingSet(int nTileWidth, int nTileHeight, int nBandCount,
+				 ossimScalarType eScalarType, int nWindowRadius);
+
+int run(std::vector<ossimImageSource*> &chains, TileConsumer *consumer);	// One chain per thread
+int run(std::vector<ossimImageSource*> &chains, TileConsumer *consumer, const ossimIrect &area);
+
+double getMemoryBudget(void){return memoryBudget;};
+void setMemoryBudget(double val){memoryBudget = val;};		// Bytes, 0 = unlimited
+
+double getWorkingSet(void){return workingSet;};
+void setWorkingSet(double val){workingSet = val;};		// Bytes per tile in flight
+
+double getPeakMemory(void){return peakMemory;};
+int getPeakTiles(void){return peakTiles;};
+
+int getConcurrency(int nChains);
+
+bool nextTile(ossimIrect &tileRect);				// Blocks until the budget admits a tile
+void tileFinished();
+
+virtual ~TileScheduler();
+
+private:
+  double memoryBudget;
+  double workingSet;
+  double memoryInUse;
+  double peakMemory;
+  int tilesInFlight;
+  int peakTiles;
+
+  ossimIrect bounds;
+  ossim_int32 tileWidth;
+  ossim_int32 tileHeight;
+  ossim_int32 nextX;
+  ossim_int32 nextY;
+
+  OpenThreads::Mutex mutex;
+  OpenThreads::Condition condition;		// A tile finished
+};
+
+#endif // TILESCHEDULER_H
@@ -0,0 +1,133 @@
+/** 
+ *
+ * CFAR2 ship detection pipeline
+ * Chrome trace timeline of the pipeline
+ *
+**/
+
+#include "tracerecorder.h"
+#include "jsonstring.h"
+
+#include "opencv/cv.h"
+
+#include <OpenThreads/ScopedLock>
+
+#include <pthread.h>
+#include <cstdio>
+#include <iostream>
+
+bool TraceRecorder::enabled = false;
+double TraceRecorder::startTicks = 0.0;
+
+static pthread_key_t bufferKey;
+static pthread_once_t bufferKeyOnce = PTHREAD_ONCE_INIT;
+
+static void createBufferKey()
+{
+  pthread_key_create(&bufferKey, NULL);
+}
+
+TraceRecorder::TraceRecorder()
+{
+}
+
+TraceRecorder *TraceRecorder::instance()
+{
+  static TraceRecorder recorder;
+  return &recorder;
+}
+
+double TraceRecorder::now()
+{
+  return ((double) cv::getTickCount() - startTicks) * 1e6 / cv::getTickFrequency();
+}
+
+void TraceRecorder::start(std::string outputFilename)
+{
+  filename = outputFilename;
+  startTicks = (double) cv::getTickCount();
+  enabled = true;
+  setThreadName("main");
+}
+
+TraceThreadBuffer *TraceRecorder::threadBuffer()
+{
+  pthread_once(&bufferKeyOnce, createBufferKey);
+
+  TraceThreadBuffer *buffer = (TraceThreadBuffer*) pthread_getspecific(bufferKey);
+  if(!buffer)
+  {
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex);
+    buffer = new TraceThreadBuffer();
+    buffer->nThreadId = buffers.size() + 1;
+    buffers.push_back(buffer);
+    pthread_setspecific(bufferKey, buffer);
+  }
+  return buffer;
+}
+
+void TraceRecorder::setThreadName(std::string name)
+{
+  if(enabled)
+    threadBuffer()->threadName = name;
+}
+
+void TraceRecorder::record(const char *pszName, const char *pszCategory, double dfStart, double dfEnd, int nX, int nY)
+{
+  TraceEvent event;
+  event.pszName = pszName;
+  event.pszCategory = pszCategory;
+  event.dfStart = dfStart;
+  event.dfDuration = dfEnd - dfStart;
+  event.nX = nX;
+  event.nY = nY;
+  threadBuffer()->events.push_back(event);
+}
+
+/*! @brief Writes every thread's spans as a Chrome trace event JSON file
+ *
+ * Threads are named with "thread_name" metadata events, tile spans carry
+ * the tile's upper left as args.  Recording stops.
+ */
+int TraceRecorder::finish()
+{
+  if(!enabled)
+    return 0;
+  enabled = false;
+
+  FILE *fp = fopen(filename.c_str(), "w");
+  if(fp == NULL)
+  {
+    fprintf(stderr, "Unable to write trace %s.\n", filename.c_str());
+    return 1;
+  }
+
+  OpenThreads::ScopedLock<OpenThreads::Mutex> lock(mutex);
+
+  size_t nEvents = 0;
+  fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+  for(size_t i = 0; i < buffers.size(); i++)
+  {
+    TraceThreadBuffer *buffer = buffers[i];
+    if(!buffer->threadName.empty())
+      fprintf(fp, "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": %s}}",
+	      nEvents++ ? "," : "", buffer->nThreadId, jsonString(buffer->threadName).c_str());
+
+    for(size_t j = 0; j < buffer->events.size(); j++)
+    {
+      const TraceEvent &event = buffer->events[j];
+      fprintf(fp, "%s\n{\"name\": %s, \"cat\": %s, \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f",
+	      nEvents++ ? "," : "", jsonString(event.pszName).c_str(), jsonString(event.pszCategory).c_str(),
+	      buffer->nThreadId, event.dfStart, event.dfDuration);
+      if(event.nX >= 0)
+	fprintf(fp, ", \"args\": {\"x\": %d, \"y\": %d}", event.nX, event.nY);
+      fprintf(fp, "}");
+    }
+    buffer->events.clear();
+  }
+  fprintf(fp, "\n]}\n");
+  fclose(fp);
+
+  std::cout << "Trace of " << nEvents << " events written to " << filename << std::endl;
+  return 0;
+}
@@ -0,0 +1,86 @@
+/** 
+ *
+ * CFAR2 ship detection pipeline
+ * Chrome trace timeline of the pipeline
+ *
+**/
+
+#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+
+#include <OpenThreads/Mutex>
+
+#include <string>
+#include <vector>
+
+/// One complete ("X") span, names and categories are string literals
+struct TraceEvent
+{
+  const char *pszName;
+  const char *pszCategory;
+  double dfStart;		// Microseconds since the recorder started
+  double dfDuration;
+  int nX;			// Tile upper left, -1 when not a tile
+  int nY;
+};
+
+/// Spans of one thread, appended without locking
+struct TraceThreadBuffer
+{
+  int nThreadId;
+  std::string threadName;
+  std::vector<TraceEvent> events;
+};
+
+/// Timeline of the pipeline in the Chrome trace event format (chrome://tracing,
+/// Perfetto): every thread keeps its own spans and they are written out
+/// together at the end.  While disabled a TraceSpan costs one flag test.
+class TraceRecorder
+{
+
+public:
+static TraceRecorder *instance();
+static bool isEnabled(void){return enabled;};
+static double now();				// Microseconds since start()
+
+void start(std::string outputFilename);	// Before the worker threads start
+int finish();					// Writes the trace, after the worker threads end
+
+void setThreadName(std::string name);		// Of the calling thread
+void record(const char *pszName, const char *pszCategory, double dfStart, double dfEnd, int nX, int nY);
+
+private:
+TraceRecorder();
+TraceThreadBuffer *threadBuffer();
+
+  static bool enabled;
+  static double startTicks;
+
+  std::string filename;
+  OpenThreads::Mutex mutex;			// The list of thread buffers
+  std::vector<TraceThreadBuffer*> buffers;	// Kept for the life of the process
+};
+
+/// Records the enclosing block as a span of the calling thread
+class TraceSpan
+{
+
+public:
+TraceSpan(const char *pszName, const char *pszCategory, int nX = -1, int nY = -1)
+  : name(TraceRecorder::isEnabled() ? pszName : NULL), category(pszCategory), x(nX), y(nY),
+    start(name ? TraceRecorder::now() : 0.0) {};
+~TraceSpan()
+{
+  if(name)
+    TraceRecorder::instance()->record(name, category, start, TraceRecorder::now(), x, y);
+};
+
+private:
+  const char *name;
+  const char *category;
+  int x;
+  int y;
+  double start;
+};
+
+#endif // TRACERECORDER_H